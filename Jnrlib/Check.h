@@ -11,11 +11,21 @@ template <typename... Args> inline std::string Format(Args &&...args)
     if constexpr (sizeof...(Args) == 0)
         return "";
 
-    std::ostringstream stream;
+    /* Reuse one stream per thread, constructing a stream allocates and
+     * initializes a locale every call. The put position is rewound instead of
+     * clearing the string so the buffer keeps its capacity. */
+    thread_local std::ostringstream stream;
+    thread_local const std::ios_base::fmtflags defaultFlags = stream.flags();
+    thread_local const std::streamsize defaultPrecision = stream.precision();
+
+    stream.clear();
+    stream.flags(defaultFlags);
+    stream.precision(defaultPrecision);
+    stream.seekp(0);
 
     (stream << ... << args);
 
-    return stream.str();
+    return std::string(stream.view().substr(0, (size_t)stream.tellp()));
 }
 
 template <typename... Args> inline void Print(Args &&...args)
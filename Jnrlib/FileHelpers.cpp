@@ -90,9 +90,9 @@ void DumpWholeFile(std::string const &path,
         ThrowIfFailed(file.is_open(), "Unable to open file ", path,
                       " for writing");
     }
-    else
+    else if (!file.is_open())
     {
-        SHOWERROR("Unable to write to open file ", path, " for writing");
+        SHOWERROR("Unable to open file ", path, " for writing");
         return;
     }
 
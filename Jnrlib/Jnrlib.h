@@ -3,6 +3,11 @@
 #include "BasicTypes.h"
 #include "Check.h"
 #include "Exceptions.h"
+#include "JobSystem.h"
+#include "LinearAllocator.h"
+#include "MappedFile.h"
 #include "MemoryArena.h"
+#include "PoolAllocator.h"
 #include "Singletone.h"
+#include "TLSFAllocator.h"
 #include "TypeHelpers.h"
@@ -0,0 +1,280 @@
+#include "JobSystem.h"
+#include "Check.h"
+
+#include <array>
+
+namespace Jnrlib
+{
+static constexpr const u32 INVALID_QUEUE_INDEX = (u32)-1;
+
+/* Index in JobSystem::mQueues of the queue owned by the current thread */
+static thread_local u32 tQueueIndex = INVALID_QUEUE_INDEX;
+
+/* Chase-Lev work stealing deque (with the fixes from "Correct and Efficient
+ * Work-Stealing for Weak Memory Models", Lê et al.) plus the ring the owner
+ * allocates its jobs from. A slot of the ring is only handed out again once
+ * the job in it finished, so no thread can have more than CAPACITY jobs in
+ * flight. */
+class JobSystem::WorkQueue
+{
+public:
+    static constexpr const u32 CAPACITY = 4096;
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    /* Owner only, returns false when the deque is full */
+    bool Push(Job *job)
+    {
+        i64 bottom = mBottom.load(std::memory_order_relaxed);
+        i64 top = mTop.load(std::memory_order_acquire);
+        if (bottom - top >= (i64)CAPACITY)
+        {
+            return false;
+        }
+
+        /* Release so a thief that sees the new bottom also sees the job's contents */
+        mBuffer[bottom & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+        mBottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Owner only, takes the most recently pushed job */
+    Job *Pop()
+    {
+        i64 bottom = mBottom.load(std::memory_order_relaxed) - 1;
+        mBottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        i64 top = mTop.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            /* Empty */
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job *job = mBuffer[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            /* Last job, race the thieves for it */
+            if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                job = nullptr;
+            }
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    /* Any thread, takes the oldest job */
+    Job *Steal()
+    {
+        i64 top = mTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        i64 bottom = mBottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+        {
+            return nullptr;
+        }
+
+        Job *job = mBuffer[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return job;
+    }
+
+    /* Owner only, returns null when the next slot still holds a queued or
+     * running job. A job that got a slot always fits in the deque. */
+    Job *AllocateJob()
+    {
+        Job &job = mJobs[mNextJob & (CAPACITY - 1)];
+        if (job.isBusy.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        i64 bottom = mBottom.load(std::memory_order_relaxed);
+        i64 top = mTop.load(std::memory_order_acquire);
+        if (bottom - top >= (i64)CAPACITY)
+        {
+            return nullptr;
+        }
+
+        job.isBusy.store(true, std::memory_order_relaxed);
+        mNextJob++;
+        return &job;
+    }
+
+private:
+    alignas(64) std::atomic<i64> mTop = 0;
+    alignas(64) std::atomic<i64> mBottom = 0;
+    std::array<std::atomic<Job *>, CAPACITY> mBuffer = {};
+
+    std::array<Job, CAPACITY> mJobs;
+    u32 mNextJob = 0;
+};
+
+JobSystem::JobSystem() : JobSystem(std::max(std::thread::hardware_concurrency(), 2u) - 1)
+{
+}
+
+JobSystem::JobSystem(u32 workerCount)
+{
+    u32 queueCount = workerCount + 1 + MAX_REGISTERED_THREADS;
+    mQueues.reserve(queueCount);
+    for (u32 i = 0; i < queueCount; ++i)
+    {
+        mQueues.emplace_back(std::make_unique<WorkQueue>());
+    }
+
+    /* The creating thread is the main thread and gets the first queue */
+    tQueueIndex = 0;
+    for (u32 i = queueCount; i > workerCount + 1; --i)
+    {
+        mFreeQueues.push_back(i - 1);
+    }
+
+    mWorkers.reserve(workerCount);
+    for (u32 i = 0; i < workerCount; ++i)
+    {
+        mWorkers.emplace_back([this, i]() { WorkerLoop(i + 1); });
+    }
+
+    SHOWINFO("Started job system with ", workerCount, " workers");
+}
+
+JobSystem::~JobSystem()
+{
+    mIsRunning.store(false, std::memory_order_release);
+    mQueuedJobs.fetch_add(1, std::memory_order_release);
+    mQueuedJobs.notify_all();
+
+    mWorkers.clear();
+    tQueueIndex = INVALID_QUEUE_INDEX;
+}
+
+void JobSystem::RegisterCurrentThread()
+{
+    if (tQueueIndex != INVALID_QUEUE_INDEX)
+    {
+        return;
+    }
+
+    std::scoped_lock lock(mFreeQueuesMutex);
+    ThrowIfFailed(!mFreeQueues.empty(), "Can't register more than ", MAX_REGISTERED_THREADS,
+                  " threads to the job system at once");
+    tQueueIndex = mFreeQueues.back();
+    mFreeQueues.pop_back();
+}
+
+void JobSystem::UnregisterCurrentThread()
+{
+    /* The main thread and the workers keep their queues */
+    if (tQueueIndex == INVALID_QUEUE_INDEX || tQueueIndex <= mWorkers.size())
+    {
+        return;
+    }
+
+    /* The lock orders this thread's last pushes before the next owner's */
+    std::scoped_lock lock(mFreeQueuesMutex);
+    mFreeQueues.push_back(tQueueIndex);
+    tQueueIndex = INVALID_QUEUE_INDEX;
+}
+
+void JobSystem::Wait(JobCounter &counter)
+{
+    while (!counter.IsDone())
+    {
+        if (!TryRunJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+JobSystem::Job *JobSystem::AllocateJob()
+{
+    ThrowIfFailed(tQueueIndex != INVALID_QUEUE_INDEX,
+                  "Only the main thread, the workers and registered threads can submit jobs");
+    return mQueues[tQueueIndex]->AllocateJob();
+}
+
+void JobSystem::Submit(Job *job)
+{
+    /* AllocateJob made sure there's room */
+    bool isPushed = mQueues[tQueueIndex]->Push(job);
+    CHECK_FATAL(isPushed, "Job queue overflow");
+
+    mQueuedJobs.fetch_add(1, std::memory_order_release);
+    mQueuedJobs.notify_one();
+}
+
+JobSystem::Job *JobSystem::FindJob()
+{
+    u32 queueCount = (u32)mQueues.size();
+    u32 queueIndex = tQueueIndex;
+    if (queueIndex != INVALID_QUEUE_INDEX)
+    {
+        if (Job *job = mQueues[queueIndex]->Pop(); job != nullptr)
+        {
+            return job;
+        }
+    }
+    else
+    {
+        queueIndex = 0;
+    }
+
+    for (u32 i = 1; i <= queueCount; ++i)
+    {
+        if (Job *job = mQueues[(queueIndex + i) % queueCount]->Steal(); job != nullptr)
+        {
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+bool JobSystem::TryRunJob()
+{
+    Job *job = FindJob();
+    if (job == nullptr)
+    {
+        return false;
+    }
+
+    mQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    Execute(job);
+    return true;
+}
+
+void JobSystem::Execute(Job *job)
+{
+    JobCounter *counter = job->counter;
+    job->invoke(*job);
+    /* The owner can reuse the slot from here on */
+    job->isBusy.store(false, std::memory_order_release);
+    counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::WorkerLoop(u32 queueIndex)
+{
+    tQueueIndex = queueIndex;
+
+    while (mIsRunning.load(std::memory_order_acquire))
+    {
+        if (!TryRunJob())
+        {
+            /* A thief can take a job before its submitter counts it, so the count can briefly go negative */
+            i32 queuedJobs = mQueuedJobs.load(std::memory_order_acquire);
+            if (queuedJobs <= 0)
+            {
+                mQueuedJobs.wait(queuedJobs, std::memory_order_acquire);
+            }
+        }
+    }
+}
+} // namespace Jnrlib
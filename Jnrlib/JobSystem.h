@@ -0,0 +1,186 @@
+#pragma once
+
+#include "BasicTypes.h"
+#include "Singletone.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Jnrlib
+{
+/* Counts the jobs that still have to finish, wait on it with
+ * JobSystem::Wait. Must outlive the jobs it tracks. */
+struct JobCounter
+{
+    std::atomic<u32> pending = 0;
+
+    bool IsDone() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+};
+
+/* Fixed pool of worker threads sharing one scheduler. Every thread that
+ * submits jobs owns a Chase-Lev deque: it pushes and pops at the bottom while
+ * idle threads steal from the top. Waiting threads run jobs instead of
+ * blocking, so waiting on the main thread or from inside a job is fine.
+ *
+ * Jobs can be submitted from the thread that created the job system, from
+ * the workers and from threads that called RegisterCurrentThread. */
+class JobSystem : public ISingletone<JobSystem>
+{
+    MAKE_SINGLETONE_CAPABLE(JobSystem);
+
+    /* How many pieces ParallelFor cuts a range in, per thread, so threads
+     * that finish early have something left to steal */
+    static constexpr const u32 CHUNKS_PER_THREAD = 4;
+    static constexpr const u32 MAX_REGISTERED_THREADS = 4;
+
+    class WorkQueue;
+
+public:
+    struct alignas(64) Job
+    {
+        static constexpr const u32 STORAGE_SIZE = 40;
+
+        void (*invoke)(Job &job);
+        JobCounter *counter;
+        alignas(std::max_align_t) std::byte storage[STORAGE_SIZE];
+        /* Set while the job is queued or running, its slot can't be reused
+         * until then */
+        std::atomic<bool> isBusy = false;
+    };
+    static_assert(sizeof(Job) == 64, "Job must fit in a cache line");
+
+private:
+    JobSystem();
+    JobSystem(u32 workerCount);
+    ~JobSystem();
+
+public:
+    /**
+     * @brief Gives the calling thread its own queue so it can submit jobs.
+     * Does nothing for threads that already have one.
+     */
+    void RegisterCurrentThread();
+
+    /**
+     * @brief Hands the queue RegisterCurrentThread gave the calling thread
+     * back, so another thread can register. Jobs it left queued still run on
+     * the other threads. Does nothing for threads that didn't register.
+     */
+    void UnregisterCurrentThread();
+
+    /**
+     * @brief Queues function to run on any thread. The callable must fit in
+     * Job::STORAGE_SIZE, capture big state by reference. When the calling
+     * thread has no free job slot left, function runs right away instead.
+     */
+    template <typename Function> void Run(JobCounter &counter, Function &&function)
+    {
+        using Functor = std::decay_t<Function>;
+        static_assert(sizeof(Functor) <= Job::STORAGE_SIZE, "Job is too big, capture by reference");
+        static_assert(alignof(Functor) <= alignof(std::max_align_t), "Job is over-aligned");
+
+        Job *job = AllocateJob();
+        if (job == nullptr)
+        {
+            /* Plenty of work is queued already */
+            function();
+            return;
+        }
+
+        new (job->storage) Functor(std::forward<Function>(function));
+        job->invoke = [](Job &job) {
+            Functor *functor = std::launder(reinterpret_cast<Functor *>(job.storage));
+            (*functor)();
+            functor->~Functor();
+        };
+        job->counter = &counter;
+
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        Submit(job);
+    }
+
+    /**
+     * @brief Calls function(i) for every i in [begin, end) and returns when all the calls are done. Ranges shorter
+     * than grainSize run on the calling thread.
+     */
+    template <typename Function> void ParallelFor(u32 begin, u32 end, u32 grainSize, Function const &function)
+    {
+        if (end <= begin)
+        {
+            return;
+        }
+
+        grainSize = std::max(grainSize, 1u);
+        u32 count = end - begin;
+        u32 chunkCount = std::min((count + grainSize - 1) / grainSize, GetThreadCount() * CHUNKS_PER_THREAD);
+        u32 chunkSize = (count + chunkCount - 1) / chunkCount;
+
+        JobCounter counter;
+        for (u32 chunk = 1; chunk < chunkCount; ++chunk)
+        {
+            u32 chunkBegin = begin + chunk * chunkSize;
+            if (chunkBegin >= end)
+            {
+                break;
+            }
+            u32 chunkEnd = std::min(chunkBegin + chunkSize, end);
+            Run(counter, [&function, chunkBegin, chunkEnd]() {
+                for (u32 i = chunkBegin; i < chunkEnd; ++i)
+                {
+                    function(i);
+                }
+            });
+        }
+
+        for (u32 i = begin; i < std::min(begin + chunkSize, end); ++i)
+        {
+            function(i);
+        }
+        Wait(counter);
+    }
+
+    /**
+     * @brief Runs queued jobs on the calling thread until counter reaches zero
+     */
+    void Wait(JobCounter &counter);
+
+    /* Workers plus the main thread */
+    u32 GetThreadCount() const
+    {
+        return (u32)mWorkers.size() + 1;
+    }
+
+private:
+    Job *AllocateJob();
+    void Submit(Job *job);
+
+    Job *FindJob();
+    bool TryRunJob();
+    void Execute(Job *job);
+
+    void WorkerLoop(u32 queueIndex);
+
+private:
+    std::vector<std::unique_ptr<WorkQueue>> mQueues;
+    /* Queues after the main thread's and the workers' that no thread owns */
+    std::mutex mFreeQueuesMutex;
+    std::vector<u32> mFreeQueues;
+
+    /* Jobs sitting in a queue, idle workers sleep while it's not positive */
+    std::atomic<i32> mQueuedJobs = 0;
+    std::atomic<bool> mIsRunning = true;
+
+    std::vector<std::jthread> mWorkers;
+};
+} // namespace Jnrlib
@@ -0,0 +1,87 @@
+#include "LinearAllocator.h"
+#include "Check.h"
+
+#include <memory>
+
+namespace Jnrlib
+{
+static constexpr const size_t BUFFER_ALIGNMENT = alignof(std::max_align_t);
+
+LinearAllocator::LinearAllocator(size_t capacity,
+                                 std::pmr::memory_resource *upstream)
+    : mUpstream(upstream), mCapacity(capacity)
+{
+    ThrowIfFailed(mUpstream != nullptr, "A linear allocator needs upstream");
+    if (mCapacity != 0)
+    {
+        mData = static_cast<std::byte *>(
+            mUpstream->allocate(mCapacity, BUFFER_ALIGNMENT));
+    }
+}
+
+LinearAllocator::~LinearAllocator()
+{
+    Reset();
+    if (mData != nullptr)
+    {
+        mUpstream->deallocate(mData, mCapacity, BUFFER_ALIGNMENT);
+    }
+}
+
+void LinearAllocator::Reset()
+{
+    for (auto const &allocation : mOverflowAllocations)
+    {
+        mUpstream->deallocate(allocation.data, allocation.size,
+                              allocation.alignment);
+    }
+    mOverflowAllocations.clear();
+
+    if (mOverflowBytes != 0)
+    {
+        /* Make room for everything that was requested, with some slack so
+         * a slowly growing workload doesn't reallocate every frame */
+        size_t newCapacity = mCapacity + mOverflowBytes + mCapacity / 2;
+        DSHOWWARNING("Linear allocator overflowed by ", mOverflowBytes,
+                     " bytes, growing from ", mCapacity, " to ", newCapacity,
+                     " bytes");
+
+        if (mData != nullptr)
+        {
+            mUpstream->deallocate(mData, mCapacity, BUFFER_ALIGNMENT);
+        }
+        mCapacity = newCapacity;
+        mData = static_cast<std::byte *>(
+            mUpstream->allocate(mCapacity, BUFFER_ALIGNMENT));
+        mOverflowBytes = 0;
+    }
+
+    mOffset = 0;
+}
+
+void *LinearAllocator::do_allocate(size_t bytes, size_t alignment)
+{
+    void *current = mData + mOffset;
+    size_t space = mCapacity - mOffset;
+    if (mData != nullptr && std::align(alignment, bytes, current, space))
+    {
+        mOffset = mCapacity - space + bytes;
+        return current;
+    }
+
+    void *data = mUpstream->allocate(bytes, alignment);
+    mOverflowAllocations.push_back({data, bytes, alignment});
+    mOverflowBytes += bytes + alignment;
+    return data;
+}
+
+void LinearAllocator::do_deallocate(void *, size_t, size_t)
+{
+}
+
+bool LinearAllocator::do_is_equal(
+    std::pmr::memory_resource const &other) const noexcept
+{
+    return this == &other;
+}
+} // namespace Jnrlib
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "BasicTypes.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace Jnrlib
+{
+/* Bump allocator for memory that dies all at once, like everything built
+ * during a frame. Deallocation is a no-op, Reset releases everything. When the
+ * buffer runs out the allocation is served by upstream and the buffer grows
+ * on the next Reset, so after a few frames nothing goes to upstream anymore.
+ * Not thread safe. */
+class LinearAllocator : public std::pmr::memory_resource
+{
+public:
+    LinearAllocator(size_t capacity, std::pmr::memory_resource *upstream =
+                                         std::pmr::new_delete_resource());
+    ~LinearAllocator();
+
+    LinearAllocator(LinearAllocator const &) = delete;
+    LinearAllocator &operator=(LinearAllocator const &) = delete;
+
+public:
+    void Reset();
+
+    size_t GetUsedBytes() const
+    {
+        return mOffset + mOverflowBytes;
+    }
+    size_t GetCapacity() const
+    {
+        return mCapacity;
+    }
+
+protected:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const &other) const
+        noexcept override;
+
+private:
+    struct OverflowAllocation
+    {
+        void *data;
+        size_t size;
+        size_t alignment;
+    };
+
+    std::pmr::memory_resource *mUpstream;
+
+    std::byte *mData = nullptr;
+    size_t mCapacity = 0;
+    size_t mOffset = 0;
+
+    std::vector<OverflowAllocation> mOverflowAllocations;
+    size_t mOverflowBytes = 0;
+};
+} // namespace Jnrlib
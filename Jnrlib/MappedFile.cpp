@@ -0,0 +1,126 @@
+#include "MappedFile.h"
+#include "Check.h"
+
+#include <utility>
+
+#if defined(OS_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Jnrlib
+{
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : mData(std::exchange(other.mData, nullptr)),
+      mSize(std::exchange(other.mSize, 0))
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        mData = std::exchange(other.mData, nullptr);
+        mSize = std::exchange(other.mSize, 0);
+    }
+    return *this;
+}
+
+#if defined(OS_WINDOWS)
+bool MappedFile::Open(std::string const &path)
+{
+    Close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    /* The view keeps the mapping and the file alive */
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    CHECK(data != nullptr, false, "Unable to map file ", path);
+
+    mData = (std::byte *)data;
+    mSize = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (mData != nullptr)
+    {
+        UnmapViewOfFile(mData);
+        mData = nullptr;
+        mSize = 0;
+    }
+}
+#else
+bool MappedFile::Open(std::string const &path)
+{
+    Close();
+
+    int file = open(path.c_str(), O_RDONLY);
+    if (file == -1)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        close(file);
+        return false;
+    }
+
+    /* The mapping keeps the file alive */
+    void *data = mmap(nullptr, (size_t)status.st_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE, file, 0);
+    close(file);
+    CHECK(data != MAP_FAILED, false, "Unable to map file ", path);
+
+    mData = (std::byte *)data;
+    mSize = (size_t)status.st_size;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (mData != nullptr)
+    {
+        munmap(mData, mSize);
+        mData = nullptr;
+        mSize = 0;
+    }
+}
+#endif
+} // namespace Jnrlib
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "BasicTypes.h"
+
+#include <cstddef>
+#include <string>
+
+namespace Jnrlib
+{
+/* Read-only view of a whole file mapped in memory. The pages are copy on
+ * write, so the data can be patched in place without touching the file.
+ * Only the pages that are written to get copied. */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile &operator=(MappedFile const &) = delete;
+
+public:
+    /* Returns false if the file doesn't exist or can't be mapped */
+    bool Open(std::string const &path);
+    void Close();
+
+    bool IsOpen() const
+    {
+        return mData != nullptr;
+    }
+
+    std::byte *GetData() const
+    {
+        return mData;
+    }
+    size_t GetSize() const
+    {
+        return mSize;
+    }
+
+private:
+    std::byte *mData = nullptr;
+    size_t mSize = 0;
+};
+} // namespace Jnrlib
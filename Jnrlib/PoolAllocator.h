@@ -0,0 +1,144 @@
+#pragma once
+
+#include "BasicTypes.h"
+#include "Jnrlib/Check.h"
+
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#ifndef JNR_POOL_POISON
+#if DEBUG || _DEBUG
+#define JNR_POOL_POISON 1
+#else
+#define JNR_POOL_POISON 0
+#endif
+#endif /* JNR_POOL_POISON */
+
+/* Fixed size object pool. Free slots are linked through their own storage, so
+ * both Allocate and Free are O(1). Memory is requested in chunks of
+ * ChunkSize objects and never moved, pointers stay valid until freed. */
+template <typename T, u32 ChunkSize = 256> class PoolAllocator
+{
+    static_assert(ChunkSize > 0, "A chunk must hold at least one object");
+
+    static constexpr const unsigned char POISON_VALUE = 0xDD;
+
+    union Slot {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+public:
+    PoolAllocator() = default;
+    ~PoolAllocator()
+    {
+        if (mLiveCount != 0)
+        {
+            DSHOWWARNING("Destroying a pool with ", mLiveCount,
+                         " live objects, their destructors won't be called");
+        }
+    }
+
+    PoolAllocator(PoolAllocator const &) = delete;
+    PoolAllocator &operator=(PoolAllocator const &) = delete;
+
+public:
+    template <typename... Args> T *Allocate(Args &&...args)
+    {
+        if (mFreeList == nullptr)
+        {
+            AddChunk();
+        }
+
+        Slot *slot = mFreeList;
+#if JNR_POOL_POISON
+        CheckPoison(slot);
+#endif
+        mFreeList = slot->next;
+        mLiveCount++;
+
+        return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    void Free(T *data)
+    {
+        ThrowIfFailed(data != nullptr, "Can't free nullptr");
+#if JNR_POOL_POISON
+        ThrowIfFailed(Owns(data),
+                      "Can't free an object unallocated by this pool");
+#endif
+
+        data->~T();
+
+        Slot *slot = reinterpret_cast<Slot *>(data);
+#if JNR_POOL_POISON
+        std::memset(slot, POISON_VALUE, sizeof(Slot));
+#endif
+        slot->next = mFreeList;
+        mFreeList = slot;
+        mLiveCount--;
+    }
+
+    u32 GetLiveCount() const
+    {
+        return mLiveCount;
+    }
+
+    u32 GetCapacity() const
+    {
+        return (u32)mChunks.size() * ChunkSize;
+    }
+
+private:
+    void AddChunk()
+    {
+        auto &chunk = mChunks.emplace_back(std::make_unique<Slot[]>(ChunkSize));
+
+        /* Link backwards so the slots are handed out in address order */
+        for (u32 i = ChunkSize; i-- > 0;)
+        {
+#if JNR_POOL_POISON
+            std::memset(&chunk[i], POISON_VALUE, sizeof(Slot));
+#endif
+            chunk[i].next = mFreeList;
+            mFreeList = &chunk[i];
+        }
+    }
+
+#if JNR_POOL_POISON
+    bool Owns(T const *data) const
+    {
+        auto address = reinterpret_cast<unsigned char const *>(data);
+        for (auto const &chunk : mChunks)
+        {
+            auto begin = reinterpret_cast<unsigned char const *>(chunk.get());
+            auto end = begin + sizeof(Slot) * ChunkSize;
+            if (address >= begin && address < end)
+            {
+                return (address - begin) % sizeof(Slot) == 0;
+            }
+        }
+        return false;
+    }
+
+    /* Everything after the free list link must be untouched since the slot
+     * was freed, anything else is a write after free */
+    void CheckPoison(Slot const *slot) const
+    {
+        auto bytes = reinterpret_cast<unsigned char const *>(slot);
+        for (size_t i = sizeof(Slot *); i < sizeof(Slot); ++i)
+        {
+            ThrowIfFailed(bytes[i] == POISON_VALUE,
+                          "Pool slot was written after being freed");
+        }
+    }
+#endif /* JNR_POOL_POISON */
+
+private:
+    std::vector<std::unique_ptr<Slot[]>> mChunks;
+    Slot *mFreeList = nullptr;
+    u32 mLiveCount = 0;
+};
@@ -0,0 +1,439 @@
+#include "TLSFAllocator.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace Jnrlib
+{
+/* Every block starts with this header. The free list links overlap the first
+ * bytes of the payload, so they exist only while the block is free and the
+ * per-allocation overhead is just prevPhysical and sizeAndFlags. */
+struct TLSFAllocator::Block
+{
+    static constexpr const size_t FREE = 1;
+    static constexpr const size_t PREV_FREE = 2;
+    static constexpr const size_t FLAG_MASK = ALIGN_SIZE - 1;
+
+    /* prevPhysical and sizeAndFlags */
+    static constexpr const size_t OVERHEAD = sizeof(Block *) + sizeof(size_t);
+    /* A free block must be able to hold the free list links */
+    static constexpr const size_t MIN_SIZE = 2 * sizeof(Block *);
+
+    /* Only valid while the previous block is free */
+    Block *prevPhysical;
+    size_t sizeAndFlags;
+
+    Block *nextFree;
+    Block *prevFree;
+
+    size_t GetSize() const
+    {
+        return sizeAndFlags & ~FLAG_MASK;
+    }
+    void SetSize(size_t size)
+    {
+        sizeAndFlags = size | (sizeAndFlags & FLAG_MASK);
+    }
+
+    bool IsFree() const
+    {
+        return sizeAndFlags & FREE;
+    }
+    void SetFree(bool isFree)
+    {
+        sizeAndFlags = isFree ? (sizeAndFlags | FREE) : (sizeAndFlags & ~FREE);
+    }
+
+    bool IsPrevFree() const
+    {
+        return sizeAndFlags & PREV_FREE;
+    }
+    void SetPrevFree(bool isFree)
+    {
+        sizeAndFlags =
+            isFree ? (sizeAndFlags | PREV_FREE) : (sizeAndFlags & ~PREV_FREE);
+    }
+
+    u8 *GetPayload()
+    {
+        return reinterpret_cast<u8 *>(this) + OVERHEAD;
+    }
+    static Block *FromPayload(void *payload)
+    {
+        return reinterpret_cast<Block *>(static_cast<u8 *>(payload) - OVERHEAD);
+    }
+
+    Block *GetNextPhysical()
+    {
+        return reinterpret_cast<Block *>(GetPayload() + GetSize());
+    }
+    /* Lets the next block find this one once it gets freed */
+    Block *LinkNext()
+    {
+        Block *next = GetNextPhysical();
+        next->prevPhysical = this;
+        return next;
+    }
+
+    void MarkFree()
+    {
+        SetFree(true);
+        LinkNext()->SetPrevFree(true);
+    }
+    void MarkUsed()
+    {
+        SetFree(false);
+        GetNextPhysical()->SetPrevFree(false);
+    }
+};
+
+namespace
+{
+constexpr size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+constexpr size_t AlignDown(size_t value, size_t alignment)
+{
+    return value & ~(alignment - 1);
+}
+} // namespace
+
+TLSFAllocator::TLSFAllocator(void *memory, size_t size)
+{
+    AddPool(memory, size);
+}
+
+void TLSFAllocator::AddPool(void *memory, size_t size)
+{
+    static_assert(offsetof(Block, nextFree) == Block::OVERHEAD &&
+                      sizeof(Block) == Block::OVERHEAD + Block::MIN_SIZE,
+                  "Free list links must start where the payload does");
+    static_assert(Block::OVERHEAD % ALIGN_SIZE == 0,
+                  "Payloads must stay aligned to ALIGN_SIZE");
+
+    ThrowIfFailed(memory != nullptr, "Can't add a null pool");
+
+    auto start = reinterpret_cast<uintptr_t>(memory);
+    auto alignedStart = AlignUp(start, ALIGN_SIZE);
+    ThrowIfFailed(size > alignedStart - start, "Pool is too small");
+    size = AlignDown(size - (alignedStart - start), ALIGN_SIZE);
+
+    /* One block spanning the whole pool followed by a used, empty sentinel
+     * block that stops merges from running past the end */
+    ThrowIfFailed(size >= 2 * Block::OVERHEAD + Block::MIN_SIZE,
+                  "Pool is too small, it needs at least ",
+                  2 * Block::OVERHEAD + Block::MIN_SIZE, " bytes");
+    size_t blockSize = size - 2 * Block::OVERHEAD;
+    ThrowIfFailed(blockSize < MAX_ALLOCATION_SIZE, "Pool is too large, ",
+                  "split it in multiple pools smaller than ",
+                  MAX_ALLOCATION_SIZE, " bytes");
+
+    Block *block = reinterpret_cast<Block *>(alignedStart);
+    block->prevPhysical = nullptr;
+    block->sizeAndFlags = blockSize;
+    block->SetFree(true);
+
+    Block *sentinel = block->LinkNext();
+    sentinel->sizeAndFlags = 0;
+    sentinel->SetPrevFree(true);
+
+    InsertFreeBlock(block);
+}
+
+void *TLSFAllocator::Allocate(size_t size, size_t alignment)
+{
+    ThrowIfFailed(std::has_single_bit(alignment),
+                  "Alignment must be a power of two, not ", alignment);
+
+    if (size >= MAX_ALLOCATION_SIZE || alignment >= MAX_ALLOCATION_SIZE)
+    {
+        return nullptr;
+    }
+
+    size_t adjustedSize = std::max(AlignUp(size, ALIGN_SIZE), Block::MIN_SIZE);
+    bool isOverAligned = alignment > ALIGN_SIZE;
+    /* Leave room to carve a free block in front of the aligned payload */
+    size_t searchSize = isOverAligned
+                            ? adjustedSize + alignment + sizeof(Block)
+                            : adjustedSize;
+
+    Block *block = FindSuitableBlock(searchSize);
+    if (block == nullptr)
+    {
+        return nullptr;
+    }
+
+    if (isOverAligned)
+    {
+        block = SplitAligned(block, alignment);
+    }
+    Split(block, adjustedSize);
+    block->MarkUsed();
+
+    mUsedBytes += block->GetSize();
+    mAllocationCount++;
+
+    return block->GetPayload();
+}
+
+void TLSFAllocator::Free(void *data)
+{
+    if (data == nullptr)
+    {
+        return;
+    }
+
+    Block *block = Block::FromPayload(data);
+    ThrowIfFailed(!block->IsFree(), "Block was already freed");
+
+    mUsedBytes -= block->GetSize();
+    mAllocationCount--;
+
+    block->MarkFree();
+    block = MergeWithPrevious(block);
+    block = MergeWithNext(block);
+    InsertFreeBlock(block);
+}
+
+TLSFAllocator::Statistics TLSFAllocator::GetStatistics() const
+{
+    Statistics statistics{.usedBytes = mUsedBytes,
+                          .freeBytes = mFreeBytes,
+                          .allocationCount = mAllocationCount,
+                          .freeBlockCount = mFreeBlockCount};
+
+    if (mFirstLevelBitmap != 0)
+    {
+        u32 firstLevel = std::bit_width(mFirstLevelBitmap) - 1;
+        u32 secondLevel =
+            std::bit_width(mSecondLevelBitmaps[firstLevel]) - 1;
+        for (Block const *block = mFreeLists[firstLevel][secondLevel];
+             block != nullptr; block = block->nextFree)
+        {
+            statistics.largestFreeBlock =
+                std::max(statistics.largestFreeBlock, block->GetSize());
+        }
+    }
+
+    if (mFreeBytes != 0)
+    {
+        statistics.fragmentation =
+            1.0f - (f32)statistics.largestFreeBlock / (f32)mFreeBytes;
+    }
+
+    return statistics;
+}
+
+void *TLSFAllocator::do_allocate(size_t bytes, size_t alignment)
+{
+    void *data = Allocate(bytes, alignment);
+    if (data == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return data;
+}
+
+void TLSFAllocator::do_deallocate(void *p, size_t, size_t)
+{
+    Free(p);
+}
+
+bool TLSFAllocator::do_is_equal(
+    std::pmr::memory_resource const &other) const noexcept
+{
+    return this == &other;
+}
+
+void TLSFAllocator::MapSize(size_t size, u32 &firstLevel, u32 &secondLevel)
+{
+    if (size < SMALL_BLOCK_SIZE)
+    {
+        firstLevel = 0;
+        secondLevel = (u32)(size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT));
+    }
+    else
+    {
+        u32 log2 = (u32)std::bit_width(size) - 1;
+        secondLevel =
+            (u32)(size >> (log2 - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+        firstLevel = log2 - (FL_INDEX_SHIFT - 1);
+    }
+}
+
+void TLSFAllocator::InsertFreeBlock(Block *block)
+{
+    u32 firstLevel, secondLevel;
+    MapSize(block->GetSize(), firstLevel, secondLevel);
+
+    Block *&head = mFreeLists[firstLevel][secondLevel];
+    block->nextFree = head;
+    block->prevFree = nullptr;
+    if (head != nullptr)
+    {
+        head->prevFree = block;
+    }
+    head = block;
+
+    mFirstLevelBitmap |= 1u << firstLevel;
+    mSecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+
+    mFreeBytes += block->GetSize();
+    mFreeBlockCount++;
+}
+
+void TLSFAllocator::RemoveFreeBlock(Block *block)
+{
+    u32 firstLevel, secondLevel;
+    MapSize(block->GetSize(), firstLevel, secondLevel);
+
+    if (block->prevFree != nullptr)
+    {
+        block->prevFree->nextFree = block->nextFree;
+    }
+    if (block->nextFree != nullptr)
+    {
+        block->nextFree->prevFree = block->prevFree;
+    }
+
+    Block *&head = mFreeLists[firstLevel][secondLevel];
+    if (head == block)
+    {
+        head = block->nextFree;
+        if (head == nullptr)
+        {
+            mSecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+            if (mSecondLevelBitmaps[firstLevel] == 0)
+            {
+                mFirstLevelBitmap &= ~(1u << firstLevel);
+            }
+        }
+    }
+
+    mFreeBytes -= block->GetSize();
+    mFreeBlockCount--;
+}
+
+TLSFAllocator::Block *TLSFAllocator::FindSuitableBlock(size_t size)
+{
+    /* Round up to the next second level bin, so any block in the bin we land
+     * in is large enough (good fit instead of best fit, but no list walk) */
+    if (size >= SMALL_BLOCK_SIZE)
+    {
+        u32 log2 = (u32)std::bit_width(size) - 1;
+        size += (1ull << (log2 - SL_INDEX_COUNT_LOG2)) - 1;
+    }
+    if (size >= MAX_ALLOCATION_SIZE)
+    {
+        return nullptr;
+    }
+
+    u32 firstLevel, secondLevel;
+    MapSize(size, firstLevel, secondLevel);
+
+    u32 secondLevelMap = mSecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if (secondLevelMap == 0)
+    {
+        if (firstLevel + 1 >= FL_INDEX_COUNT)
+        {
+            return nullptr;
+        }
+
+        u32 firstLevelMap = mFirstLevelBitmap & (~0u << (firstLevel + 1));
+        if (firstLevelMap == 0)
+        {
+            return nullptr;
+        }
+
+        firstLevel = std::countr_zero(firstLevelMap);
+        secondLevelMap = mSecondLevelBitmaps[firstLevel];
+    }
+    secondLevel = std::countr_zero(secondLevelMap);
+
+    Block *block = mFreeLists[firstLevel][secondLevel];
+    RemoveFreeBlock(block);
+    return block;
+}
+
+TLSFAllocator::Block *TLSFAllocator::MergeWithPrevious(Block *block)
+{
+    if (!block->IsPrevFree())
+    {
+        return block;
+    }
+
+    Block *previous = block->prevPhysical;
+    RemoveFreeBlock(previous);
+    previous->SetSize(previous->GetSize() + block->GetSize() + Block::OVERHEAD);
+    previous->LinkNext();
+    return previous;
+}
+
+TLSFAllocator::Block *TLSFAllocator::MergeWithNext(Block *block)
+{
+    Block *next = block->GetNextPhysical();
+    if (!next->IsFree())
+    {
+        return block;
+    }
+
+    RemoveFreeBlock(next);
+    block->SetSize(block->GetSize() + next->GetSize() + Block::OVERHEAD);
+    block->LinkNext();
+    return block;
+}
+
+void TLSFAllocator::Split(Block *block, size_t size)
+{
+    if (block->GetSize() < size + sizeof(Block))
+    {
+        return;
+    }
+
+    Block *remaining = reinterpret_cast<Block *>(block->GetPayload() + size);
+    remaining->sizeAndFlags = block->GetSize() - size - Block::OVERHEAD;
+    block->SetSize(size);
+
+    /* block is about to be handed out, so remaining has a used neighbour on
+     * the left; the block on its right was already used, since free blocks
+     * are never adjacent */
+    remaining->MarkFree();
+    InsertFreeBlock(remaining);
+}
+
+TLSFAllocator::Block *TLSFAllocator::SplitAligned(Block *block,
+                                                  size_t alignment)
+{
+    auto payload = reinterpret_cast<uintptr_t>(block->GetPayload());
+    auto aligned = AlignUp(payload, alignment);
+    if (aligned == payload)
+    {
+        return block;
+    }
+
+    /* The gap becomes a free block, so it must be able to hold one */
+    if (aligned - payload < sizeof(Block))
+    {
+        aligned = AlignUp(payload + sizeof(Block), alignment);
+    }
+    size_t gap = aligned - payload;
+
+    Block *alignedBlock = reinterpret_cast<Block *>(aligned - Block::OVERHEAD);
+    alignedBlock->sizeAndFlags = block->GetSize() - gap;
+    alignedBlock->prevPhysical = block;
+    alignedBlock->SetPrevFree(true);
+    alignedBlock->SetFree(true);
+    alignedBlock->LinkNext();
+
+    block->SetSize(gap - Block::OVERHEAD);
+    InsertFreeBlock(block);
+
+    return alignedBlock;
+}
+} // namespace Jnrlib
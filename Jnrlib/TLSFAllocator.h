@@ -0,0 +1,109 @@
+#pragma once
+
+#include "BasicTypes.h"
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
+namespace Jnrlib
+{
+/* Two-level segregated fit allocator (Masmano et al.) over memory given by the
+ * caller. Free blocks are binned by a power of two (first level) and a linear
+ * subdivision of it (second level), two bitmaps make finding a large enough
+ * block O(1). Freed blocks are merged with their physical neighbours right
+ * away, so Allocate and Free both run in constant time. */
+class TLSFAllocator : public std::pmr::memory_resource
+{
+    static constexpr const u32 ALIGN_SIZE_LOG2 = 4;
+    static constexpr const size_t ALIGN_SIZE = 1ull << ALIGN_SIZE_LOG2;
+
+    static constexpr const u32 SL_INDEX_COUNT_LOG2 = 5;
+    static constexpr const u32 SL_INDEX_COUNT = 1u << SL_INDEX_COUNT_LOG2;
+
+    /* Blocks smaller than SMALL_BLOCK_SIZE all live in the first level, split
+     * linearly in ALIGN_SIZE steps */
+    static constexpr const u32 FL_INDEX_SHIFT =
+        SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2;
+    static constexpr const u32 FL_INDEX_MAX = 40;
+    static constexpr const u32 FL_INDEX_COUNT =
+        FL_INDEX_MAX - FL_INDEX_SHIFT + 1;
+    static constexpr const size_t SMALL_BLOCK_SIZE = 1ull << FL_INDEX_SHIFT;
+
+    struct Block;
+
+public:
+    static constexpr const size_t MAX_ALLOCATION_SIZE = 1ull << FL_INDEX_MAX;
+
+    struct Statistics
+    {
+        /* Payload bytes handed out to callers (rounded up to ALIGN_SIZE) */
+        size_t usedBytes = 0;
+        /* Payload bytes available in free blocks */
+        size_t freeBytes = 0;
+        size_t largestFreeBlock = 0;
+        u32 allocationCount = 0;
+        u32 freeBlockCount = 0;
+        /* 0 when all the free memory is in one block, approaches 1 when it is
+         * scattered in many small ones */
+        f32 fragmentation = 0.0f;
+    };
+
+public:
+    TLSFAllocator() = default;
+    TLSFAllocator(void *memory, size_t size);
+    ~TLSFAllocator() = default;
+
+    TLSFAllocator(TLSFAllocator const &) = delete;
+    TLSFAllocator &operator=(TLSFAllocator const &) = delete;
+
+public:
+    /**
+     * @brief Makes memory available to the allocator. The memory is owned by
+     * the caller and must outlive the allocator; pools are never merged with
+     * each other.
+     */
+    void AddPool(void *memory, size_t size);
+
+    /**
+     * @brief Returns nullptr when there is no free block large enough
+     */
+    void *Allocate(size_t size, size_t alignment = ALIGN_SIZE);
+    void Free(void *data);
+
+    /**
+     * @brief Walks the largest non empty bin to find the largest free block,
+     * everything else is tracked as blocks move between the free lists.
+     */
+    Statistics GetStatistics() const;
+
+protected:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const &other) const
+        noexcept override;
+
+private:
+    static void MapSize(size_t size, u32 &firstLevel, u32 &secondLevel);
+
+    void InsertFreeBlock(Block *block);
+    void RemoveFreeBlock(Block *block);
+
+    Block *FindSuitableBlock(size_t size);
+    Block *MergeWithPrevious(Block *block);
+    Block *MergeWithNext(Block *block);
+    void Split(Block *block, size_t size);
+    Block *SplitAligned(Block *block, size_t alignment);
+
+private:
+    u32 mFirstLevelBitmap = 0;
+    std::array<u32, FL_INDEX_COUNT> mSecondLevelBitmaps = {};
+    std::array<std::array<Block *, SL_INDEX_COUNT>, FL_INDEX_COUNT>
+        mFreeLists = {};
+
+    size_t mUsedBytes = 0;
+    size_t mFreeBytes = 0;
+    u32 mAllocationCount = 0;
+    u32 mFreeBlockCount = 0;
+};
+} // namespace Jnrlib
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "BasicTypes.h"
+
+#include <array>
+#include <atomic>
+
+/* Lock-free hand off of the latest state from one producer thread to one
+ * consumer thread. The producer always has a buffer to write in and the
+ * consumer always has a complete one to read, neither ever waits. States the
+ * consumer didn't get to in time are skipped. */
+template <typename T> class TripleBuffer
+{
+    static constexpr const u8 INDEX_MASK = 0b011;
+    static constexpr const u8 HAS_NEW_DATA = 0b100;
+
+public:
+    TripleBuffer() = default;
+
+    TripleBuffer(TripleBuffer const &) = delete;
+    TripleBuffer &operator=(TripleBuffer const &) = delete;
+
+public:
+    /* Producer only */
+    T &GetWriteBuffer()
+    {
+        return mBuffers[mWriteIndex];
+    }
+
+    /* Producer only, makes the write buffer the latest state */
+    void Publish()
+    {
+        mWriteIndex = mMiddleIndex.exchange(mWriteIndex | HAS_NEW_DATA, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    /* Consumer only, returns true if a newer state became the read buffer */
+    bool Update()
+    {
+        if ((mMiddleIndex.load(std::memory_order_relaxed) & HAS_NEW_DATA) == 0)
+        {
+            return false;
+        }
+
+        mReadIndex = mMiddleIndex.exchange(mReadIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    /* Consumer only */
+    T const &GetReadBuffer() const
+    {
+        return mBuffers[mReadIndex];
+    }
+
+private:
+    std::array<T, 3> mBuffers = {};
+
+    u8 mWriteIndex = 0;
+    std::atomic<u8> mMiddleIndex = 1;
+    u8 mReadIndex = 2;
+};
@@ -0,0 +1,130 @@
+/* Measures Systems::Culling::Cull over growing counts of random boxes. Which
+ * path runs is decided when Culling.cpp is compiled, so meson builds this
+ * twice: once with the SIMD path of the host (SSE or NEON) and once with
+ * CULLING_FORCE_SCALAR. Both builds use the same boxes and cameras, so their
+ * visible counts should match. */
+
+#include "Gameplay/Components/Base.h"
+#include "Gameplay/Components/Mesh.h"
+#include "Gameplay/Components/Update.h"
+#include "Gameplay/Systems/Culling.h"
+
+#include "entt/entt.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+/* Keep culling a box count for MIN_RUNS, then until MAX_MEASURE_SECONDS */
+static constexpr const u32 MIN_RUNS = 10;
+static constexpr const f64 MAX_MEASURE_SECONDS = 1.0;
+
+static constexpr const f32 WORLD_HALF_SIZE = 1000.0f;
+static constexpr const u32 CAMERA_COUNT = 8;
+
+struct Result
+{
+    u32 runs;
+    f64 nanosecondsPerBox;
+    u64 visibleBoxes;
+};
+
+/* Cameras at the center of the world looking around the horizon */
+static std::vector<glm::mat4x4> BuildCameras()
+{
+    glm::mat4x4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, WORLD_HALF_SIZE);
+
+    std::vector<glm::mat4x4> cameras;
+    for (u32 i = 0; i < CAMERA_COUNT; ++i)
+    {
+        f32 angle = glm::two_pi<f32>() * i / CAMERA_COUNT;
+        glm::vec3 forward(std::sin(angle), 0.0f, std::cos(angle));
+        cameras.push_back(projection * glm::lookAt(glm::vec3(0.0f), forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    return cameras;
+}
+
+static void BuildBoxes(u32 boxCount, entt::registry &registry)
+{
+    std::mt19937 random(boxCount);
+    std::uniform_real_distribution<f32> position(-WORLD_HALF_SIZE, WORLD_HALF_SIZE);
+    std::uniform_real_distribution<f32> extent(0.5f, 10.0f);
+
+    std::vector<entt::entity> entities(boxCount);
+    registry.create(entities.begin(), entities.end());
+    for (u32 i = 0; i < boxCount; ++i)
+    {
+        glm::vec3 translation(position(random), position(random), position(random));
+        registry.emplace<Components::Base>(
+            entities[i], Components::Base{.world = glm::translate(glm::identity<glm::mat4x4>(), translation)});
+        registry.emplace<Components::Update>(entities[i], Components::Update{.bufferIndex = i});
+        registry.emplace<Components::Dirty>(entities[i]);
+
+        Components::Mesh mesh = {};
+        mesh.bounds.center = glm::vec3(0.0f);
+        mesh.bounds.extents = glm::vec3(extent(random), extent(random), extent(random));
+        registry.emplace<Components::Mesh>(entities[i], std::move(mesh));
+    }
+}
+
+static Result Measure(u32 boxCount, std::vector<glm::mat4x4> const &cameras)
+{
+    entt::registry registry;
+    BuildBoxes(boxCount, registry);
+
+    Systems::Culling culling;
+    culling.UpdateBounds(registry);
+
+    std::pmr::vector<entt::entity> visibleEntities;
+    Result result = {};
+
+    /* Warm up and count the visible boxes of every camera once */
+    for (auto const &viewProjection : cameras)
+    {
+        culling.Cull(viewProjection, visibleEntities);
+        result.visibleBoxes += visibleEntities.size();
+    }
+
+    f64 totalNanoseconds = 0.0;
+    auto measureStart = Clock::now();
+    while (true)
+    {
+        auto start = Clock::now();
+        culling.Cull(cameras[result.runs % CAMERA_COUNT], visibleEntities);
+        auto end = Clock::now();
+
+        totalNanoseconds += std::chrono::duration<f64, std::nano>(end - start).count();
+        result.runs++;
+
+        if (result.runs >= MIN_RUNS && std::chrono::duration<f64>(end - measureStart).count() > MAX_MEASURE_SECONDS)
+        {
+            break;
+        }
+    }
+
+    result.nanosecondsPerBox = totalNanoseconds / result.runs / boxCount;
+    return result;
+}
+
+int main()
+{
+    std::vector<glm::mat4x4> cameras = BuildCameras();
+
+    std::printf("Culling path: %s\n", Systems::Culling::GetInstructionSet());
+    std::printf("%10s %8s %14s %16s\n", "boxes", "runs", "ns per box", "visible boxes");
+    for (u32 boxCount : {1000u, 10000u, 100000u, 1000000u})
+    {
+        Result result = Measure(boxCount, cameras);
+        std::printf("%10u %8u %14.3f %16llu\n", boxCount, result.runs, result.nanosecondsPerBox,
+                    (unsigned long long)result.visibleBoxes);
+    }
+    return 0;
+}
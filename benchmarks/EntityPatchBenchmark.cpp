@@ -0,0 +1,55 @@
+/* Measures the cost of registry.patch<Components::Base> for growing entity
+ * counts. With a single system-level listener the cost per patch must stay the
+ * same no matter how many entities exist. */
+
+#include "Gameplay/Components/Base.h"
+#include "Gameplay/Components/Update.h"
+#include "Gameplay/Systems/UpdateFrame.h"
+
+#include "entt/entt.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+static constexpr const u32 PATCHES_PER_RUN = 100000;
+
+static f64 MeasureNanosecondsPerPatch(u32 entityCount)
+{
+    entt::registry registry;
+    Systems::UpdateFrame updateFrame;
+    updateFrame.Connect(registry);
+
+    std::vector<entt::entity> entities(entityCount);
+    registry.create(entities.begin(), entities.end());
+    for (u32 i = 0; i < entityCount; ++i)
+    {
+        registry.emplace<Components::Base>(entities[i], Components::Base{.world = glm::mat4x4(1.0f)});
+        registry.emplace<Components::Update>(entities[i], Components::Update{.bufferIndex = i});
+    }
+    /* Start with nothing dirty, like a scene full of static props */
+    for (u32 i = 0; i < Constants::MAX_IN_FLIGHT_FRAMES; ++i)
+    {
+        updateFrame.Update(registry);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < PATCHES_PER_RUN; ++i)
+    {
+        registry.patch<Components::Base>(entities[(i * 7919u) % entityCount],
+                                         [i](Components::Base &base) { base.world[3].x = (f32)i; });
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<f64, std::nano>(end - start).count() / PATCHES_PER_RUN;
+}
+
+int main()
+{
+    std::printf("%10s %16s\n", "entities", "ns per patch");
+    for (u32 entityCount : {1000u, 4000u, 16000u, 64000u})
+    {
+        std::printf("%10u %16.2f\n", entityCount, MeasureNanosecondsPerPatch(entityCount));
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+/* Submits more jobs from one thread than its job ring holds while every
+ * worker is busy, then checks that each job ran exactly once. Also registers
+ * more short lived threads, one after the other, than the job system has
+ * queues for. Exits with 1 if any job didn't run exactly once. */
+
+#include "JobSystem.h"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+static constexpr const u32 JOB_COUNT = 5000;
+static constexpr const u32 ROUNDS = 20;
+static constexpr const u32 REGISTERED_THREADS = 20;
+
+static u32 RunRound(Jnrlib::JobSystem *jobSystem)
+{
+    u32 workerCount = jobSystem->GetThreadCount() - 1;
+    std::atomic<bool> isReleased = false;
+    std::atomic<u32> blockedWorkers = 0;
+
+    /* Keep every worker busy so nothing drains the main thread's queue */
+    Jnrlib::JobCounter blockers;
+    for (u32 i = 0; i < workerCount; ++i)
+    {
+        jobSystem->Run(blockers, [&isReleased, &blockedWorkers]() {
+            blockedWorkers.fetch_add(1, std::memory_order_release);
+            while (!isReleased.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        });
+    }
+    while (blockedWorkers.load(std::memory_order_acquire) != workerCount)
+    {
+        std::this_thread::yield();
+    }
+
+    auto runCounts = std::make_unique<std::atomic<u32>[]>(JOB_COUNT);
+    Jnrlib::JobCounter counter;
+    for (u32 i = 0; i < JOB_COUNT; ++i)
+    {
+        std::atomic<u32> *runCount = &runCounts[i];
+        jobSystem->Run(counter, [runCount]() { runCount->fetch_add(1, std::memory_order_relaxed); });
+    }
+
+    isReleased.store(true, std::memory_order_release);
+    jobSystem->Wait(counter);
+    jobSystem->Wait(blockers);
+
+    u32 failedJobs = 0;
+    for (u32 i = 0; i < JOB_COUNT; ++i)
+    {
+        if (runCounts[i].load(std::memory_order_relaxed) != 1)
+        {
+            failedJobs++;
+        }
+    }
+    return failedJobs;
+}
+
+/* Like a physics thread that is started and stopped again and again */
+static u32 RunRegisteredThreads(Jnrlib::JobSystem *jobSystem)
+{
+    std::atomic<u32> failedJobs = 0;
+    for (u32 i = 0; i < REGISTERED_THREADS; ++i)
+    {
+        std::jthread thread([jobSystem, &failedJobs]() {
+            jobSystem->RegisterCurrentThread();
+            std::atomic<u32> runCount = 0;
+            jobSystem->ParallelFor(0, JOB_COUNT, 1,
+                                   [&runCount](u32) { runCount.fetch_add(1, std::memory_order_relaxed); });
+            failedJobs.fetch_add(JOB_COUNT - runCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            jobSystem->UnregisterCurrentThread();
+        });
+    }
+    return failedJobs.load(std::memory_order_relaxed);
+}
+
+int main()
+{
+    auto *jobSystem = Jnrlib::JobSystem::Get();
+
+    u32 failedJobs = 0;
+    for (u32 round = 0; round < ROUNDS; ++round)
+    {
+        failedJobs += RunRound(jobSystem);
+    }
+    failedJobs += RunRegisteredThreads(jobSystem);
+
+    /* A grain size of 0 means the same as 1 */
+    std::atomic<u32> singleRunCount = 0;
+    jobSystem->ParallelFor(0, 1, 0, [&singleRunCount](u32) { singleRunCount.fetch_add(1, std::memory_order_relaxed); });
+    failedJobs += singleRunCount.load(std::memory_order_relaxed) == 1 ? 0 : 1;
+    std::printf("%u of %u jobs did not run exactly once\n", failedJobs, JOB_COUNT * (ROUNDS + REGISTERED_THREADS) + 1);
+
+    Jnrlib::JobSystem::Destroy();
+    return failedJobs == 0 ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+/* Steps Systems::Physics scenes without a window and measures how the step
+ * and the sync of the results into the registry scale with the body count,
+ * for every broadphase and with one or all threads. The results go to a CSV
+ * file, by default physics_benchmark.csv.
+ *
+ * Usage: PhysicsBenchmark [csv path] [max bodies] */
+
+#include "Gameplay/Components/Base.h"
+#include "Gameplay/Components/Mesh.h"
+#include "Gameplay/Components/Vehicle.h"
+#include "Gameplay/Systems/Physics.h"
+#include "JobSystem.h"
+
+#include "entt/entt.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+/* Stop measuring a configuration after this many steps, or after
+ * MAX_MEASURE_SECONDS once at least MIN_STEPS were done */
+static constexpr const u32 WARMUP_STEPS = 10;
+static constexpr const u32 MIN_STEPS = 5;
+static constexpr const u32 MAX_STEPS = 120;
+static constexpr const f64 MAX_MEASURE_SECONDS = 3.0;
+
+static constexpr const u32 STACK_HEIGHT = 10;
+static constexpr const f32 BODY_SPACING = 3.0f;
+static constexpr const f32 VEHICLE_SPACING = 6.0f;
+static constexpr const f32 TRACK_CELL_SIZE = 8.0f;
+
+enum class Scene
+{
+    Stacks,
+    Falling,
+    Vehicles,
+};
+
+struct Result
+{
+    u32 steps;
+    f64 stepMilliseconds;
+    f64 syncMilliseconds;
+    Systems::PhysicsStatistics statistics;
+};
+
+static char const *GetName(Scene scene)
+{
+    switch (scene)
+    {
+    case Scene::Stacks:
+        return "stacks";
+    case Scene::Falling:
+        return "falling";
+    case Scene::Vehicles:
+        return "vehicles";
+    }
+    return "";
+}
+
+static char const *GetName(Systems::Broadphase broadphase)
+{
+    switch (broadphase)
+    {
+    case Systems::Broadphase::DynamicAabbTree:
+        return "dbvt";
+    case Systems::Broadphase::AxisSweep:
+        return "axis_sweep";
+    case Systems::Broadphase::UniformGrid:
+        return "uniform_grid";
+    }
+    return "";
+}
+
+static Components::Mesh GetCubeMesh()
+{
+    Components::Mesh mesh = {};
+    mesh.path = "cube";
+    mesh.bounds.center = glm::vec3(0.0f);
+    mesh.bounds.extents = glm::vec3(1.0f);
+    return mesh;
+}
+
+/* Gently rolling grid of triangles, like a stretch of track */
+struct Track
+{
+    std::vector<VertexPositionNormal> vertices;
+    std::vector<u32> indices;
+};
+
+static Track BuildTrack(f32 halfSize)
+{
+    Track track;
+    u32 cellCount = std::max((u32)std::ceil(2.0f * halfSize / TRACK_CELL_SIZE), 1u);
+    for (u32 z = 0; z <= cellCount; ++z)
+    {
+        for (u32 x = 0; x <= cellCount; ++x)
+        {
+            f32 positionX = -halfSize + x * TRACK_CELL_SIZE;
+            f32 positionZ = -halfSize + z * TRACK_CELL_SIZE;
+            f32 height = 0.5f * std::sin(positionX * 0.05f) * std::cos(positionZ * 0.05f);
+            track.vertices.emplace_back(positionX, height, positionZ, 0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    u32 rowSize = cellCount + 1;
+    for (u32 z = 0; z < cellCount; ++z)
+    {
+        for (u32 x = 0; x < cellCount; ++x)
+        {
+            u32 first = z * rowSize + x;
+            track.indices.insert(track.indices.end(),
+                                 {first, first + rowSize, first + 1, first + 1, first + rowSize, first + rowSize + 1});
+        }
+    }
+    return track;
+}
+
+static entt::entity AddBody(Systems::Physics &physics, entt::registry &registry, Components::Mesh const &mesh,
+                            glm::vec3 const &position, glm::vec3 const &scale, f32 mass)
+{
+    glm::mat4x4 world = glm::translate(glm::identity<glm::mat4x4>(), position);
+    world = glm::scale(world, scale);
+
+    entt::entity entity = registry.create();
+    auto const &base = registry.emplace<Components::Base>(entity, Components::Base{.world = world});
+    registry.emplace<Components::RigidBody>(entity, physics.CreateRigidBody(entity, base, mesh, {}, mass));
+    return entity;
+}
+
+static void BuildScene(Scene scene, u32 bodyCount, Systems::Physics &physics, entt::registry &registry, Track &track)
+{
+    Components::Mesh cube = GetCubeMesh();
+    std::mt19937 random(bodyCount);
+
+    if (scene == Scene::Vehicles)
+    {
+        u32 side = (u32)std::ceil(std::sqrt((f32)bodyCount));
+        f32 halfSize = side * VEHICLE_SPACING * 0.5f + VEHICLE_SPACING;
+        track = BuildTrack(halfSize);
+
+        Components::Mesh trackMesh = {};
+        trackMesh.path = "PhysicsBenchmarkTrack" + std::to_string(bodyCount);
+
+        entt::entity entity = registry.create();
+        auto const &base =
+            registry.emplace<Components::Base>(entity, Components::Base{.world = glm::identity<glm::mat4x4>()});
+        registry.emplace<Components::RigidBody>(
+            entity, physics.CreateStaticMeshBody(entity, base, trackMesh,
+                                                 Systems::TriangleMeshData{.vertices = track.vertices,
+                                                                           .indices32 = track.indices}));
+
+        /* Cars driving in circles on the track, the chassis matches the default wheel layout */
+        for (u32 i = 0; i < bodyCount; ++i)
+        {
+            glm::vec3 position((f32)(i % side) * VEHICLE_SPACING - side * VEHICLE_SPACING * 0.5f, 1.5f,
+                               (f32)(i / side) * VEHICLE_SPACING - side * VEHICLE_SPACING * 0.5f);
+            entt::entity car = AddBody(physics, registry, cube, position, glm::vec3(1.0f, 0.5f, 2.0f), 1200.0f);
+            auto const &vehicle = registry.emplace<Components::Vehicle>(
+                car, physics.CreateVehicle(registry.get<Components::RigidBody>(car).body));
+            physics.SetVehicleControls(vehicle, 0.5f, 0.0f, i % 2 == 0 ? 0.5f : -0.5f);
+        }
+        return;
+    }
+
+    u32 columnCount = scene == Scene::Stacks ? (bodyCount + STACK_HEIGHT - 1) / STACK_HEIGHT : bodyCount;
+    u32 side = (u32)std::ceil(std::sqrt((f32)columnCount));
+    f32 halfSize = side * BODY_SPACING * 0.5f + BODY_SPACING;
+
+    /* Ground box with its top at y = 0 */
+    AddBody(physics, registry, cube, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(halfSize, 1.0f, halfSize), 0.0f);
+
+    std::uniform_real_distribution<f32> jitter(-0.5f, 0.5f);
+    std::uniform_real_distribution<f32> height(5.0f, 25.0f);
+    for (u32 i = 0; i < bodyCount; ++i)
+    {
+        u32 column = scene == Scene::Stacks ? i / STACK_HEIGHT : i;
+        glm::vec3 position((f32)(column % side) * BODY_SPACING - side * BODY_SPACING * 0.5f, 0.0f,
+                           (f32)(column / side) * BODY_SPACING - side * BODY_SPACING * 0.5f);
+        if (scene == Scene::Stacks)
+        {
+            position.y = 1.0f + 2.0f * (f32)(i % STACK_HEIGHT);
+        }
+        else
+        {
+            position += glm::vec3(jitter(random), height(random), jitter(random));
+        }
+        AddBody(physics, registry, cube, position, glm::vec3(1.0f), 1.0f);
+    }
+}
+
+static Result Measure(Scene scene, u32 bodyCount, Systems::Broadphase broadphase, u32 threadCount)
+{
+    /* Don't leave a cached BVH behind for every track size */
+    Systems::Physics physics(
+        Systems::PhysicsSettings{.workerCount = threadCount, .broadphase = broadphase, .cacheDirectory = ""});
+    entt::registry registry;
+    Track track;
+    BuildScene(scene, bodyCount, physics, registry, track);
+
+    physics.RunSteps(WARMUP_STEPS);
+    physics.Update(registry);
+
+    Result result = {};
+    f64 totalStepMilliseconds = 0.0;
+    f64 totalSyncMilliseconds = 0.0;
+    auto measureStart = Clock::now();
+    while (result.steps < MAX_STEPS)
+    {
+        physics.RunSteps(1);
+
+        auto syncStart = Clock::now();
+        physics.Update(registry);
+        auto syncEnd = Clock::now();
+
+        totalStepMilliseconds += physics.GetStatistics().stepMilliseconds;
+        totalSyncMilliseconds += std::chrono::duration<f64, std::milli>(syncEnd - syncStart).count();
+        result.steps++;
+
+        if (result.steps >= MIN_STEPS &&
+            std::chrono::duration<f64>(syncEnd - measureStart).count() > MAX_MEASURE_SECONDS)
+        {
+            break;
+        }
+    }
+
+    result.stepMilliseconds = totalStepMilliseconds / result.steps;
+    result.syncMilliseconds = totalSyncMilliseconds / result.steps;
+    result.statistics = physics.GetStatistics();
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    std::string outputPath = argc > 1 ? argv[1] : "physics_benchmark.csv";
+    u32 maxBodyCount = argc > 2 ? (u32)std::strtoul(argv[2], nullptr, 10) : 100000u;
+
+    FILE *output = std::fopen(outputPath.c_str(), "w");
+    if (output == nullptr)
+    {
+        std::fprintf(stderr, "Unable to open %s for writing\n", outputPath.c_str());
+        return 1;
+    }
+    std::fprintf(output, "scene,bodies,broadphase,threads,steps,step_ms,sync_ms,pairs,manifolds\n");
+
+    auto jobSystem = Jnrlib::JobSystem::Get();
+    std::vector<u32> threadCounts = {1u};
+    if (jobSystem->GetThreadCount() > 1)
+    {
+        threadCounts.push_back(jobSystem->GetThreadCount());
+    }
+
+    for (Scene scene : {Scene::Stacks, Scene::Falling, Scene::Vehicles})
+    {
+        for (u32 bodyCount = 100; bodyCount <= maxBodyCount; bodyCount *= 10)
+        {
+            for (Systems::Broadphase broadphase : {Systems::Broadphase::DynamicAabbTree,
+                                                   Systems::Broadphase::AxisSweep,
+                                                   Systems::Broadphase::UniformGrid})
+            {
+                for (u32 threadCount : threadCounts)
+                {
+                    Result result = Measure(scene, bodyCount, broadphase, threadCount);
+                    std::fprintf(output, "%s,%u,%s,%u,%u,%.4f,%.4f,%u,%u\n", GetName(scene), bodyCount,
+                                 GetName(broadphase), threadCount, result.steps, result.stepMilliseconds,
+                                 result.syncMilliseconds, result.statistics.overlappingPairCount,
+                                 result.statistics.manifoldCount);
+                    std::fflush(output);
+                }
+            }
+        }
+    }
+
+    std::fclose(output);
+    Jnrlib::JobSystem::Destroy();
+    std::printf("Wrote %s\n", outputPath.c_str());
+    return 0;
+}
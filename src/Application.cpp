@@ -2,6 +2,7 @@
 
 #include "Check.h"
 #include "FileHelpers.h"
+#include "JobSystem.h"
 #include "Renderer/Vulkan/CommandList.h"
 #include "Renderer/Vulkan/Renderer.h"
 
@@ -26,6 +27,8 @@ Application::Application() : mWidth(1280), mHeight(720)
 {
     InitWindow();
     SetupKnownDirectories();
+    /* Created here so the main thread owns the first queue */
+    Jnrlib::JobSystem::Get();
     Vulkan::Renderer::Get(GetRendererCreateInfo());
     SetMouseInputMode(false);
 }
@@ -214,6 +217,7 @@ void Application::Destroy()
     Game::Destroy();
 
     Vulkan::Renderer::Destroy();
+    Jnrlib::JobSystem::Destroy();
     glfwDestroyWindow(mWindow);
     glfwTerminate();
 }
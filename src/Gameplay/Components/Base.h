@@ -3,21 +3,16 @@
 #include "Jnrlib.h"
 #include <glm/glm.hpp>
 
-class Entity;
-
 namespace Components
 {
 
-struct Base
+/* Iterated every frame by most systems, so it only holds the world matrix: one
+ * entity per cache line. Rarely used data lives in Components::Name,
+ * Components::EntityRef and Components::InverseWorld. */
+struct alignas(64) Base
 {
     glm::mat4x4 world;
-    std::string name;
-
-    /* Should never update inverse world manually, it's automatically updated by
-     * Entity::UpdateBase */
-    glm::mat4x4 inverseWorld;
-
-    Entity *entityPtr;
 };
+static_assert(sizeof(Base) == 64, "Components::Base should fit in a cache line");
 
 } // namespace Components
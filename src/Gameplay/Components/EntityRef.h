@@ -0,0 +1,12 @@
+#pragma once
+
+class Entity;
+
+namespace Components
+{
+/* Back-pointer from the registry to the Entity wrapper */
+struct EntityRef
+{
+    Entity *entity;
+};
+} // namespace Components
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "entt/entt.hpp"
+
+namespace Components
+{
+/* Kept in sync with Entity::SetParent / Entity::AddChild */
+struct Hierarchy
+{
+    entt::entity parent = entt::null;
+};
+} // namespace Components
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Gameplay/Components/Base.h"
+#include "entt/entt.hpp"
+
+#include <glm/glm.hpp>
+
+namespace Components
+{
+/* Cached inverse of Base::world, only created for the entities that need it.
+ * It is invalidated when Base changes and recomputed on the next
+ * GetInverseWorld. */
+struct InverseWorld
+{
+    glm::mat4x4 inverseWorld;
+    bool isValid = false;
+};
+
+inline glm::mat4x4 const &GetInverseWorld(entt::registry &registry, entt::entity entity)
+{
+    auto &inverseWorld = registry.get_or_emplace<InverseWorld>(entity);
+    if (!inverseWorld.isValid)
+    {
+        inverseWorld.inverseWorld = glm::inverse(registry.get<Base>(entity).world);
+        inverseWorld.isValid = true;
+    }
+    return inverseWorld.inverseWorld;
+}
+
+inline void InvalidateInverseWorld(entt::registry &registry, entt::entity entity)
+{
+    if (auto *inverseWorld = registry.try_get<InverseWorld>(entity); inverseWorld != nullptr)
+    {
+        inverseWorld->isValid = false;
+    }
+}
+} // namespace Components
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "Jnrlib.h"
+#include "Utils/Constants.h"
+
+#include <array>
+#include <glm/glm.hpp>
 
 namespace Components
 {
@@ -11,11 +15,46 @@ struct Indices
 
     u32 indexCount;
     u32 vertexCount;
+
+    /* Meshes with less than 64k vertices live in the 16-bit global index
+     * buffer, everything else in the 32-bit one */
+    bool use16BitIndices;
+};
+
+struct Quantization
+{
+    /* position = packedPosition * scale + offset */
+    glm::vec3 scale;
+    glm::vec3 offset;
+};
+
+/* Object space axis aligned bounding box */
+struct Bounds
+{
+    glm::vec3 center;
+    glm::vec3 extents;
+};
+
+struct LevelOfDetail
+{
+    /* Range inside the same index buffer as Indices */
+    u32 firstIndex;
+    u32 indexCount;
+
+    /* Object space deviation from the full detail mesh */
+    f32 error;
 };
 
 struct Mesh
 {
     std::string path;
     Indices indices;
+    Quantization quantization;
+    Bounds bounds;
+
+    /* lods[0] is the full detail mesh described by indices, the following
+     * ones are progressively simplified versions of it */
+    std::array<LevelOfDetail, Constants::MAX_MESH_LODS> lods;
+    u32 lodCount;
 };
 } // namespace Components
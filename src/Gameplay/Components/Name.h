@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+namespace Components
+{
+struct Name
+{
+    std::string name;
+};
+} // namespace Components
@@ -1,18 +1,22 @@
 #pragma once
 
-#include "BulletDynamics/Dynamics/btRigidBody.h"
-#include "LinearMath/btDefaultMotionState.h"
-#include <memory>
+#include "Jnrlib.h"
 
 namespace Components
 {
-struct RigidBody
+/* Identifies a body owned by Systems::Physics. Body slots get recycled, the
+ * generation tells a stale handle apart from the body now in its slot. */
+struct BodyHandle
 {
-    btRigidBody *rigidBody;
+    u32 index = 0;
+    u32 generation = 0;
 
-    btCollisionShape *collisionShape;
+    bool operator==(BodyHandle const &other) const = default;
+};
 
-    btDefaultMotionState *motionState;
+struct RigidBody
+{
+    BodyHandle body;
 
     float mass;
 };
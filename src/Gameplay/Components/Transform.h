@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Jnrlib.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace Components
+{
+/* Local transform, relative to the parent from Components::Hierarchy (or to
+ * the world for roots). Systems::TransformSystem turns it into
+ * Components::Base::world, so it must be changed through registry.patch or
+ * registry.replace for the change to be noticed. */
+struct Transform
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+} // namespace Components
@@ -1,12 +1,27 @@
 #pragma once
 
 #include "Jnrlib.h"
+#include "Utils/Constants.h"
+#include "entt/entt.hpp"
 
 namespace Components
 {
 struct Update
 {
-    u32 dirtyFrames;
     u32 bufferIndex;
 };
+
+/* Only present on the entities whose Base changed in the last
+ * MAX_IN_FLIGHT_FRAMES frames, so systems that upload per object data can
+ * iterate the changed entities only. Systems::UpdateFrame counts it down and
+ * removes it. */
+struct Dirty
+{
+    u32 dirtyFrames = Constants::MAX_IN_FLIGHT_FRAMES;
+};
+
+inline void MarkDirty(entt::registry &registry, entt::entity entity)
+{
+    registry.emplace_or_replace<Dirty>(entity);
+}
 } // namespace Components
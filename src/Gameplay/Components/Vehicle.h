@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Gameplay/Components/RigidBody.h"
+
+namespace Components
+{
+/* The entity's rigid body is the chassis of a car simulated by
+ * Systems::Vehicles, driven through Physics::SetVehicleControls */
+struct Vehicle
+{
+    BodyHandle body;
+};
+} // namespace Components
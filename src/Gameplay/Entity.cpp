@@ -1,28 +1,11 @@
 #include "Entity.h"
-#include "Components/Base.h"
-#include "Components/Update.h"
-
-#include "../Utils/Constants.h"
-
-void Entity::UpdateBase()
-{
-    auto &u = GetComponent<Components::Update>();
-    u.dirtyFrames = Constants::MAX_IN_FLIGHT_FRAMES;
-
-    auto &base = GetComponent<Components::Base>();
-    base.inverseWorld = glm::inverse(base.world);
-}
+#include "Components/Hierarchy.h"
 
 void Entity::SetParent(Entity *parentEntity)
 {
     if (parentEntity == nullptr)
         return;
 
-    if (parentEntity == mParentEntity)
-        return;
-
-    mParentEntity = parentEntity;
-
     parentEntity->AddChild(this);
 }
 
@@ -31,16 +14,16 @@ void Entity::AddChild(Entity *childEntity)
     if (childEntity->mParentEntity == this)
         return;
 
-    for (uint32_t i = 0; i < mChildEntities.size(); ++i)
+    if (Entity *oldParent = childEntity->mParentEntity; oldParent != nullptr)
     {
-        if (mChildEntities[i] == childEntity)
-        {
-            return;
-        }
+        std::erase(oldParent->mChildEntities, childEntity);
     }
 
     childEntity->mParentEntity = this;
     AddChildUnsafe(childEntity);
+
+    /* Lets Systems::TransformSystem know about the new relationship */
+    mEntities.emplace_or_replace<Components::Hierarchy>(childEntity->mEntity, mEntity);
 }
 
 uint32_t Entity::GetEntityId() const
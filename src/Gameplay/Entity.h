@@ -23,8 +23,6 @@ public:
     Entity &operator=(Entity const &) = delete;
     Entity &operator=(Entity &&) = delete;
 
-    void UpdateBase();
-
     template <typename ComponentType>
     ComponentType &AddComponent(ComponentType &&component);
 
@@ -4,8 +4,11 @@
 #include "Check.h"
 #include "Exceptions.h"
 #include "GLFW/glfw3.h"
+#include "Gameplay/Components/EntityRef.h"
 #include "Gameplay/Components/Mesh.h"
+#include "Gameplay/Components/Name.h"
 #include "Gameplay/Components/RigidBody.h"
+#include "Gameplay/Components/Transform.h"
 #include "Gameplay/Components/Update.h"
 #include "Gameplay/PhysicsDebugDraw.h"
 #include "Gameplay/Systems/BasicRendering.h"
@@ -16,6 +19,7 @@
 #include "Renderer/Vulkan/MemoryAllocator.h"
 #include "Renderer/Vulkan/Renderer.h"
 #include "Utils/Constants.h"
+#include "Utils/MeshOptimizer.h"
 #include "Utils/Vertex.h"
 
 #include "Components/Base.h"
@@ -25,10 +29,16 @@
 #include "glm/fwd.hpp"
 #include "glm/glm.hpp"
 #include "vulkan/vulkan_core.h"
+#include <limits>
 #include <string_view>
 
 Game::Game(Vulkan::CommandList &initCommandList)
 {
+    mState.useGPUCulling &= Vulkan::Renderer::Get()->SupportsDrawIndirectCount();
+    mUpdateFrameSystem.Connect(mRegistry);
+    mTransformSystem.Connect(mRegistry);
+    mCullingSystem.Connect(mRegistry);
+
     InitScene(initCommandList);
     InitSystems(initCommandList);
 
@@ -36,21 +46,31 @@ Game::Game(Vulkan::CommandList &initCommandList)
 
     if (mState.isDeveloper)
     {
-        mPhysicsDebug = PhysicsDebugDraw(&mBatchRenderer);
         mPhysicsSystem.SetDebugInterface(&mPhysicsDebug);
     }
+    mPhysicsSystem.Start();
 }
 
 Game::~Game()
 {
+    mPhysicsSystem.Stop();
+    for (auto *entity : mEntities)
+    {
+        mEntityPool.Free(entity);
+    }
     mEntities.clear();
 }
 
 void Game::InitScene(Vulkan::CommandList &initCommandList)
 {
     AddTestEntity("TestEntity1");
-    AddGround();
+    Entity *ground = AddGround();
     BakeRenderingBuffers(initCommandList);
+
+    /* Triangle mesh collision reads the staged geometry, which doesn't move anymore once baked */
+    auto const &groundMesh = ground->GetComponent<Components::Mesh>();
+    ground->AddComponent(mPhysicsSystem.CreateStaticMeshBody(*ground, ground->GetComponent<Components::Base>(),
+                                                             groundMesh, GetMeshTriangles(groundMesh)));
 }
 
 void Game::InitSystems(Vulkan::CommandList &initCommandList)
@@ -59,36 +79,59 @@ void Game::InitSystems(Vulkan::CommandList &initCommandList)
                                            glm::vec4(0.2f));
 }
 
+template <typename T>
+static Vulkan::Buffer UploadIndexBuffer(Vulkan::CommandList &initCommandList, std::vector<T> const &indices)
+{
+    if (indices.empty())
+    {
+        return {};
+    }
+
+    Vulkan::Buffer stagingIndexBuffer =
+        Vulkan::Buffer(sizeof(T), indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                       VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    stagingIndexBuffer.Copy((void *)indices.data());
+
+    Vulkan::Buffer indexBuffer = Vulkan::Buffer(sizeof(T), indices.size(),
+                                                VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    initCommandList.CopyBuffer(indexBuffer, stagingIndexBuffer);
+    initCommandList.AddLocalBuffer(std::move(stagingIndexBuffer));
+
+    return indexBuffer;
+}
+
 void Game::BakeRenderingBuffers(Vulkan::CommandList &initCommandList)
 {
-    /* Create staged buffers and copy data into them */
+    /* Create staged buffer and pack the vertices directly into it */
     Vulkan::Buffer stagingVertexBuffer =
-        Vulkan::Buffer(sizeof(VertexPositionNormal), mStagedVertexBuffer.size(),
+        Vulkan::Buffer(sizeof(VertexPositionNormalPacked), mStagedVertexBuffer.size(),
                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-    stagingVertexBuffer.Copy(mStagedVertexBuffer.data());
+    auto *packedVertices = (VertexPositionNormalPacked *)stagingVertexBuffer.GetData();
+    for (auto const &[path, mesh] : mMeshes)
+    {
+        glm::vec3 const &scale = mesh.quantization.scale;
+        glm::vec3 inverseScale = glm::vec3(scale.x > 0.0f ? 1.0f / scale.x : 0.0f, scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+                                           scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
 
-    Vulkan::Buffer stagingIndexBuffer = Vulkan::Buffer(
-        sizeof(u32), mStagedIndexBuffer.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-    stagingIndexBuffer.Copy(mStagedIndexBuffer.data());
+        u32 lastVertex = mesh.indices.firstVertex + mesh.indices.vertexCount;
+        for (u32 i = mesh.indices.firstVertex; i < lastVertex; ++i)
+        {
+            packedVertices[i] =
+                VertexPositionNormalPacked::Pack(mStagedVertexBuffer[i], mesh.quantization.offset, inverseScale);
+        }
+    }
 
-    /* Create vertex & index buffer */
-    mGlobalVertexBuffer = Vulkan::Buffer(sizeof(VertexPositionNormal), mStagedVertexBuffer.size(),
+    /* Create vertex & index buffers */
+    mGlobalVertexBuffer = Vulkan::Buffer(sizeof(VertexPositionNormalPacked), mStagedVertexBuffer.size(),
                                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-
-    mGlobalIndexBuffer = Vulkan::Buffer(sizeof(u32), mStagedIndexBuffer.size(),
-                                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-
-    /* Perfom copy from staged buffer to actual buffers */
     initCommandList.CopyBuffer(mGlobalVertexBuffer, stagingVertexBuffer);
-    initCommandList.CopyBuffer(mGlobalIndexBuffer, stagingIndexBuffer);
-
-    /* Save temporary buffers in order to safely delete them later */
     initCommandList.AddLocalBuffer(std::move(stagingVertexBuffer));
-    initCommandList.AddLocalBuffer(std::move(stagingIndexBuffer));
 
-    mBasicRenderSystem.SetRenderingBuffers(&mGlobalVertexBuffer, &mGlobalIndexBuffer);
+    mGlobalIndexBuffer16 = UploadIndexBuffer(initCommandList, mStagedIndexBuffer16);
+    mGlobalIndexBuffer32 = UploadIndexBuffer(initCommandList, mStagedIndexBuffer32);
+
+    mBasicRenderSystem.SetRenderingBuffers(&mGlobalVertexBuffer, &mGlobalIndexBuffer16, &mGlobalIndexBuffer32);
 }
 
 void Game::InitSizeDependentResources()
@@ -102,16 +145,18 @@ void Game::InitSizeDependentResources()
     {
         depthInfo.width = (u32)windowDimensions.x;
         depthInfo.height = (u32)windowDimensions.y;
-        depthInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        depthInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
         depthInfo.format = Vulkan::Renderer::Get()->GetDefaultDepthFormat();
         depthInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     }
     mDepthImage = Vulkan::Image(depthInfo);
+    mDepthPyramid.OnResize(mDepthImage);
 }
 
 void Game::OnResize()
 {
     mBasicRenderSystem.OnResize();
+    mGPUCullingSystem.OnResize();
     mBatchRenderer.OnResize();
 
     InitSizeDependentResources();
@@ -119,101 +164,53 @@ void Game::OnResize()
 
 Components::Mesh Game::InitGeometry(std::string_view path)
 {
-    if (path == "quad")
+    if (auto it = mMeshes.find(std::string(path)); it != mMeshes.end())
     {
-        static bool initialized = false;
-        static Components::Mesh mesh = {};
-        if (initialized)
-        {
-            return mesh;
-        }
+        return it->second;
+    }
 
-        u32 firstVertex = (u32)mStagedVertexBuffer.size();
-        u32 firstIndex = (u32)mStagedIndexBuffer.size();
-
-        mStagedVertexBuffer.reserve(mStagedVertexBuffer.size() + 4);
-        mStagedIndexBuffer.reserve(mStagedIndexBuffer.size() + 6);
-
-        mStagedVertexBuffer.emplace_back(-1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, -1.0f, 0.0f, 0.0f, 0.0f, -1.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, -1.0f, 0.0f, 0.0f, 0.0f, -1.0f);
-        mStagedIndexBuffer.emplace_back(0);
-        mStagedIndexBuffer.emplace_back(1);
-        mStagedIndexBuffer.emplace_back(2);
-        mStagedIndexBuffer.emplace_back(0);
-        mStagedIndexBuffer.emplace_back(2);
-        mStagedIndexBuffer.emplace_back(3);
-
-        mesh.path = path;
-        mesh.indices.firstIndex = firstIndex;
-        mesh.indices.firstVertex = firstVertex;
-        mesh.indices.indexCount = 6;
-        mesh.indices.vertexCount = 3;
-
-        return mesh;
+    std::vector<VertexPositionNormal> vertices;
+    std::vector<u32> indices;
+    if (path == "quad")
+    {
+        vertices.reserve(4);
+        vertices.emplace_back(-1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f);
+        vertices.emplace_back(1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f);
+        vertices.emplace_back(1.0f, -1.0f, 0.0f, 0.0f, 0.0f, -1.0f);
+        vertices.emplace_back(-1.0f, -1.0f, 0.0f, 0.0f, 0.0f, -1.0f);
+        indices = {0, 1, 2, 0, 2, 3};
+
+        return AddGeometry(path, std::move(vertices), std::move(indices));
     }
     else if (path == "cube")
     {
-        static bool initialized = false;
-        static Components::Mesh mesh = {};
-        if (initialized)
-        {
-            return mesh;
-        }
-
-        u32 firstVertex = (u32)mStagedVertexBuffer.size();
-        u32 firstIndex = (u32)mStagedIndexBuffer.size();
-
-        mStagedVertexBuffer.reserve(mStagedVertexBuffer.size() + 8);
-        mStagedIndexBuffer.reserve(mStagedIndexBuffer.size() + 36);
-
-        // Define cube vertices (position + normal)
-        // mStagedVertexBuffer.emplace_back(-1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f);
-        // mStagedVertexBuffer.emplace_back(1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f);
-        // mStagedVertexBuffer.emplace_back(1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f);
-        // mStagedVertexBuffer.emplace_back(-1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f);
-        //
-        // mStagedVertexBuffer.emplace_back(-1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f);
-        // mStagedVertexBuffer.emplace_back(1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f);
-        // mStagedVertexBuffer.emplace_back(1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f);
-        // mStagedVertexBuffer.emplace_back(-1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f);
-        //
-        mStagedVertexBuffer.emplace_back(-1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, -1.0f, -1.0f, -1.0f, 0.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(-1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, 1.0f, -1.0f, 1.0f, 0.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f);
-        mStagedVertexBuffer.emplace_back(1.0f, -1.0f, 1.0f, 1.0f, 0.0f, 0.0f);
-
-        // Define cube indices (two triangles per face, six faces)
-        // u32 indices[] = {
-        //     0, 1, 2, 0, 2, 3, // Back face
-        //     4, 5, 6, 4, 6, 7, // Front face
-        //     0, 1, 5, 0, 5, 4, // Bottom face
-        //     3, 2, 6, 3, 6, 7, // Top face
-        //     0, 3, 7, 0, 7, 4, // Left face
-        //     1, 2, 6, 1, 6, 5  // Right face
-        // };
-        u32 indices[] = {
+        vertices.reserve(24);
+        vertices.emplace_back(-1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f);
+        vertices.emplace_back(1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f);
+        vertices.emplace_back(1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f);
+        vertices.emplace_back(-1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f);
+        vertices.emplace_back(-1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f);
+        vertices.emplace_back(1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f);
+        vertices.emplace_back(1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f);
+        vertices.emplace_back(-1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f);
+        vertices.emplace_back(-1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f);
+        vertices.emplace_back(1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f);
+        vertices.emplace_back(1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f);
+        vertices.emplace_back(-1.0f, -1.0f, 1.0f, 0.0f, -1.0f, 0.0f);
+        vertices.emplace_back(-1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f);
+        vertices.emplace_back(1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f);
+        vertices.emplace_back(1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f);
+        vertices.emplace_back(-1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f);
+        vertices.emplace_back(-1.0f, -1.0f, -1.0f, -1.0f, 0.0f, 0.0f);
+        vertices.emplace_back(-1.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f);
+        vertices.emplace_back(-1.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f);
+        vertices.emplace_back(-1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f);
+        vertices.emplace_back(1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f);
+        vertices.emplace_back(1.0f, 1.0f, -1.0f, 1.0f, 0.0f, 0.0f);
+        vertices.emplace_back(1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f);
+        vertices.emplace_back(1.0f, -1.0f, 1.0f, 1.0f, 0.0f, 0.0f);
+
+        indices = {
             0,  1,  2,  0,  2,  3,  // back
             4,  5,  6,  4,  6,  7,  // front
             8,  9,  10, 8,  10, 11, // bottom
@@ -221,15 +218,8 @@ Components::Mesh Game::InitGeometry(std::string_view path)
             16, 17, 18, 16, 18, 19, // left
             20, 21, 22, 20, 22, 23  // right
         };
-        mStagedIndexBuffer.insert(mStagedIndexBuffer.end(), std::begin(indices), std::end(indices));
-
-        mesh.path = path;
-        mesh.indices.firstIndex = firstIndex;
-        mesh.indices.firstVertex = firstVertex;
-        mesh.indices.indexCount = 36;
-        mesh.indices.vertexCount = 8;
 
-        return mesh;
+        return AddGeometry(path, std::move(vertices), std::move(indices));
     }
 
     /* Very javaeque of me */
@@ -237,22 +227,121 @@ Components::Mesh Game::InitGeometry(std::string_view path)
     return {};
 }
 
+Components::Mesh Game::AddGeometry(std::string_view path, std::vector<VertexPositionNormal> vertices,
+                                   std::vector<u32> indices)
+{
+    auto statistics = MeshOptimizer::Optimize(vertices, indices);
+    DSHOWINFO("Optimized mesh ", path, ": vertices ", statistics.vertexCountBefore, " -> ", statistics.vertexCountAfter,
+              ", ACMR ", statistics.before.acmr, " -> ", statistics.after.acmr, ", ATVR ", statistics.before.atvr,
+              " -> ", statistics.after.atvr);
+
+    Components::Mesh mesh = {};
+    mesh.path = path;
+    mesh.indices.firstVertex = (u32)mStagedVertexBuffer.size();
+    mesh.indices.vertexCount = (u32)vertices.size();
+    mesh.indices.indexCount = (u32)indices.size();
+    mesh.indices.use16BitIndices = vertices.size() <= std::numeric_limits<u16>::max() + 1;
+
+    /* Vertices are quantized relative to the bounding box of the mesh */
+    glm::vec3 minPosition = glm::vec3(std::numeric_limits<f32>::max());
+    glm::vec3 maxPosition = glm::vec3(std::numeric_limits<f32>::lowest());
+    for (auto const &vertex : vertices)
+    {
+        minPosition = glm::min(minPosition, vertex.position);
+        maxPosition = glm::max(maxPosition, vertex.position);
+    }
+    mesh.quantization.offset = (maxPosition + minPosition) * 0.5f;
+    mesh.quantization.scale = (maxPosition - minPosition) * 0.5f;
+    mesh.bounds.center = mesh.quantization.offset;
+    mesh.bounds.extents = mesh.quantization.scale;
+
+    /* Every LOD targets half the triangles of the previous one and gets appended after it in the index buffer. Stop
+     * when the simplifier can't make enough progress anymore */
+    constexpr f32 LOD_REDUCTION = 0.5f;
+    constexpr f32 LOD_MIN_REDUCTION = 0.8f;
+    constexpr f32 LOD_MAX_RELATIVE_ERROR = 0.05f;
+
+    mesh.lods[0] = Components::LevelOfDetail{.firstIndex = 0, .indexCount = mesh.indices.indexCount, .error = 0.0f};
+    mesh.lodCount = 1;
+
+    f32 maxError = glm::length(mesh.quantization.scale) * LOD_MAX_RELATIVE_ERROR;
+    std::vector<u32> previousLod = indices;
+    while (mesh.lodCount < Constants::MAX_MESH_LODS)
+    {
+        u32 targetIndexCount = (u32)(previousLod.size() * LOD_REDUCTION) / 3 * 3;
+
+        f32 error = 0.0f;
+        std::vector<u32> lod = MeshOptimizer::Simplify(vertices, previousLod, targetIndexCount, maxError, &error);
+        if (lod.empty() || lod.size() > previousLod.size() * LOD_MIN_REDUCTION)
+        {
+            break;
+        }
+        MeshOptimizer::OptimizeVertexCache(lod, (u32)vertices.size());
+
+        /* Each LOD is simplified from the previous one, so the errors add up */
+        error += mesh.lods[mesh.lodCount - 1].error;
+        mesh.lods[mesh.lodCount++] =
+            Components::LevelOfDetail{.firstIndex = (u32)indices.size(), .indexCount = (u32)lod.size(), .error = error};
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        previousLod = std::move(lod);
+    }
+
+    mStagedVertexBuffer.insert(mStagedVertexBuffer.end(), vertices.begin(), vertices.end());
+    if (mesh.indices.use16BitIndices)
+    {
+        mesh.indices.firstIndex = (u32)mStagedIndexBuffer16.size();
+        mStagedIndexBuffer16.insert(mStagedIndexBuffer16.end(), indices.begin(), indices.end());
+    }
+    else
+    {
+        mesh.indices.firstIndex = (u32)mStagedIndexBuffer32.size();
+        mStagedIndexBuffer32.insert(mStagedIndexBuffer32.end(), indices.begin(), indices.end());
+    }
+
+    for (u32 i = 0; i < mesh.lodCount; ++i)
+    {
+        mesh.lods[i].firstIndex += mesh.indices.firstIndex;
+    }
+
+    mMeshes[mesh.path] = mesh;
+    return mesh;
+}
+
+std::span<VertexPositionNormal const> Game::GetMeshVertices(Components::Mesh const &mesh) const
+{
+    return std::span(mStagedVertexBuffer).subspan(mesh.indices.firstVertex, mesh.indices.vertexCount);
+}
+
+Systems::TriangleMeshData Game::GetMeshTriangles(Components::Mesh const &mesh) const
+{
+    Systems::TriangleMeshData triangles{.vertices = GetMeshVertices(mesh)};
+    if (mesh.indices.use16BitIndices)
+    {
+        triangles.indices16 = std::span(mStagedIndexBuffer16).subspan(mesh.indices.firstIndex, mesh.lods[0].indexCount);
+    }
+    else
+    {
+        triangles.indices32 = std::span(mStagedIndexBuffer32).subspan(mesh.indices.firstIndex, mesh.lods[0].indexCount);
+    }
+    return triangles;
+}
+
 Entity *Game::AddTestEntity(std::string_view name)
 {
-    Entity *entity = mEntityArena.Allocate(1, mRegistry.create(), mRegistry);
+    Entity *entity = mEntityPool.Allocate(mRegistry.create(), mRegistry);
 
-    glm::mat4x4 world = glm::identity<glm::mat4x4>();
-    world = glm::translate(world, glm::vec3(0.0f, 5.0f, 0.0f));
-    entity->AddComponent(Components::Base{
-        .world = world, .name = std::string(name), .inverseWorld = glm::inverse(world), .entityPtr = entity});
-    entity->AddComponent(
-        Components::Update{.dirtyFrames = Constants::MAX_IN_FLIGHT_FRAMES, .bufferIndex = (u32)mEntities.size()});
-    mRegistry.on_update<Components::Base>().connect<&Entity::UpdateBase>(entity);
-    entity->UpdateBase();
+    Components::Transform transform{.position = glm::vec3(0.0f, 5.0f, 0.0f)};
+    glm::mat4x4 world = glm::translate(glm::identity<glm::mat4x4>(), transform.position);
+    entity->AddComponent(std::move(transform));
+    entity->AddComponent(Components::Base{.world = world});
+    entity->AddComponent(Components::Name{.name = std::string(name)});
+    entity->AddComponent(Components::EntityRef{.entity = entity});
+    entity->AddComponent(Components::Update{.bufferIndex = (u32)mEntities.size()});
 
     entity->AddComponent(InitGeometry("cube"));
-    entity->AddComponent(mPhysicsSystem.CreateRigidBody(entity->GetComponent<Components::Base>(),
-                                                        entity->GetComponent<Components::Mesh>(), 1.0f));
+    auto const &mesh = entity->GetComponent<Components::Mesh>();
+    entity->AddComponent(mPhysicsSystem.CreateRigidBody(*entity, entity->GetComponent<Components::Base>(), mesh,
+                                                        GetMeshVertices(mesh), 1.0f));
 
     mEntities.push_back(entity);
 
@@ -261,21 +350,20 @@ Entity *Game::AddTestEntity(std::string_view name)
 
 Entity *Game::AddGround()
 {
-    Entity *entity = mEntityArena.Allocate(1, mRegistry.create(), mRegistry);
+    Entity *entity = mEntityPool.Allocate(mRegistry.create(), mRegistry);
 
+    Components::Transform transform{.position = glm::vec3(0.0f, -50.0f, 0.0f), .scale = glm::vec3(50.f, 50.f, 50.f)};
     glm::mat4x4 world = glm::identity<glm::mat4x4>();
-    world = glm::translate(world, glm::vec3(0.0f, -50.0f, 0.0f));
-    world = glm::scale(world, glm::vec3(50.f, 50.f, 50.f));
-    entity->AddComponent(Components::Base{
-        .world = world, .name = std::string("Ground"), .inverseWorld = glm::inverse(world), .entityPtr = entity});
-    entity->AddComponent(
-        Components::Update{.dirtyFrames = Constants::MAX_IN_FLIGHT_FRAMES, .bufferIndex = (u32)mEntities.size()});
-    mRegistry.on_update<Components::Base>().connect<&Entity::UpdateBase>(entity);
-    entity->UpdateBase();
-
+    world = glm::translate(world, transform.position);
+    world = glm::scale(world, transform.scale);
+    entity->AddComponent(std::move(transform));
+    entity->AddComponent(Components::Base{.world = world});
+    entity->AddComponent(Components::Name{.name = std::string("Ground")});
+    entity->AddComponent(Components::EntityRef{.entity = entity});
+    entity->AddComponent(Components::Update{.bufferIndex = (u32)mEntities.size()});
+
+    /* The rigid body is added by InitScene */
     entity->AddComponent(InitGeometry("cube"));
-    entity->AddComponent(mPhysicsSystem.CreateRigidBody(entity->GetComponent<Components::Base>(),
-                                                        entity->GetComponent<Components::Mesh>(), 0.0f));
 
     mEntities.push_back(entity);
 
@@ -315,10 +403,9 @@ void Game::Update(float dt)
     if (application->IsKeyPressed(GLFW_KEY_SPACE))
     {
         auto &rigidBody = mEntities[0]->GetComponent<Components::RigidBody>();
-        rigidBody.rigidBody->activate(true);
-        rigidBody.rigidBody->applyCentralImpulse(btVector3(0.003f, 0.1f, 0.0f));
-        btVector3 spin(0, 5, 5); // Spin around the Y-axis
-        rigidBody.rigidBody->setAngularVelocity(spin);
+        mPhysicsSystem.ApplyCentralImpulse(rigidBody.body, glm::vec3(0.003f, 0.1f, 0.0f));
+        glm::vec3 spin(0, 5, 5); // Spin around the Y-axis
+        mPhysicsSystem.SetAngularVelocity(rigidBody.body, spin);
     }
 
     auto mouseMovement = application->GetMouseRelativePosition();
@@ -331,23 +418,60 @@ void Game::Update(float dt)
         mBasicRenderSystem.UpdateCamera(mCamera);
     }
 
-    mPhysicsSystem.Update(dt, mRegistry);
+    mPhysicsSystem.Update(mRegistry);
+    if (mState.isDeveloper)
+    {
+        mPhysicsDebug.Submit(mBatchRenderer);
+    }
+    mTransformSystem.Update(mRegistry);
 }
 
 void Game::Render()
 {
     auto &cmdList = mPerFrameResources[mCurrentFrame].commandList;
     auto &isCmdListDone = mPerFrameResources[mCurrentFrame].isCommandListDone;
+    auto &scratch = mPerFrameResources[mCurrentFrame].scratch;
 
     isCmdListDone.Wait();
     isCmdListDone.Reset();
+    scratch.Reset();
+
+    u32 objectCount = (u32)mEntities.size();
+    mBasicRenderSystem.Update(mCurrentFrame, mRegistry, objectCount);
+    /* Both are kept up to date so the culling path can be switched at any time */
+    mCullingSystem.UpdateBounds(mRegistry);
+    mGPUCullingSystem.UpdateObjects(mRegistry, objectCount);
+    std::pmr::vector<entt::entity> visibleEntities(&scratch);
+    if (!mState.useGPUCulling)
+    {
+        mCullingSystem.Cull(mCamera.GetProjection() * mCamera.GetView(), visibleEntities);
+    }
 
     cmdList.Begin();
     {
         f32 backgroundColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
-        cmdList.BeginRenderingOnBackbuffer(backgroundColor, &mDepthImage, false);
-        mBasicRenderSystem.Render(cmdList, mCurrentFrame, mRegistry, mEntities.size());
-        mBatchRenderer.Render(cmdList, mCamera);
+        if (mState.useGPUCulling)
+        {
+            /* Draw what the last frame's depth doesn't hide, then retry what it hid against the new depth */
+            mGPUCullingSystem.Cull(cmdList, mCurrentFrame, mCamera, mBasicRenderSystem.GetWorldBuffer(),
+                                   mDepthPyramid);
+            cmdList.BeginRenderingOnBackbuffer(backgroundColor, &mDepthImage, false);
+            mBasicRenderSystem.RenderIndirect(cmdList, mCurrentFrame, mGPUCullingSystem,
+                                              Systems::GPUCulling::Pass::Early);
+            cmdList.EndRendering();
+
+            mDepthPyramid.Build(cmdList, mDepthImage);
+            mGPUCullingSystem.CullLate(cmdList, mCurrentFrame);
+            cmdList.ResumeRenderingOnBackbuffer(&mDepthImage, false);
+            mBasicRenderSystem.RenderIndirect(cmdList, mCurrentFrame, mGPUCullingSystem,
+                                              Systems::GPUCulling::Pass::Late);
+        }
+        else
+        {
+            cmdList.BeginRenderingOnBackbuffer(backgroundColor, &mDepthImage, false);
+            mBasicRenderSystem.Render(cmdList, mCurrentFrame, mRegistry, visibleEntities);
+        }
+        mBatchRenderer.Render(cmdList, mCurrentFrame, mCamera);
         cmdList.EndRendering();
     }
     cmdList.End();
@@ -2,9 +2,13 @@
 
 #include "Gameplay/PhysicsDebugDraw.h"
 #include "Gameplay/Systems/BasicRendering.h"
+#include "Gameplay/Systems/Culling.h"
+#include "Gameplay/Systems/GPUCulling.h"
 #include "Gameplay/Systems/Physics.h"
+#include "Gameplay/Systems/TransformSystem.h"
 #include "Gameplay/Systems/UpdateFrame.h"
-#include "MemoryArena.h"
+#include "LinearAllocator.h"
+#include "PoolAllocator.h"
 #include "Singletone.h"
 #include "entt/entt.hpp"
 
@@ -16,10 +20,13 @@
 #include "Gameplay/Entity.h"
 
 #include "Renderer/BatchRenderer.h"
+#include "Renderer/DepthPyramid.h"
 #include "Renderer/Vulkan/Buffer.h"
 #include "Renderer/Vulkan/CommandList.h"
 #include "Renderer/Vulkan/SynchronizationObjects.h"
+#include <span>
 #include <string_view>
+#include <unordered_map>
 
 struct GameState
 {
@@ -29,6 +36,10 @@ struct GameState
 #else
         false;
 #endif /* DEBUG */
+    /* Cull (frustum and occlusion) and select LODs in a compute shader and
+     * draw with indirect count instead of doing it on the CPU. Disabled when
+     * the device can't do it. */
+    bool useGPUCulling = true;
 };
 
 class Game : public Jnrlib::ISingletone<Game>
@@ -56,6 +67,11 @@ private:
     void InitSizeDependentResources();
 
     Components::Mesh InitGeometry(std::string_view path);
+    std::span<VertexPositionNormal const> GetMeshVertices(Components::Mesh const &mesh) const;
+    /* Full detail triangles only */
+    Systems::TriangleMeshData GetMeshTriangles(Components::Mesh const &mesh) const;
+    Components::Mesh AddGeometry(std::string_view path, std::vector<VertexPositionNormal> vertices,
+                                 std::vector<u32> indices);
 
 private:
     void BakeRenderingBuffers(Vulkan::CommandList &initCommandList);
@@ -66,10 +82,15 @@ private:
 private:
     struct PerFrameResource
     {
+        static constexpr const size_t SCRATCH_SIZE = 1024 * 1024;
+
         Vulkan::CommandList commandList;
         Vulkan::CPUSynchronizationObject isCommandListDone;
+        /* Temporaries that live until the frame is done, reset once isCommandListDone is signaled */
+        Jnrlib::LinearAllocator scratch;
 
-        PerFrameResource() : commandList(Vulkan::CommandListType::Graphics), isCommandListDone(true)
+        PerFrameResource()
+            : commandList(Vulkan::CommandListType::Graphics), isCommandListDone(true), scratch(SCRATCH_SIZE)
         {
             commandList.Init();
         }
@@ -79,16 +100,25 @@ private:
 
     GameState mState;
 
+    /* The staged buffers are kept in full precision, vertices get packed only when uploaded to the GPU */
     Vulkan::Buffer mGlobalVertexBuffer;
-    Vulkan::Buffer mGlobalIndexBuffer;
+    Vulkan::Buffer mGlobalIndexBuffer16;
+    Vulkan::Buffer mGlobalIndexBuffer32;
     std::vector<VertexPositionNormal> mStagedVertexBuffer;
-    std::vector<u32> mStagedIndexBuffer;
+    std::vector<u16> mStagedIndexBuffer16;
+    std::vector<u32> mStagedIndexBuffer32;
+    std::unordered_map<std::string, Components::Mesh> mMeshes;
 
     Systems::UpdateFrame mUpdateFrameSystem;
     Systems::Physics mPhysicsSystem;
+    Systems::TransformSystem mTransformSystem;
     Systems::BasicRendering::RenderSystem mBasicRenderSystem;
+    Systems::Culling mCullingSystem;
+    Systems::GPUCulling mGPUCullingSystem;
 
     Vulkan::Image mDepthImage;
+    /* Built from mDepthImage every frame for occlusion culling (GPU culling only) */
+    DepthPyramid mDepthPyramid;
 
     Camera mCamera;
 
@@ -98,5 +128,5 @@ private:
     /* TODO: Ideally merge these two into a single class */
     entt::registry mRegistry;
     std::vector<Entity *> mEntities;
-    MemoryArena<1024, Entity> mEntityArena;
+    PoolAllocator<Entity> mEntityPool;
 };
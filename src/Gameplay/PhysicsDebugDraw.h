@@ -3,14 +3,43 @@
 #include "Check.h"
 #include "LinearMath/btIDebugDraw.h"
 #include "Renderer/BatchRenderer.h"
+#include "TripleBuffer.h"
 #include "Utils/Vertex.h"
 
+#include <array>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+
+/* Bullet draws from the physics thread, the lines are collected there and
+ * handed to the main thread once the world was drawn. Shapes Bullet has a
+ * dedicated call for become one instance of a unit mesh instead of a dozen
+ * lines. */
 class PhysicsDebugDraw : public btIDebugDraw
 {
+    struct DrawnWorld
+    {
+        std::vector<VertexPositionColor> lines;
+        std::array<std::vector<DebugPrimitiveInstance>, (u32)DebugPrimitive::Count> primitives;
+    };
+
 public:
     PhysicsDebugDraw() = default;
-    PhysicsDebugDraw(BatchRenderer *batchRenderer) : mBatchRenderer(batchRenderer)
+
+    /* Main thread, replaces the batch's contents with the latest drawn world */
+    void Submit(BatchRenderer &batchRenderer)
     {
+        if (!mDrawnWorld.Update())
+        {
+            return;
+        }
+
+        auto const &drawnWorld = mDrawnWorld.GetReadBuffer();
+        batchRenderer.Clear();
+        batchRenderer.AddLines(drawnWorld.lines);
+        for (u32 i = 0; i < (u32)DebugPrimitive::Count; ++i)
+        {
+            batchRenderer.AddPrimitives((DebugPrimitive)i, drawnWorld.primitives[i]);
+        }
     }
 
     virtual void drawLine(const btVector3 &from, const btVector3 &to, const btVector3 &color) override
@@ -21,10 +50,60 @@ public:
     virtual void drawLine(const btVector3 &from, const btVector3 &to, const btVector3 &fromColor,
                           const btVector3 &toColor) override
     {
-        VertexPositionColor v1(from.x(), from.y(), from.z(), fromColor.x(), fromColor.y(), fromColor.z(), 1.0f);
-        VertexPositionColor v2(to.x(), to.y(), to.z(), toColor.x(), toColor.y(), toColor.z(), 1.0f);
-        mBatchRenderer->AddVertex(v1);
-        mBatchRenderer->AddVertex(v2);
+        auto &lines = mDrawnWorld.GetWriteBuffer().lines;
+        lines.emplace_back(from.x(), from.y(), from.z(), fromColor.x(), fromColor.y(), fromColor.z(), 1.0f);
+        lines.emplace_back(to.x(), to.y(), to.z(), toColor.x(), toColor.y(), toColor.z(), 1.0f);
+    }
+
+    virtual void drawSphere(btScalar radius, const btTransform &transform, const btVector3 &color) override
+    {
+        AddPrimitive(DebugPrimitive::Sphere, glm::scale(ToMatrix(transform), glm::vec3((f32)radius)), color);
+    }
+
+    virtual void drawBox(const btVector3 &bbMin, const btVector3 &bbMax, const btVector3 &color) override
+    {
+        AddPrimitive(DebugPrimitive::Box, GetBoxMatrix(bbMin, bbMax), color);
+    }
+
+    virtual void drawBox(const btVector3 &bbMin, const btVector3 &bbMax, const btTransform &transform,
+                         const btVector3 &color) override
+    {
+        AddPrimitive(DebugPrimitive::Box, ToMatrix(transform) * GetBoxMatrix(bbMin, bbMax), color);
+    }
+
+    virtual void drawAabb(const btVector3 &from, const btVector3 &to, const btVector3 &color) override
+    {
+        AddPrimitive(DebugPrimitive::Box, GetBoxMatrix(from, to), color);
+    }
+
+    virtual void drawCapsule(btScalar radius, btScalar halfHeight, int upAxis, const btTransform &transform,
+                             const btVector3 &color) override
+    {
+        glm::mat4x4 world = ToMatrix(transform) * GetUpAxisMatrix(upAxis);
+        f32 scaledRadius = (f32)radius;
+        AddPrimitive(DebugPrimitive::Cylinder,
+                     glm::scale(world, glm::vec3(scaledRadius, (f32)halfHeight, scaledRadius)), color);
+
+        glm::mat4x4 top = glm::translate(world, glm::vec3(0.0f, (f32)halfHeight, 0.0f));
+        AddPrimitive(DebugPrimitive::Hemisphere, glm::scale(top, glm::vec3(scaledRadius)), color);
+        /* Mirrored to face down */
+        glm::mat4x4 bottom = glm::translate(world, glm::vec3(0.0f, -(f32)halfHeight, 0.0f));
+        AddPrimitive(DebugPrimitive::Hemisphere,
+                     glm::scale(bottom, glm::vec3(scaledRadius, -scaledRadius, scaledRadius)), color);
+    }
+
+    virtual void drawCylinder(btScalar radius, btScalar halfHeight, int upAxis, const btTransform &transform,
+                              const btVector3 &color) override
+    {
+        glm::mat4x4 world = ToMatrix(transform) * GetUpAxisMatrix(upAxis);
+        AddPrimitive(DebugPrimitive::Cylinder,
+                     glm::scale(world, glm::vec3((f32)radius, (f32)halfHeight, (f32)radius)), color);
+    }
+
+    virtual void drawTransform(const btTransform &transform, btScalar orthoLen) override
+    {
+        AddPrimitive(DebugPrimitive::Axes, glm::scale(ToMatrix(transform), glm::vec3((f32)orthoLen)),
+                     btVector3(1.0f, 1.0f, 1.0f));
     }
 
     virtual void drawContactPoint(const btVector3 &PointOnB, const btVector3 &normalOnB, btScalar distance,
@@ -52,9 +131,63 @@ public:
 
     virtual void clearLines() override
     {
-        mBatchRenderer->Clear();
+        auto &drawnWorld = mDrawnWorld.GetWriteBuffer();
+        drawnWorld.lines.clear();
+        for (auto &primitives : drawnWorld.primitives)
+        {
+            primitives.clear();
+        }
     }
 
-public:
-    BatchRenderer *mBatchRenderer;
+    virtual void flushLines() override
+    {
+        mDrawnWorld.Publish();
+    }
+
+private:
+    void AddPrimitive(DebugPrimitive primitive, glm::mat4x4 const &world, const btVector3 &color)
+    {
+        mDrawnWorld.GetWriteBuffer().primitives[(u32)primitive].emplace_back(
+            world, glm::vec4(color.x(), color.y(), color.z(), 1.0f));
+    }
+
+    static glm::mat4x4 ToMatrix(const btTransform &transform)
+    {
+        auto const &basis = transform.getBasis();
+        auto const &origin = transform.getOrigin();
+        glm::mat4x4 world(1.0f);
+        for (u32 column = 0; column < 3; ++column)
+        {
+            for (u32 row = 0; row < 3; ++row)
+            {
+                world[column][row] = (f32)basis[row][column];
+            }
+        }
+        world[3] = glm::vec4(origin.x(), origin.y(), origin.z(), 1.0f);
+        return world;
+    }
+
+    /* Maps the unit box onto [bbMin, bbMax] */
+    static glm::mat4x4 GetBoxMatrix(const btVector3 &bbMin, const btVector3 &bbMax)
+    {
+        btVector3 center = (bbMin + bbMax) * btScalar(0.5);
+        btVector3 halfExtents = (bbMax - bbMin) * btScalar(0.5);
+        glm::mat4x4 world = glm::translate(glm::mat4x4(1.0f), glm::vec3(center.x(), center.y(), center.z()));
+        return glm::scale(world, glm::vec3(halfExtents.x(), halfExtents.y(), halfExtents.z()));
+    }
+
+    /* Turns the Y axis of the unit meshes into Bullet's up axis, cycling the
+     * axes keeps it a rotation */
+    static glm::mat4x4 GetUpAxisMatrix(int upAxis)
+    {
+        glm::mat4x4 rotation(0.0f);
+        rotation[0][(upAxis + 2) % 3] = 1.0f;
+        rotation[1][upAxis] = 1.0f;
+        rotation[2][(upAxis + 1) % 3] = 1.0f;
+        rotation[3][3] = 1.0f;
+        return rotation;
+    }
+
+private:
+    TripleBuffer<DrawnWorld> mDrawnWorld;
 };
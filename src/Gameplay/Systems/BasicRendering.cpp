@@ -11,6 +11,9 @@
 #include "Utils/Constants.h"
 #include "Utils/Vertex.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace Systems
 {
 namespace BasicRendering
@@ -34,7 +37,6 @@ void RenderSystem::StateInit()
         mDescriptorSet.Bake(Constants::MAX_IN_FLIGHT_FRAMES);
     }
     {
-        mRootSignature.AddPushRange<u32>(0, 1);
         mRootSignature.AddDescriptorSet(&mDescriptorSet);
     }
     mRootSignature.Bake();
@@ -45,6 +47,8 @@ void RenderSystem::OnResize()
 {
     /* Create simple mPipeline */
     glm::vec2 windowDimensions = Application::Get()->GetWindowDimensions();
+    mViewportHeight = windowDimensions.y;
+
     VkViewport viewport = {};
     {
         viewport.width = windowDimensions.x;
@@ -87,8 +91,8 @@ void RenderSystem::OnResize()
         blendState.attachmentCount = 1;
         blendState.pAttachments = &attachmentInfo;
     }
-    auto vertexPositionAttributeDescription = VertexPositionNormal::GetInputAttributeDescription();
-    auto vertexPositionBindingDescription = VertexPositionNormal::GetInputBindingDescription();
+    auto vertexPositionAttributeDescription = VertexPositionNormalPacked::GetInputAttributeDescription();
+    auto vertexPositionBindingDescription = VertexPositionNormalPacked::GetInputBindingDescription();
     {
         auto &vertexInput = mPipeline.GetVertexInputStateCreateInfo();
         vertexInput.vertexAttributeDescriptionCount = (u32)vertexPositionAttributeDescription.size();
@@ -117,38 +121,74 @@ void RenderSystem::UpdateCamera(Camera const &camera)
 {
     auto viewProjectionMatrix = camera.GetProjection() * camera.GetView();
     mPerFrameBuffer.Copy(&viewProjectionMatrix);
-    mIsDirty = true;
+
+    mView = camera.GetView();
+    /* The projection is flipped on Y for Vulkan */
+    mProjectionScale = std::abs(camera.GetProjection()[1][1]);
+}
+
+u32 RenderSystem::SelectLevelOfDetail(Components::Base const &base, Components::Mesh const &mesh) const
+{
+    glm::vec3 center = glm::vec3(mView * base.world * glm::vec4(mesh.bounds.center, 1.0f));
+    f32 distance = std::max(glm::length(center), 0.01f);
+    f32 worldScale = std::max({glm::length(glm::vec3(base.world[0])), glm::length(glm::vec3(base.world[1])),
+                               glm::length(glm::vec3(base.world[2]))});
+    f32 pixelsPerUnit = mProjectionScale * mViewportHeight * 0.5f / distance;
+
+    for (u32 lod = mesh.lodCount - 1; lod > 0; --lod)
+    {
+        if (mesh.lods[lod].error * worldScale * pixelsPerUnit <= Constants::LOD_ERROR_THRESHOLD_PIXELS)
+        {
+            return lod;
+        }
+    }
+    return 0;
 }
+
 void RenderSystem::ResizeWorldBufferIfNeeded(u32 objectCount)
 {
     if (objectCount > mWorldBuffer.GetCount()) [[unlikely]]
     {
         mWorldBuffer = Vulkan::Buffer(sizeof(BasicPerObjectInfo), objectCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                                       VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-        mIsDirty = true;
+        mDirtyDescriptorInstances = ALL_DESCRIPTOR_INSTANCES;
+        mIsWorldBufferNew = true;
     }
 }
 
-void RenderSystem::Render(Vulkan::CommandList &cmdList, u32 currentFrameIndex, entt::registry const &registry,
-                          u32 objectCount)
+void RenderSystem::Update(u32 currentFrameIndex, entt::registry const &registry, u32 objectCount)
 {
     ResizeWorldBufferIfNeeded(objectCount);
 
-    auto updatables = registry.view<const Components::Base, const Components::Update>();
-    for (auto const &[entity, base, update] : updatables.each())
+    auto writeObject = [&](Components::Base const &base, Components::Update const &update,
+                           Components::Mesh const &mesh) {
+        auto *info = (BasicPerObjectInfo *)mWorldBuffer.GetElement(update.bufferIndex);
+        info->world = base.world;
+        info->positionScale = glm::vec4(mesh.quantization.scale, 0.0f);
+        info->positionOffset = glm::vec4(mesh.quantization.offset, 0.0f);
+    };
+
+    if (mIsWorldBufferNew) [[unlikely]]
     {
-        if (update.dirtyFrames)
+        /* The new buffer starts empty */
+        auto objects = registry.view<const Components::Base, const Components::Update, const Components::Mesh>();
+        for (auto const &[entity, base, update, mesh] : objects.each())
         {
-            auto *info = (BasicPerObjectInfo *)mWorldBuffer.GetElement(update.bufferIndex);
-            info->world = base.world;
-            mIsDirty = true;
+            writeObject(base, update, mesh);
+        }
+        mIsWorldBufferNew = false;
+    }
+    else
+    {
+        auto dirtyObjects = registry.view<const Components::Dirty, const Components::Base, const Components::Update,
+                                          const Components::Mesh>();
+        for (auto const &[entity, dirty, base, update, mesh] : dirtyObjects.each())
+        {
+            writeObject(base, update, mesh);
         }
     }
 
-    CHECK_FATAL(mVertexBuffer, "A vertex buffer was not specified");
-    CHECK_FATAL(mIndexBuffer, "A index buffer was not specified");
-
-    if (mIsDirty) [[unlikely]]
+    if (mDirtyDescriptorInstances & (1u << currentFrameIndex)) [[unlikely]]
     {
         /* TODO: To research if recording everything in a secondary command
          * buffer and just executing that instead of re-recording makes sense */
@@ -157,19 +197,69 @@ void RenderSystem::Render(Vulkan::CommandList &cmdList, u32 currentFrameIndex, e
         mDescriptorSet.BindStorageBuffer(mWorldBuffer, 0);
         mDescriptorSet.BindInputBuffer(mPerFrameBuffer, 1);
         mDescriptorSet.BindInputBuffer(mPerSceneBuffer, 2);
+        mDirtyDescriptorInstances &= ~(1u << currentFrameIndex);
     }
+}
+
+void RenderSystem::BindState(Vulkan::CommandList &cmdList, u32 currentFrameIndex)
+{
+    CHECK_FATAL(mVertexBuffer, "A vertex buffer was not specified");
+    CHECK_FATAL(mIndexBuffer16 && mIndexBuffer32, "The index buffers were not specified");
 
     cmdList.BindVertexBuffer(*mVertexBuffer, 0);
-    cmdList.BindIndexBuffer(*mIndexBuffer);
     cmdList.BindPipeline(mPipeline);
     cmdList.BindDescriptorSet(mDescriptorSet, currentFrameIndex, mRootSignature);
+}
+
+void RenderSystem::Render(Vulkan::CommandList &cmdList, u32 currentFrameIndex, entt::registry const &registry,
+                          std::span<entt::entity const> visibleEntities)
+{
+    BindState(cmdList, currentFrameIndex);
+
+    Vulkan::Buffer *boundIndexBuffer = nullptr;
+    auto meshes = registry.view<const Components::Base, const Components::Update, const Components::Mesh>();
+    for (auto entity : visibleEntities)
+    {
+        auto const &[base, update, mesh] = meshes.get(entity);
+
+        Vulkan::Buffer *indexBuffer = mesh.indices.use16BitIndices ? mIndexBuffer16 : mIndexBuffer32;
+        if (indexBuffer != boundIndexBuffer)
+        {
+            cmdList.BindIndexBuffer(*indexBuffer);
+            boundIndexBuffer = indexBuffer;
+        }
 
-    auto meshes = registry.view<const Components::Update, const Components::Mesh>();
-    for (auto const &[entity, update, mesh] : meshes.each())
+        /* The object index gets to the shader through gl_InstanceIndex */
+        auto const &lod = mesh.lods[SelectLevelOfDetail(base, mesh)];
+        cmdList.DrawIndexedInstanced(lod.indexCount, lod.firstIndex, mesh.indices.firstVertex, update.bufferIndex);
+    }
+}
+
+void RenderSystem::RenderIndirect(Vulkan::CommandList &cmdList, u32 currentFrameIndex, GPUCulling &gpuCulling,
+                                  GPUCulling::Pass pass)
+{
+    u32 maxDrawCount = gpuCulling.GetMaxDrawCount();
+    if (maxDrawCount == 0)
+    {
+        return;
+    }
+
+    BindState(cmdList, currentFrameIndex);
+
+    auto &drawCommands = gpuCulling.GetDrawCommands(currentFrameIndex);
+    auto &drawCounts = gpuCulling.GetDrawCounts(currentFrameIndex);
+
+    if (mIndexBuffer16->GetCount() != 0)
+    {
+        cmdList.BindIndexBuffer(*mIndexBuffer16);
+        cmdList.DrawIndexedIndirectCount(drawCommands, gpuCulling.GetDrawCommandsOffset(pass, false), drawCounts,
+                                         gpuCulling.GetDrawCountOffset(pass, false), maxDrawCount);
+    }
+    if (mIndexBuffer32->GetCount() != 0)
     {
-        u32 index = update.bufferIndex;
-        cmdList.BindPushRange<u32>(mRootSignature, 0, 1, &index);
-        cmdList.DrawIndexedInstanced(mesh.indices.indexCount, mesh.indices.firstIndex, mesh.indices.firstVertex);
+        cmdList.BindIndexBuffer(*mIndexBuffer32);
+        cmdList.DrawIndexedIndirectCount(drawCommands, gpuCulling.GetDrawCommandsOffset(pass, true), drawCounts,
+                                         gpuCulling.GetDrawCountOffset(pass, true), maxDrawCount);
     }
 }
 
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Gameplay/Camera.h"
+#include "Gameplay/Components/Base.h"
+#include "Gameplay/Components/Mesh.h"
+#include "Gameplay/Systems/GPUCulling.h"
 #include "Renderer/Vulkan/Buffer.h"
 #include "Renderer/Vulkan/CommandList.h"
 #include "Renderer/Vulkan/Pipeline.h"
@@ -8,6 +11,8 @@
 #include "Utils/Constants.h"
 #include "entt/entt.hpp"
 
+#include <span>
+
 namespace Systems
 {
 namespace BasicRendering
@@ -26,17 +31,36 @@ public:
 public:
     void OnResize();
     /**
-     * @brief Renders all the entities in registry. The output images must have
-     * been set before calling this.
+     * @brief Uploads the per object data of the entities that changed. Must be called every frame before any of the
+     * render functions.
+     */
+    void Update(u32 currentFrameIndex, entt::registry const &registry, u32 objectCount);
+    /**
+     * @brief Renders the visible entities of registry. The output images must
+     * have been set before calling this.
      */
-    void Render(Vulkan::CommandList &cmdList, u32 currentFrameIndex, entt::registry const &registry, u32 objectCount);
+    void Render(Vulkan::CommandList &cmdList, u32 currentFrameIndex, entt::registry const &registry,
+                std::span<entt::entity const> visibleEntities);
+    /**
+     * @brief Renders the draws generated on the GPU by a pass of gpuCulling for this frame
+     */
+    void RenderIndirect(Vulkan::CommandList &cmdList, u32 currentFrameIndex, GPUCulling &gpuCulling,
+                        GPUCulling::Pass pass);
     void UpdateCamera(Camera const &camera);
 
 public:
-    void SetRenderingBuffers(Vulkan::Buffer *vertexBuffer, Vulkan::Buffer *indexBuffer)
+    /* Contains BasicPerObjectInfo for each object, indexed by Components::Update::bufferIndex */
+    Vulkan::Buffer &GetWorldBuffer()
+    {
+        return mWorldBuffer;
+    }
+
+    void SetRenderingBuffers(Vulkan::Buffer *vertexBuffer, Vulkan::Buffer *indexBuffer16,
+                             Vulkan::Buffer *indexBuffer32)
     {
         mVertexBuffer = vertexBuffer;
-        mIndexBuffer = indexBuffer;
+        mIndexBuffer16 = indexBuffer16;
+        mIndexBuffer32 = indexBuffer32;
     }
 
     void SetDirectionalLight(Vulkan::CommandList &cmdList, glm::vec3 direction, glm::vec4 color, glm::vec4 ambient)
@@ -55,6 +79,7 @@ public:
 
         cmdList.CopyBuffer(mPerSceneBuffer, stagingBuffer);
         cmdList.AddLocalBuffer(std::move(stagingBuffer));
+        mDirtyDescriptorInstances = ALL_DESCRIPTOR_INSTANCES;
     }
 
 private:
@@ -70,6 +95,13 @@ private:
 private:
     void StateInit();
     void ResizeWorldBufferIfNeeded(u32 objectCount);
+    void BindState(Vulkan::CommandList &cmdList, u32 currentFrameIndex);
+
+    /**
+     * @brief Picks the coarsest LOD whose simplification error projects to less than
+     * Constants::LOD_ERROR_THRESHOLD_PIXELS
+     */
+    u32 SelectLevelOfDetail(Components::Base const &base, Components::Mesh const &mesh) const;
 
 private:
     Vulkan::Pipeline mPipeline;
@@ -77,13 +109,22 @@ private:
     Vulkan::DescriptorSet mDescriptorSet;
 
     Vulkan::Buffer *mVertexBuffer = nullptr;
-    Vulkan::Buffer *mIndexBuffer = nullptr;
+    Vulkan::Buffer *mIndexBuffer16 = nullptr;
+    Vulkan::Buffer *mIndexBuffer32 = nullptr;
 
     Vulkan::Buffer mWorldBuffer;
     Vulkan::Buffer mPerFrameBuffer;
     Vulkan::Buffer mPerSceneBuffer;
 
-    bool mIsDirty = true;
+    /* Used to project the LOD errors on screen */
+    glm::mat4x4 mView = glm::mat4x4(1.0f);
+    f32 mProjectionScale = 1.0f;
+    f32 mViewportHeight = 1.0f;
+
+    /* Bit i is set when the buffers bound to descriptor set instance i were recreated */
+    static constexpr const u32 ALL_DESCRIPTOR_INSTANCES = (1u << Constants::MAX_IN_FLIGHT_FRAMES) - 1;
+    u32 mDirtyDescriptorInstances = ALL_DESCRIPTOR_INSTANCES;
+    bool mIsWorldBufferNew = false;
 };
 
 } // namespace BasicRendering
@@ -0,0 +1,200 @@
+#include "Culling.h"
+
+#include "Gameplay/Components/Base.h"
+#include "Gameplay/Components/Mesh.h"
+#include "Gameplay/Components/Update.h"
+
+#include <array>
+#include <bit>
+#include <cmath>
+
+/* CULLING_FORCE_SCALAR keeps the portable path on any CPU, so benchmarks can compare it with the SIMD one */
+#if defined(CULLING_FORCE_SCALAR)
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_USE_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CULLING_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+constexpr const u32 LANE_COUNT = 4;
+
+using Frustum = std::array<glm::vec4, 6>;
+
+/* Returns a bit for each of the 4 boxes that intersects the frustum */
+u32 TestBoxes(Frustum const &frustum, f32 const *cx, f32 const *cy, f32 const *cz, f32 const *ex, f32 const *ey,
+              f32 const *ez)
+{
+#if CULLING_USE_SSE
+    __m128 centerX = _mm_loadu_ps(cx), centerY = _mm_loadu_ps(cy), centerZ = _mm_loadu_ps(cz);
+    __m128 extentX = _mm_loadu_ps(ex), extentY = _mm_loadu_ps(ey), extentZ = _mm_loadu_ps(ez);
+    __m128 zero = _mm_setzero_ps();
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+
+    for (auto const &plane : frustum)
+    {
+        /* Signed distance of the center plus the projected radius of the box onto the plane normal */
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)),
+                                                _mm_mul_ps(centerY, _mm_set1_ps(plane.y))),
+                                     _mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX, _mm_set1_ps(std::abs(plane.x))),
+                                              _mm_mul_ps(extentY, _mm_set1_ps(std::abs(plane.y)))),
+                                   _mm_mul_ps(extentZ, _mm_set1_ps(std::abs(plane.z))));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+    }
+
+    return (u32)_mm_movemask_ps(inside);
+#elif CULLING_USE_NEON
+    float32x4_t centerX = vld1q_f32(cx), centerY = vld1q_f32(cy), centerZ = vld1q_f32(cz);
+    float32x4_t extentX = vld1q_f32(ex), extentY = vld1q_f32(ey), extentZ = vld1q_f32(ez);
+    uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+
+    for (auto const &plane : frustum)
+    {
+        float32x4_t distance = vmlaq_n_f32(vdupq_n_f32(plane.w), centerX, plane.x);
+        distance = vmlaq_n_f32(distance, centerY, plane.y);
+        distance = vmlaq_n_f32(distance, centerZ, plane.z);
+
+        float32x4_t radius = vmulq_n_f32(extentX, std::abs(plane.x));
+        radius = vmlaq_n_f32(radius, extentY, std::abs(plane.y));
+        radius = vmlaq_n_f32(radius, extentZ, std::abs(plane.z));
+
+        inside = vandq_u32(inside, vcgeq_f32(vaddq_f32(distance, radius), vdupq_n_f32(0.0f)));
+    }
+
+    static constexpr const u32 laneBits[LANE_COUNT] = {1, 2, 4, 8};
+    uint32x4_t bits = vandq_u32(inside, vld1q_u32(laneBits));
+    uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+    return vget_lane_u32(vpadd_u32(sum, sum), 0);
+#else
+    u32 result = 0;
+    for (u32 i = 0; i < LANE_COUNT; ++i)
+    {
+        bool inside = true;
+        for (auto const &plane : frustum)
+        {
+            f32 distance = cx[i] * plane.x + cy[i] * plane.y + cz[i] * plane.z + plane.w;
+            f32 radius = ex[i] * std::abs(plane.x) + ey[i] * std::abs(plane.y) + ez[i] * std::abs(plane.z);
+            inside &= distance + radius >= 0.0f;
+        }
+        result |= (u32)inside << i;
+    }
+    return result;
+#endif
+}
+} // namespace
+
+namespace Systems
+{
+
+char const *Culling::GetInstructionSet()
+{
+#if CULLING_USE_SSE
+    return "sse";
+#elif CULLING_USE_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+std::array<glm::vec4, 6> Culling::ExtractFrustumPlanes(glm::mat4x4 const &m)
+{
+    auto row = [&](u32 i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+    /* Camera uses the -1..1 depth range. The planes are not normalized, the box test only depends on the sign */
+    return {r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2};
+}
+
+void Culling::Resize(u32 count)
+{
+    count = (count + LANE_COUNT - 1) / LANE_COUNT * LANE_COUNT;
+    if (count <= mEntities.size())
+    {
+        return;
+    }
+
+    mEntities.resize(count, entt::null);
+    mCenterX.resize(count, 0.0f);
+    mCenterY.resize(count, 0.0f);
+    mCenterZ.resize(count, 0.0f);
+    mExtentX.resize(count, 0.0f);
+    mExtentY.resize(count, 0.0f);
+    mExtentZ.resize(count, 0.0f);
+}
+
+void Culling::Connect(entt::registry &registry)
+{
+    /* Both fire before the component is gone, so the entity's Update is still there */
+    registry.on_destroy<Components::Update>().connect<&Culling::OnBoundsRemoved>(this);
+    registry.on_destroy<Components::Mesh>().connect<&Culling::OnBoundsRemoved>(this);
+}
+
+void Culling::OnBoundsRemoved(entt::registry &registry, entt::entity entity)
+{
+    auto const *update = registry.try_get<Components::Update>(entity);
+    if (update != nullptr && update->bufferIndex < mEntities.size() && mEntities[update->bufferIndex] == entity)
+    {
+        /* The next entity given this slot fills it again when it is dirty */
+        mEntities[update->bufferIndex] = entt::null;
+    }
+}
+
+void Culling::UpdateBounds(entt::registry const &registry)
+{
+    auto updatables = registry.view<const Components::Dirty, const Components::Base, const Components::Update,
+                                    const Components::Mesh>();
+    for (auto const &[entity, dirty, base, update, mesh] : updatables.each())
+    {
+        if (update.bufferIndex >= mEntities.size()) [[unlikely]]
+        {
+            Resize(update.bufferIndex + 1);
+        }
+
+        /* Transform the box center and take the absolute value of the rotation to get the new extents (Arvo) */
+        glm::mat4x4 const &world = base.world;
+        glm::vec3 center = glm::vec3(world * glm::vec4(mesh.bounds.center, 1.0f));
+        glm::vec3 extents = glm::abs(glm::vec3(world[0])) * mesh.bounds.extents.x +
+                            glm::abs(glm::vec3(world[1])) * mesh.bounds.extents.y +
+                            glm::abs(glm::vec3(world[2])) * mesh.bounds.extents.z;
+
+        u32 index = update.bufferIndex;
+        mEntities[index] = entity;
+        mCenterX[index] = center.x;
+        mCenterY[index] = center.y;
+        mCenterZ[index] = center.z;
+        mExtentX[index] = extents.x;
+        mExtentY[index] = extents.y;
+        mExtentZ[index] = extents.z;
+    }
+}
+
+void Culling::Cull(glm::mat4x4 const &viewProjection, std::pmr::vector<entt::entity> &visibleEntities) const
+{
+    /* Reserve the worst case up front, growing would leave dead copies behind in a linear allocator */
+    visibleEntities.clear();
+    visibleEntities.reserve(mEntities.size());
+
+    Frustum frustum = ExtractFrustumPlanes(viewProjection);
+    for (u32 i = 0; i < (u32)mEntities.size(); i += LANE_COUNT)
+    {
+        u32 mask = TestBoxes(frustum, &mCenterX[i], &mCenterY[i], &mCenterZ[i], &mExtentX[i], &mExtentY[i],
+                             &mExtentZ[i]);
+        while (mask)
+        {
+            u32 lane = std::countr_zero(mask);
+            mask &= mask - 1;
+
+            if (mEntities[i + lane] != entt::null)
+            {
+                visibleEntities.push_back(mEntities[i + lane]);
+            }
+        }
+    }
+}
+
+} // namespace Systems
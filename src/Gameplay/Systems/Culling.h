@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Jnrlib.h"
+#include "entt/entt.hpp"
+
+#include <array>
+#include <glm/glm.hpp>
+#include <memory_resource>
+#include <vector>
+
+namespace Systems
+{
+/* Keeps the world space bounding boxes of every entity with a mesh in
+ * structure-of-arrays form (indexed by Components::Update::bufferIndex) and
+ * tests them four at a time against a frustum. It doesn't depend on the
+ * camera, so any view (main camera, shadow cascades, ...) can cull against
+ * the same cache. */
+class Culling
+{
+public:
+    /**
+     * @brief Listens for entities losing their mesh or buffer slot, so Cull
+     * never returns them
+     */
+    void Connect(entt::registry &registry);
+
+    /**
+     * @brief Recomputes the world space bounds of every entity whose
+     * Components::Base changed in the last frames
+     */
+    void UpdateBounds(entt::registry const &registry);
+
+    /**
+     * @brief Fills visibleEntities with the entities whose bounds intersect the
+     * frustum described by viewProjection
+     */
+    void Cull(glm::mat4x4 const &viewProjection, std::pmr::vector<entt::entity> &visibleEntities) const;
+
+    /**
+     * @brief Gribb-Hartmann extraction of the (not normalized) frustum planes
+     * of viewProjection. A point p is inside if dot(plane.xyz, p) + plane.w >= 0
+     * for every plane.
+     */
+    static std::array<glm::vec4, 6> ExtractFrustumPlanes(glm::mat4x4 const &viewProjection);
+
+    /* "sse", "neon" or "scalar", whichever path Cull was compiled with */
+    static char const *GetInstructionSet();
+
+    u32 GetBoundsCount() const
+    {
+        return (u32)mEntities.size();
+    }
+
+private:
+    void Resize(u32 count);
+    void OnBoundsRemoved(entt::registry &registry, entt::entity entity);
+
+private:
+    /* Padded to a multiple of 4, unused slots hold entt::null */
+    std::vector<entt::entity> mEntities;
+
+    std::vector<f32> mCenterX;
+    std::vector<f32> mCenterY;
+    std::vector<f32> mCenterZ;
+    std::vector<f32> mExtentX;
+    std::vector<f32> mExtentY;
+    std::vector<f32> mExtentZ;
+};
+} // namespace Systems
@@ -0,0 +1,224 @@
+#include "GPUCulling.h"
+
+#include "Application.h"
+
+#include "Gameplay/Components/Mesh.h"
+#include "Gameplay/Components/Update.h"
+#include "Gameplay/Systems/Culling.h"
+#include "Renderer/ShaderStructs.h"
+
+#include <cmath>
+
+namespace Systems
+{
+GPUCulling::GPUCulling() : mPipeline("GPUCullingPipeline")
+{
+    {
+        mDescriptorSet.AddStorageBuffer(0, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        mDescriptorSet.AddStorageBuffer(1, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        mDescriptorSet.AddInputBuffer(2, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        mDescriptorSet.AddStorageBuffer(3, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        mDescriptorSet.AddStorageBuffer(4, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        mDescriptorSet.AddCombinedImageSampler(5, nullptr, VK_SHADER_STAGE_COMPUTE_BIT);
+        mDescriptorSet.AddStorageBuffer(6, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        mDescriptorSet.Bake(Constants::MAX_IN_FLIGHT_FRAMES);
+    }
+    {
+        mRootSignature.AddPushRange<GPUCullingPushConstant>(0, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        mRootSignature.AddDescriptorSet(&mDescriptorSet);
+    }
+    mRootSignature.Bake();
+
+    mPipeline.SetRootSignature(&mRootSignature);
+    mPipeline.SetShader("cull.comp.spv");
+    mPipeline.Bake();
+
+    for (auto &resource : mPerFrameResources)
+    {
+        resource.frameInfo = Vulkan::Buffer(sizeof(GPUCullingFrameInfo), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+        resource.drawCounts = Vulkan::Buffer(sizeof(u32), REGION_COUNT,
+                                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    }
+
+    OnResize();
+}
+
+void GPUCulling::OnResize()
+{
+    mViewportHeight = Application::Get()->GetWindowDimensions().y;
+}
+
+void GPUCulling::ResizeIfNeeded(u32 objectCount)
+{
+    if (objectCount <= mMaxDrawCount) [[likely]]
+    {
+        return;
+    }
+
+    /* Wait for the frames in flight to finish using the old buffers */
+    Vulkan::Renderer::Get()->WaitIdle();
+
+    /* The objects are written from the registry on the next update, so
+     * there's no need to copy the old contents */
+    mMaxDrawCount = objectCount;
+    mObjectBuffer = Vulkan::Buffer(sizeof(GPUCullingObjectInfo), objectCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                   VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    mVisibilityBuffer = Vulkan::Buffer(sizeof(u32), objectCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    for (auto &resource : mPerFrameResources)
+    {
+        resource.drawCommands =
+            Vulkan::Buffer(sizeof(VkDrawIndexedIndirectCommand), REGION_COUNT * (u64)objectCount,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    }
+    mObjectCount = 0;
+}
+
+void GPUCulling::UpdateObjects(entt::registry const &registry, u32 objectCount)
+{
+    static_assert(Constants::MAX_MESH_LODS == 4, "GPUCullingObjectInfo stores the LODs in 4-wide vectors");
+
+    bool resized = objectCount > mMaxDrawCount;
+    ResizeIfNeeded(objectCount);
+
+    if (objectCount != mObjectCount)
+    {
+        /* Slots of destroyed or not yet created entities must not be drawn */
+        for (u32 i = mObjectCount; i < objectCount; ++i)
+        {
+            auto *info = (GPUCullingObjectInfo *)mObjectBuffer.GetElement(i);
+            info->isValid = 0;
+        }
+        mObjectCount = objectCount;
+    }
+
+    auto writeObject = [&](Components::Update const &update, Components::Mesh const &mesh) {
+        auto *info = (GPUCullingObjectInfo *)mObjectBuffer.GetElement(update.bufferIndex);
+        info->boundsCenter = glm::vec4(mesh.bounds.center, 0.0f);
+        info->boundsExtents = glm::vec4(mesh.bounds.extents, 0.0f);
+        for (u32 lod = 0; lod < Constants::MAX_MESH_LODS; ++lod)
+        {
+            info->lodFirstIndex[lod] = mesh.lods[lod].firstIndex;
+            info->lodIndexCount[lod] = mesh.lods[lod].indexCount;
+            info->lodError[lod] = mesh.lods[lod].error;
+        }
+        info->lodCount = mesh.lodCount;
+        info->firstVertex = mesh.indices.firstVertex;
+        info->use32BitIndices = mesh.indices.use16BitIndices ? 0 : 1;
+        info->isValid = 1;
+    };
+
+    if (resized) [[unlikely]]
+    {
+        /* The new buffer starts empty */
+        auto meshes = registry.view<const Components::Update, const Components::Mesh>();
+        for (auto const &[entity, update, mesh] : meshes.each())
+        {
+            writeObject(update, mesh);
+        }
+        return;
+    }
+
+    auto dirtyMeshes = registry.view<const Components::Dirty, const Components::Update, const Components::Mesh>();
+    for (auto const &[entity, dirty, update, mesh] : dirtyMeshes.each())
+    {
+        writeObject(update, mesh);
+    }
+}
+
+void GPUCulling::Cull(Vulkan::CommandList &cmdList, u32 currentFrameIndex, Camera const &camera,
+                      Vulkan::Buffer &worldBuffer, DepthPyramid &depthPyramid)
+{
+    auto &resource = mPerFrameResources[currentFrameIndex];
+    auto const &projection = camera.GetProjection();
+    glm::mat4x4 viewProjection = projection * camera.GetView();
+    if (mObjectCount == 0)
+    {
+        cmdList.FillBuffer(resource.drawCounts, 0);
+        cmdList.BufferBarrier(resource.drawCounts, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                              VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+        mPreviousViewProjection = viewProjection;
+        return;
+    }
+
+    auto *frameInfo = (GPUCullingFrameInfo *)resource.frameInfo.GetData();
+    {
+        auto planes = Culling::ExtractFrustumPlanes(viewProjection);
+        for (u32 i = 0; i < planes.size(); ++i)
+        {
+            frameInfo->frustumPlanes[i] = planes[i];
+        }
+        frameInfo->view = camera.GetView();
+        frameInfo->viewProjection = viewProjection;
+        frameInfo->previousViewProjection = mPreviousViewProjection;
+        /* The projection is flipped on Y for Vulkan */
+        frameInfo->lodParameters = glm::vec4(std::abs(projection[1][1]) * mViewportHeight * 0.5f,
+                                             Constants::LOD_ERROR_THRESHOLD_PIXELS, 0.0f, 0.0f);
+        glm::uvec2 pyramidSize = depthPyramid.GetSize();
+        frameInfo->depthPyramidParameters = glm::vec4((f32)pyramidSize.x, (f32)pyramidSize.y,
+                                                      (f32)depthPyramid.GetMipLevels(),
+                                                      depthPyramid.IsValid() ? 1.0f : 0.0f);
+    }
+    mPreviousViewProjection = viewProjection;
+
+    depthPyramid.PrepareForReading(cmdList);
+    auto pyramidView = depthPyramid.GetImage().GetImageView(VK_IMAGE_ASPECT_COLOR_BIT);
+    pyramidView.SetLayout(VK_IMAGE_LAYOUT_GENERAL);
+
+    mDescriptorSet.SetActiveInstance(currentFrameIndex);
+    mDescriptorSet.BindStorageBuffer(worldBuffer, 0);
+    mDescriptorSet.BindStorageBuffer(mObjectBuffer, 1);
+    mDescriptorSet.BindInputBuffer(resource.frameInfo, 2);
+    mDescriptorSet.BindStorageBuffer(resource.drawCommands, 3);
+    mDescriptorSet.BindStorageBuffer(resource.drawCounts, 4);
+    mDescriptorSet.BindCombinedImageSampler(5, pyramidView, VK_IMAGE_ASPECT_COLOR_BIT, depthPyramid.GetSampler());
+    mDescriptorSet.BindStorageBuffer(mVisibilityBuffer, 6);
+
+    cmdList.FillBuffer(resource.drawCounts, 0);
+    cmdList.BufferBarrier(resource.drawCounts, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                          VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    /* The late pass of the previous frame reads the states and writes the culled ones, the early pass reads them back
+     * before writing its own */
+    cmdList.BufferBarrier(mVisibilityBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    Dispatch(cmdList, currentFrameIndex, Pass::Early);
+}
+
+void GPUCulling::CullLate(Vulkan::CommandList &cmdList, u32 currentFrameIndex)
+{
+    if (mObjectCount == 0)
+    {
+        return;
+    }
+
+    cmdList.BufferBarrier(mVisibilityBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    Dispatch(cmdList, currentFrameIndex, Pass::Late);
+}
+
+void GPUCulling::Dispatch(Vulkan::CommandList &cmdList, u32 currentFrameIndex, Pass pass)
+{
+    auto &resource = mPerFrameResources[currentFrameIndex];
+
+    GPUCullingPushConstant pushConstant{
+        .objectCount = mObjectCount, .maxDrawCount = mMaxDrawCount, .pass = (u32)pass};
+    cmdList.BindPipeline(mPipeline);
+    cmdList.BindDescriptorSet(mDescriptorSet, currentFrameIndex, mRootSignature, VK_PIPELINE_BIND_POINT_COMPUTE);
+    cmdList.BindPushRange<GPUCullingPushConstant>(mRootSignature, 0, 1, &pushConstant, VK_SHADER_STAGE_COMPUTE_BIT);
+    cmdList.Dispatch((mObjectCount + GROUP_SIZE - 1) / GROUP_SIZE);
+
+    cmdList.BufferBarrier(resource.drawCommands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                          VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    cmdList.BufferBarrier(resource.drawCounts, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                          VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
+} // namespace Systems
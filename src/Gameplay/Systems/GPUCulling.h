@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Gameplay/Camera.h"
+#include "Renderer/DepthPyramid.h"
+#include "Renderer/Vulkan/Buffer.h"
+#include "Renderer/Vulkan/CommandList.h"
+#include "Renderer/Vulkan/Pipeline.h"
+#include "Renderer/Vulkan/RootSignature.h"
+#include "Utils/Constants.h"
+#include "entt/entt.hpp"
+
+#include <array>
+
+namespace Systems
+{
+/* Frustum culling, occlusion culling and LOD selection done in a compute
+ * shader (cull.comp). It writes one VkDrawIndexedIndirectCommand per visible
+ * object into the draw buffer of the frame, split in regions of maxDrawCount
+ * commands: for each pass, one for the 16-bit index buffer and one for the
+ * 32-bit one. The number of draws of each region is written in the count
+ * buffer.
+ *
+ * Occlusion culling is done in two passes. The early pass tests against the
+ * depth pyramid of the previous frame, the objects it rejects are tested again
+ * by the late pass against the pyramid of what the early pass drew, so
+ * anything that was disoccluded this frame still gets drawn. */
+class GPUCulling
+{
+public:
+    enum class Pass : u32
+    {
+        Early = 0,
+        Late = 1,
+    };
+
+public:
+    GPUCulling();
+
+    GPUCulling(const GPUCulling &) = delete;
+    GPUCulling(GPUCulling &&) = delete;
+    GPUCulling &operator=(const GPUCulling &) = delete;
+    GPUCulling &operator=(GPUCulling &&) = delete;
+
+public:
+    void OnResize();
+
+    /**
+     * @brief Uploads the bounds and LODs of the entities that changed
+     */
+    void UpdateObjects(entt::registry const &registry, u32 objectCount);
+
+    /**
+     * @brief Records the early culling pass. Must be called outside of a
+     * rendering scope, the results can be consumed by indirect draws after it.
+     *
+     * @param worldBuffer BasicPerObjectInfo of every object
+     * @param depthPyramid Built at the end of the previous frame
+     */
+    void Cull(Vulkan::CommandList &cmdList, u32 currentFrameIndex, Camera const &camera, Vulkan::Buffer &worldBuffer,
+              DepthPyramid &depthPyramid);
+
+    /**
+     * @brief Records the late culling pass. The depth pyramid given to Cull
+     * must have been rebuilt from the draws of the early pass.
+     */
+    void CullLate(Vulkan::CommandList &cmdList, u32 currentFrameIndex);
+
+public:
+    Vulkan::Buffer &GetDrawCommands(u32 currentFrameIndex)
+    {
+        return mPerFrameResources[currentFrameIndex].drawCommands;
+    }
+
+    Vulkan::Buffer &GetDrawCounts(u32 currentFrameIndex)
+    {
+        return mPerFrameResources[currentFrameIndex].drawCounts;
+    }
+
+    u32 GetMaxDrawCount() const
+    {
+        return mMaxDrawCount;
+    }
+
+    /* Offset in bytes of the first command of a region in GetDrawCommands */
+    u64 GetDrawCommandsOffset(Pass pass, bool use32BitIndices) const
+    {
+        return GetRegion(pass, use32BitIndices) * (u64)mMaxDrawCount * sizeof(VkDrawIndexedIndirectCommand);
+    }
+
+    /* Offset in bytes of the count of a region in GetDrawCounts */
+    u64 GetDrawCountOffset(Pass pass, bool use32BitIndices) const
+    {
+        return GetRegion(pass, use32BitIndices) * sizeof(u32);
+    }
+
+private:
+    static u32 GetRegion(Pass pass, bool use32BitIndices)
+    {
+        return (u32)pass * 2 + (use32BitIndices ? 1 : 0);
+    }
+
+    void ResizeIfNeeded(u32 objectCount);
+    void Dispatch(Vulkan::CommandList &cmdList, u32 currentFrameIndex, Pass pass);
+
+private:
+    static constexpr const u32 GROUP_SIZE = 64;
+    static constexpr const u32 REGION_COUNT = 4;
+
+    struct PerFrameResource
+    {
+        Vulkan::Buffer drawCommands;
+        Vulkan::Buffer drawCounts;
+        Vulkan::Buffer frameInfo;
+    };
+    std::array<PerFrameResource, Constants::MAX_IN_FLIGHT_FRAMES> mPerFrameResources;
+
+    Vulkan::ComputePipeline mPipeline;
+    Vulkan::RootSignature mRootSignature;
+    Vulkan::DescriptorSet mDescriptorSet;
+
+    /* Contains GPUCullingObjectInfo for each object, indexed by Components::Update::bufferIndex */
+    Vulkan::Buffer mObjectBuffer;
+    /* Written by the early pass and read by the late one */
+    Vulkan::Buffer mVisibilityBuffer;
+    u32 mObjectCount = 0;
+    u32 mMaxDrawCount = 0;
+
+    glm::mat4x4 mPreviousViewProjection = glm::mat4x4(1.0f);
+    f32 mViewportHeight = 1.0f;
+};
+} // namespace Systems
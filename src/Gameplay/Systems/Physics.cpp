@@ -1,130 +1,856 @@
 #include "Physics.h"
-#include "BulletCollision/CollisionShapes/btBoxShape.h"
-#include "BulletCollision/CollisionShapes/btCollisionShape.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
 #include "BulletDynamics/Dynamics/btRigidBody.h"
 #include "Check.h"
 #include "Gameplay/Components/RigidBody.h"
-#include "Gameplay/Game.h"
-#include "LinearMath/btDefaultMotionState.h"
+#include "Gameplay/Components/Transform.h"
+#include "JobSystem.h"
+#include "LinearMath/btMotionState.h"
+#include "LinearMath/btThreads.h"
 #include "LinearMath/btTransform.h"
+#include "Utils/Constants.h"
 #include "entt/entity/fwd.hpp"
 
-#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <array>
 #include <glm/gtx/matrix_decompose.hpp>
 
 namespace Systems
 {
-Physics::Physics()
+/* Moving a body is cheap, but it's not worth waking up other threads for a
+ * handful of them */
+static constexpr const u32 MIN_BODIES_PER_JOB = 256;
+/* Overlapping pairs handed to a single job by the multithreaded dispatcher */
+static constexpr const i32 MT_PAIRS_PER_JOB = 40;
+static constexpr const i32 MT_MANIFOLD_POOL_SIZE = 8192;
+static constexpr const i32 MT_COLLISION_ALGORITHM_POOL_SIZE = 8192;
+
+/* btDiscreteDynamicsWorld looks a removed body up in its list of dynamic
+ * bodies with a linear search. Each body remembers its position in the list
+ * instead, so removing it is a swap with the last one. */
+template <typename World> class SwapRemoveWorld : public World
+{
+public:
+    using World::World;
+
+    void addRigidBody(btRigidBody *body) override
+    {
+        World::addRigidBody(body);
+        TrackBody(body);
+    }
+
+    void addRigidBody(btRigidBody *body, int group, int mask) override
+    {
+        World::addRigidBody(body, group, mask);
+        TrackBody(body);
+    }
+
+    void removeRigidBody(btRigidBody *body) override
+    {
+        auto &bodies = this->m_nonStaticRigidBodies;
+        i32 index = body->getUserIndex3();
+        if (index >= 0 && index < bodies.size() && bodies[index] == body)
+        {
+            btRigidBody *last = bodies[bodies.size() - 1];
+            bodies[index] = last;
+            last->setUserIndex3(index);
+            bodies.pop_back();
+            body->setUserIndex3(-1);
+        }
+        /* Already swaps with the last object */
+        this->btCollisionWorld::removeCollisionObject(body);
+    }
+
+private:
+    void TrackBody(btRigidBody *body)
+    {
+        auto &bodies = this->m_nonStaticRigidBodies;
+        if (bodies.size() > 0 && bodies[bodies.size() - 1] == body)
+        {
+            body->setUserIndex3(bodies.size() - 1);
+        }
+    }
+};
+
+/* Runs Bullet's parallel loops on the job system. Any thread of the job
+ * system can pick up a chunk, the thread count only limits how many chunks a
+ * loop is cut in. */
+class Physics::TaskScheduler : public btITaskScheduler
+{
+public:
+    TaskScheduler(u32 threadCount) : btITaskScheduler("JobSystem")
+    {
+        /* Bullet sizes its per thread storage with getNumThreads and indexes
+         * it by btGetCurrentThreadIndex, so it has to cover the physics
+         * thread and every thread of the job system */
+        mMaxThreadCount = std::min(
+            (i32)Jnrlib::JobSystem::Get()->GetThreadCount() + 1,
+            (i32)BT_MAX_THREAD_COUNT);
+        setNumThreads((i32)threadCount);
+    }
+
+    int getMaxNumThreads() const override
+    {
+        return mMaxThreadCount;
+    }
+
+    int getNumThreads() const override
+    {
+        return mMaxThreadCount;
+    }
+
+    void setNumThreads(int numThreads) override
+    {
+        mThreadCount = std::clamp(numThreads, 1, mMaxThreadCount);
+    }
+
+    void parallelFor(int iBegin, int iEnd, int grainSize,
+                     btIParallelForBody const &body) override
+    {
+        ForEachChunk(iBegin, iEnd, grainSize, [&body](u32, int begin, int end) {
+            body.forLoop(begin, end);
+        });
+    }
+
+    btScalar parallelSum(int iBegin, int iEnd, int grainSize,
+                         btIParallelSumBody const &body) override
+    {
+        std::array<btScalar, BT_MAX_THREAD_COUNT> sums = {};
+        u32 chunkCount = ForEachChunk(
+            iBegin, iEnd, grainSize,
+            [&body, &sums](u32 chunk, int begin, int end) {
+                sums[chunk] = body.sumLoop(begin, end);
+            });
+
+        btScalar sum = 0.0f;
+        for (u32 i = 0; i < chunkCount; ++i)
+        {
+            sum += sums[i];
+        }
+        return sum;
+    }
+
+private:
+    /* Calls function(chunk, begin, end) for at most mThreadCount chunks of
+     * [iBegin, iEnd), the first one on the calling thread. Returns how many
+     * chunks there were. */
+    template <typename Function>
+    u32 ForEachChunk(int iBegin, int iEnd, int grainSize,
+                     Function const &function)
+    {
+        if (iEnd <= iBegin)
+        {
+            return 0;
+        }
+
+        i32 count = iEnd - iBegin;
+        grainSize = std::max(grainSize, 1);
+        i32 chunkCount =
+            std::clamp((count + grainSize - 1) / grainSize, 1, mThreadCount);
+        i32 chunkSize = (count + chunkCount - 1) / chunkCount;
+
+        auto jobSystem = Jnrlib::JobSystem::Get();
+        Jnrlib::JobCounter counter;
+        u32 chunk = 1;
+        for (i32 begin = iBegin + chunkSize; begin < iEnd; begin += chunkSize)
+        {
+            i32 end = std::min(begin + chunkSize, iEnd);
+            jobSystem->Run(counter, [&function, chunk, begin, end]() {
+                function(chunk, begin, end);
+            });
+            chunk++;
+        }
+
+        function(0, iBegin, std::min(iBegin + chunkSize, iEnd));
+        jobSystem->Wait(counter);
+        return chunk;
+    }
+
+private:
+    i32 mMaxThreadCount;
+    i32 mThreadCount;
+};
+
+static std::unique_ptr<btBroadphaseInterface>
+CreateBroadphase(PhysicsSettings const &settings)
 {
-    mDefaultCollisionConfiguration =
-        std::make_unique<btDefaultCollisionConfiguration>();
-    mDispatcher = std::make_unique<btCollisionDispatcher>(
-        mDefaultCollisionConfiguration.get());
-    mBroadphaseInterface = std::make_unique<btDbvtBroadphase>();
-    mSolver = std::make_unique<btSequentialImpulseConstraintSolver>();
-    mWorld = std::make_unique<btDiscreteDynamicsWorld>(
-        mDispatcher.get(), mBroadphaseInterface.get(), mSolver.get(),
-        mDefaultCollisionConfiguration.get());
+    switch (settings.broadphase)
+    {
+    case Broadphase::DynamicAabbTree:
+        return std::make_unique<btDbvtBroadphase>();
+    case Broadphase::AxisSweep:
+    {
+        btVector3 halfExtents(settings.worldHalfExtents.x,
+                              settings.worldHalfExtents.y,
+                              settings.worldHalfExtents.z);
+        /* The 16 bit version tops out at 16k bodies */
+        return std::make_unique<bt32BitAxisSweep3>(-halfExtents, halfExtents);
+    }
+    case Broadphase::UniformGrid:
+        return std::make_unique<UniformGridBroadphase>(settings.gridCellSize);
+    }
+    return nullptr;
+}
 
+Physics::Physics(PhysicsSettings const &settings)
+    : mShapeCache(settings.cacheDirectory),
+      mTimeStep(1.0f / Constants::PHYSICS_TICK_RATE)
+{
+    u32 workerCount = settings.workerCount;
+    if (workerCount == 0)
+    {
+        workerCount = Jnrlib::JobSystem::Get()->GetThreadCount();
+    }
+
+    if (workerCount == 1)
+    {
+        mDefaultCollisionConfiguration =
+            std::make_unique<btDefaultCollisionConfiguration>();
+        mDispatcher = std::make_unique<btCollisionDispatcher>(
+            mDefaultCollisionConfiguration.get());
+        mBroadphaseInterface = CreateBroadphase(settings);
+        mSolver = std::make_unique<btSequentialImpulseConstraintSolver>();
+        mWorld = std::make_unique<SwapRemoveWorld<btDiscreteDynamicsWorld>>(
+            mDispatcher.get(), mBroadphaseInterface.get(), mSolver.get(),
+            mDefaultCollisionConfiguration.get());
+    }
+    else
+    {
+        /* Bullet's scheduler is global, there is only one physics world */
+        mTaskScheduler = std::make_unique<TaskScheduler>(workerCount);
+        btSetTaskScheduler(mTaskScheduler.get());
+#if !BT_THREADSAFE
+        SHOWWARNING("Bullet was built without BT_THREADSAFE, the physics "
+                    "world will run on a single thread");
+#endif
+        if (btGetTaskScheduler() != mTaskScheduler.get())
+        {
+            /* Bullet only takes the scheduler from the thread it considers
+             * its main one */
+            SHOWWARNING("Bullet didn't accept the job system's task "
+                        "scheduler, the physics world will run on ",
+                        btGetTaskScheduler() != nullptr
+                            ? btGetTaskScheduler()->getName()
+                            : "no scheduler");
+        }
+
+        /* The pools are shared by all threads, when they run out Bullet falls
+         * back to locking the heap */
+        btDefaultCollisionConstructionInfo constructionInfo;
+        constructionInfo.m_defaultMaxPersistentManifoldPoolSize =
+            MT_MANIFOLD_POOL_SIZE;
+        constructionInfo.m_defaultMaxCollisionAlgorithmPoolSize =
+            MT_COLLISION_ALGORITHM_POOL_SIZE;
+        mDefaultCollisionConfiguration =
+            std::make_unique<btDefaultCollisionConfiguration>(
+                constructionInfo);
+        mDispatcher = std::make_unique<btCollisionDispatcherMt>(
+            mDefaultCollisionConfiguration.get(), MT_PAIRS_PER_JOB);
+        mBroadphaseInterface = CreateBroadphase(settings);
+
+        /* Every island being solved at the same time needs its own solver */
+        auto solverPool =
+            std::make_unique<btConstraintSolverPoolMt>((i32)workerCount);
+        mWorld = std::make_unique<SwapRemoveWorld<btDiscreteDynamicsWorldMt>>(
+            mDispatcher.get(), mBroadphaseInterface.get(), solverPool.get(),
+            nullptr, mDefaultCollisionConfiguration.get());
+        mSolver = std::move(solverPool);
+    }
+
+    SHOWINFO("Created physics world with ", workerCount, " threads");
     mWorld->setGravity(btVector3(0.0f, -10.0f, 0.0f));
+    /* Bullet's scheduler is global, a single threaded world can't rely on
+     * it being sequential */
+    mVehicles.SetParallel(mTaskScheduler != nullptr);
+    mWorld->addAction(&mVehicles);
 }
 
 Physics::~Physics()
 {
+    Stop();
+    /* Create the bodies the physics thread didn't get to, so everything is
+     * freed the same way */
+    ExecuteCommands();
+    /* The world still touches its bodies when destroyed */
+    mWorld->removeAction(&mVehicles);
     mWorld.reset();
+    for (Body *body : mBodies)
+    {
+        if (body != nullptr)
+        {
+            mBodyPool.Free(body);
+        }
+    }
     mDispatcher.reset();
+    if (mTaskScheduler)
+    {
+        btSetTaskScheduler(btGetSequentialTaskScheduler());
+    }
 }
 
-Components::RigidBody Physics::CreateRigidBody(Components::Base const &base,
-                                               Components::Mesh const &mesh,
-                                               float mass)
+void Physics::Start()
 {
-    CHECK_FATAL(
-        mesh.path == "cube",
-        "As of right now only cubes can be used to create rigid bodies");
-
-    std::unique_ptr<btCollisionShape> collisionShape =
-        std::make_unique<btBoxShape>(btVector3(1.0f, 1.0f, 1.0f));
+    CHECK_FATAL(!mThread.joinable(), "The physics thread is already running");
+    mThread =
+        std::jthread([this](std::stop_token stopToken) { Run(stopToken); });
+}
 
-    btTransform startTransform;
-    if (false)
+void Physics::Stop()
+{
+    if (mThread.joinable())
     {
-        /* TODO: When physics debugging is available, check why this doesn't
-         * work */
-        const float *worldMatrix = glm::value_ptr(base.world);
-        startTransform.setFromOpenGLMatrix(worldMatrix);
+        mThread.request_stop();
+        mThread.join();
     }
+}
 
-    btVector3 localInertia = btVector3(0.0f, 0.0f, 0.0f);
-    if (mass != 0.0f)
+void Physics::RunSteps(u32 stepCount)
+{
+    CHECK_FATAL(!mThread.joinable(),
+                "Can't step while the physics thread is running");
+    for (u32 i = 0; i < stepCount; ++i)
     {
-        collisionShape->calculateLocalInertia(mass, localInertia);
+        ExecuteCommands();
+        Step();
     }
+}
 
-    {
-        glm::vec3 scale, translation, skew;
-        glm::quat rotation;
-        glm::vec4 perspective;
+static void DecomposeWorld(Components::Base const &base, glm::vec3 &scale,
+                           glm::vec3 &translation)
+{
+    glm::vec3 skew;
+    glm::quat rotation;
+    glm::vec4 perspective;
+    CHECK_FATAL(glm::decompose(base.world, scale, rotation, translation, skew,
+                               perspective),
+                "Could not decompose matrix");
+}
 
-        CHECK_FATAL(glm::decompose(base.world, scale, rotation, translation,
-                                   skew, perspective),
-                    "Could not decompose matrix");
+Components::RigidBody
+Physics::CreateRigidBody(entt::entity entity, Components::Base const &base,
+                         Components::Mesh const &mesh,
+                         std::span<VertexPositionNormal const> vertices,
+                         float mass)
+{
+    glm::vec3 scale, translation;
+    DecomposeWorld(base, scale, translation);
 
-        startTransform.setIdentity();
-        startTransform.setOrigin(
-            btVector3(translation.x, translation.y, translation.z));
-        collisionShape->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
+    return CreateBody(entity, translation,
+                      mShapeCache.Acquire(mesh, vertices, scale), mass);
+}
+
+Components::RigidBody
+Physics::CreateStaticMeshBody(entt::entity entity, Components::Base const &base,
+                              Components::Mesh const &mesh,
+                              TriangleMeshData const &triangles)
+{
+    glm::vec3 scale, translation;
+    DecomposeWorld(base, scale, translation);
+
+    return CreateBody(entity, translation,
+                      mShapeCache.AcquireTriangleMesh(mesh, triangles, scale),
+                      0.0f);
+}
+
+Components::RigidBody Physics::CreateBody(entt::entity entity,
+                                          glm::vec3 const &translation,
+                                          btCollisionShape *collisionShape,
+                                          float mass)
+{
+    btTransform startTransform;
+    startTransform.setIdentity();
+    startTransform.setOrigin(
+        btVector3(translation.x, translation.y, translation.z));
+
+    u32 bodyIndex;
+    if (!mFreeBodyIndices.empty())
+    {
+        bodyIndex = mFreeBodyIndices.back();
+        mFreeBodyIndices.pop_back();
     }
+    else
+    {
+        bodyIndex = (u32)mBodySlots.size();
+        mBodySlots.emplace_back();
+    }
+    BodySlot &slot = mBodySlots[bodyIndex];
+    slot.entity = entity;
+    slot.mass = mass;
+    slot.hasVehicle = false;
 
-    std::unique_ptr<btDefaultMotionState> motionState =
-        std::make_unique<btDefaultMotionState>(startTransform);
+    u32 entityIndex = (u32)entt::to_entity(entity);
+    if (entityIndex >= mSyncedTransforms.size())
+    {
+        mSyncedTransforms.resize(entityIndex + 1);
+    }
+    {
+        btVector3 const &origin = startTransform.getOrigin();
+        btQuaternion rotation = startTransform.getRotation();
 
-    btRigidBody::btRigidBodyConstructionInfo rigidBodyInfo(
-        mass, motionState.get(), collisionShape.get(), localInertia);
-    std::unique_ptr<btRigidBody> rigidBody =
-        std::make_unique<btRigidBody>(rigidBodyInfo);
+        SyncedTransform &synced = mSyncedTransforms[entityIndex];
+        synced.entity = entity;
+        synced.body = Components::BodyHandle{.index = bodyIndex,
+                                             .generation = slot.generation};
+        synced.position = glm::vec3(origin.x(), origin.y(), origin.z());
+        synced.rotation =
+            glm::quat(rotation.w(), rotation.x(), rotation.y(), rotation.z());
+        synced.previousPosition = synced.position;
+        synced.previousRotation = synced.rotation;
+        synced.lastMovedStep = 0;
+        synced.isQueued = false;
+    }
 
-    mWorld->addRigidBody(rigidBody.get());
+    /* The body itself is built by the physics thread */
+    PushCommand(Command{.type = Command::Type::AddRigidBody,
+                        .bodyIndex = bodyIndex,
+                        .value = startTransform.getOrigin(),
+                        .entity = entity,
+                        .generation = slot.generation,
+                        .collisionShape = collisionShape,
+                        .mass = mass});
 
     Components::RigidBody result;
     {
-        result.rigidBody = rigidBody.get();
-        result.collisionShape = collisionShape.get();
-        result.motionState = motionState.get();
+        result.body = Components::BodyHandle{.index = bodyIndex,
+                                             .generation = slot.generation};
         result.mass = mass;
     }
+    return result;
+}
 
-    mRigidBodies.emplace_back(std::move(rigidBody));
-    mCollisionShapes.emplace_back(std::move(collisionShape));
-    mDefaultMotionStates.emplace_back(std::move(motionState));
+bool Physics::IsAlive(Components::BodyHandle body) const
+{
+    return body.index < mBodySlots.size() &&
+           mBodySlots[body.index].generation == body.generation &&
+           mBodySlots[body.index].entity != entt::null;
+}
 
-    return result;
+void Physics::DestroyRigidBody(Components::BodyHandle body)
+{
+    CHECK_FATAL(IsAlive(body), "Destroying a body that doesn't exist anymore");
+
+    /* Commands run in order, so the slot can be reused right away */
+    PushCommand(Command{.type = Command::Type::RemoveRigidBody,
+                        .bodyIndex = body.index});
+
+    /* Queued entities and older snapshots that still have the body are
+     * skipped once the entity doesn't match */
+    BodySlot &slot = mBodySlots[body.index];
+    SyncedTransform &synced = mSyncedTransforms[entt::to_entity(slot.entity)];
+    synced.entity = entt::null;
+    synced.body = Components::BodyHandle{};
+
+    slot.generation++;
+    slot.entity = entt::null;
+    slot.hasVehicle = false;
+    mFreeBodyIndices.push_back(body.index);
+}
+
+void Physics::ApplyCentralImpulse(Components::BodyHandle body,
+                                  glm::vec3 const &impulse)
+{
+    CHECK_FATAL(IsAlive(body), "Using a body that doesn't exist anymore");
+    PushCommand(Command{.type = Command::Type::ApplyCentralImpulse,
+                        .bodyIndex = body.index,
+                        .value = btVector3(impulse.x, impulse.y, impulse.z)});
 }
 
-void Physics::Update(float dt, entt::registry &registry)
+void Physics::SetAngularVelocity(Components::BodyHandle body,
+                                 glm::vec3 const &velocity)
 {
-    mWorld->stepSimulation(dt);
-    if (Game::Get()->GetGameState().isDeveloper)
+    CHECK_FATAL(IsAlive(body), "Using a body that doesn't exist anymore");
+    PushCommand(Command{.type = Command::Type::SetAngularVelocity,
+                        .bodyIndex = body.index,
+                        .value =
+                            btVector3(velocity.x, velocity.y, velocity.z)});
+}
+
+Components::Vehicle Physics::CreateVehicle(Components::BodyHandle body,
+                                           VehicleSettings const &settings)
+{
+    CHECK_FATAL(IsAlive(body), "Using a body that doesn't exist anymore");
+    BodySlot &slot = mBodySlots[body.index];
+    CHECK_FATAL(slot.mass > 0.0f, "A static body can't be a vehicle");
+    CHECK_FATAL(!slot.hasVehicle, "The body is a vehicle already");
+    slot.hasVehicle = true;
+
+    PushCommand(Command{.type = Command::Type::AddVehicle,
+                        .bodyIndex = body.index,
+                        .vehicleSettings = settings});
+    return Components::Vehicle{.body = body};
+}
+
+void Physics::DestroyVehicle(Components::Vehicle const &vehicle)
+{
+    CHECK_FATAL(IsAlive(vehicle.body),
+                "Using a body that doesn't exist anymore");
+    BodySlot &slot = mBodySlots[vehicle.body.index];
+    CHECK_FATAL(slot.hasVehicle, "Destroying a vehicle that doesn't exist");
+    slot.hasVehicle = false;
+
+    PushCommand(Command{.type = Command::Type::RemoveVehicle,
+                        .bodyIndex = vehicle.body.index});
+}
+
+void Physics::SetVehicleControls(Components::Vehicle const &vehicle,
+                                 f32 throttle, f32 brake, f32 steering)
+{
+    CHECK_FATAL(IsAlive(vehicle.body),
+                "Using a body that doesn't exist anymore");
+    CHECK_FATAL(mBodySlots[vehicle.body.index].hasVehicle,
+                "Using a vehicle that doesn't exist anymore");
+    PushCommand(Command{.type = Command::Type::SetVehicleControls,
+                        .bodyIndex = vehicle.body.index,
+                        .value = btVector3(throttle, brake, steering)});
+}
+
+void Physics::SetTickRate(f32 ticksPerSecond)
+{
+    CHECK_FATAL(ticksPerSecond > 0.0f, "Tick rate must be positive");
+    mTimeStep.store(1.0f / ticksPerSecond, std::memory_order_relaxed);
+}
+
+void Physics::Run(std::stop_token stopToken)
+{
+    using Clock = std::chrono::steady_clock;
+
+    /* The multithreaded world submits its jobs from here */
+    Jnrlib::JobSystem::Get()->RegisterCurrentThread();
+
+    auto nextStep = Clock::now();
+    while (!stopToken.stop_requested())
+    {
+        f32 seconds = mTimeStep.load(std::memory_order_relaxed);
+        auto timeStep = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<f32>(seconds));
+
+        if (Clock::now() - nextStep >
+            timeStep * Constants::MAX_PHYSICS_STEPS_PER_UPDATE)
+        {
+            /* Too far behind, slow down instead of catching up */
+            nextStep = Clock::now();
+        }
+        std::this_thread::sleep_until(nextStep);
+        nextStep += timeStep;
+
+        ExecuteCommands();
+        Step();
+    }
+
+    /* Every step waited for its jobs, so another thread can take the queue
+     * over, Start and Stop can go on forever */
+    Jnrlib::JobSystem::Get()->UnregisterCurrentThread();
+}
+
+void Physics::ExecuteCommands()
+{
+    {
+        std::scoped_lock lock(mCommandsMutex);
+        std::swap(mPendingCommands, mExecutingCommands);
+    }
+
+    for (auto const &command : mExecutingCommands)
+    {
+        switch (command.type)
+        {
+        case Command::Type::AddRigidBody:
+        {
+            btVector3 localInertia = btVector3(0.0f, 0.0f, 0.0f);
+            if (command.mass != 0.0f)
+            {
+                command.collisionShape->calculateLocalInertia(command.mass,
+                                                              localInertia);
+            }
+
+            btTransform startTransform;
+            startTransform.setIdentity();
+            startTransform.setOrigin(command.value);
+
+            if (command.bodyIndex >= mBodies.size())
+            {
+                mBodies.resize(command.bodyIndex + 1, nullptr);
+                mBodyStates.resize(command.bodyIndex + 1);
+                mIsBodyMoved.resize(command.bodyIndex + 1, 0);
+            }
+            Body *body = mBodyPool.Allocate(this, command.bodyIndex,
+                                            command.mass,
+                                            command.collisionShape,
+                                            localInertia, startTransform);
+            mBodies[command.bodyIndex] = body;
+
+            btVector3 const &origin = command.value;
+            mBodyStates[command.bodyIndex] = BodyState{
+                .entity = command.entity,
+                .body =
+                    Components::BodyHandle{.index = command.bodyIndex,
+                                           .generation = command.generation},
+                .position = glm::vec3(origin.x(), origin.y(), origin.z()),
+                .rotation = glm::identity<glm::quat>(),
+                .lastMovedStep = 0};
+
+            mWorld->addRigidBody(&body->rigidBody);
+            break;
+        }
+        case Command::Type::RemoveRigidBody:
+        {
+            mVehicles.Remove(command.bodyIndex);
+
+            Body *body = mBodies[command.bodyIndex];
+            mWorld->removeRigidBody(&body->rigidBody);
+            mShapeCache.Release(body->rigidBody.getCollisionShape());
+            mBodyPool.Free(body);
+
+            mBodies[command.bodyIndex] = nullptr;
+            mBodyStates[command.bodyIndex].entity = entt::null;
+            mBodyStates[command.bodyIndex].body = Components::BodyHandle{};
+            break;
+        }
+        case Command::Type::ApplyCentralImpulse:
+        {
+            btRigidBody &rigidBody = mBodies[command.bodyIndex]->rigidBody;
+            rigidBody.activate(true);
+            rigidBody.applyCentralImpulse(command.value);
+            break;
+        }
+        case Command::Type::SetAngularVelocity:
+        {
+            btRigidBody &rigidBody = mBodies[command.bodyIndex]->rigidBody;
+            rigidBody.activate(true);
+            rigidBody.setAngularVelocity(command.value);
+            break;
+        }
+        case Command::Type::AddVehicle:
+        {
+            mVehicles.Add(command.bodyIndex,
+                          &mBodies[command.bodyIndex]->rigidBody,
+                          command.vehicleSettings);
+            break;
+        }
+        case Command::Type::RemoveVehicle:
+        {
+            mVehicles.Remove(command.bodyIndex);
+            break;
+        }
+        case Command::Type::SetVehicleControls:
+        {
+            mVehicles.SetControls(command.bodyIndex, command.value.x(),
+                                  command.value.y(), command.value.z());
+            break;
+        }
+        }
+    }
+    mExecutingCommands.clear();
+}
+
+void Physics::Step()
+{
+    /* No substeps, we are doing the fixed stepping ourselves. Bullet reports
+     * the state at the end of the step without interpolating. */
+    mStepCount++;
+    auto start = std::chrono::steady_clock::now();
+    mWorld->stepSimulation(mTimeStep.load(std::memory_order_relaxed), 0);
+    auto end = std::chrono::steady_clock::now();
+
+    if (mWorld->getDebugDrawer() != nullptr)
     {
         mWorld->debugDrawWorld();
     }
 
-    auto rigidBodies = registry.view<Components::Base, Components::RigidBody>();
-    for (auto [entity, base, rigidBody] : rigidBodies.each())
+    Snapshot &snapshot = mSnapshots.GetWriteBuffer();
+    snapshot.step = mStepCount;
+    snapshot.time = end;
+    snapshot.statistics = PhysicsStatistics{
+        .step = mStepCount,
+        .bodyCount = (u32)mWorld->getNumCollisionObjects(),
+        .overlappingPairCount = (u32)mWorld->getBroadphase()
+                                    ->getOverlappingPairCache()
+                                    ->getNumOverlappingPairs(),
+        .manifoldCount = (u32)mDispatcher->getNumManifolds(),
+        .stepMilliseconds =
+            std::chrono::duration<f32, std::milli>(end - start).count()};
+
+    /* Moves from before the main thread's last snapshot already reached it,
+     * the rest go out again in case this snapshot is the next one it sees */
+    u64 consumedStep = mConsumedStep.load(std::memory_order_acquire);
+    snapshot.bodies.clear();
+    u32 keptCount = 0;
+    for (u32 bodyIndex : mMovedBodies)
     {
-        btTransform transform;
-        rigidBody.rigidBody->getMotionState()->getWorldTransform(transform);
-        if (rigidBody.rigidBody->isActive())
+        BodyState const &state = mBodyStates[bodyIndex];
+        if (state.lastMovedStep <= consumedStep)
         {
+            mIsBodyMoved[bodyIndex] = 0;
+            continue;
+        }
+        mMovedBodies[keptCount++] = bodyIndex;
+        snapshot.bodies.push_back(state);
+    }
+    mMovedBodies.resize(keptCount);
+    mSnapshots.Publish();
+}
 
-            float floatWorld[16];
-            transform.getOpenGLMatrix(floatWorld);
+void Physics::OnBodyMoved(u32 bodyIndex, btTransform const &transform)
+{
+    btVector3 const &origin = transform.getOrigin();
+    btQuaternion rotation = transform.getRotation();
+
+    BodyState &state = mBodyStates[bodyIndex];
+    state.position = glm::vec3(origin.x(), origin.y(), origin.z());
+    state.rotation =
+        glm::quat(rotation.w(), rotation.x(), rotation.y(), rotation.z());
+    state.lastMovedStep = mStepCount;
+
+    /* Bullet synchronizes the motion states on the stepping thread */
+    if (!mIsBodyMoved[bodyIndex])
+    {
+        mIsBodyMoved[bodyIndex] = 1;
+        mMovedBodies.push_back(bodyIndex);
+    }
+}
+
+void Physics::PushCommand(Command const &command)
+{
+    std::scoped_lock lock(mCommandsMutex);
+    mPendingCommands.push_back(command);
+}
+
+void Physics::Update(entt::registry &registry)
+{
+    ConsumeSnapshot();
+
+    /* Rendering runs one step behind the simulation, interpolating towards
+     * the latest snapshot */
+    std::chrono::duration<f32> sinceSnapshot =
+        std::chrono::steady_clock::now() - mSnapshotTime;
+    f32 alpha = std::clamp(
+        sinceSnapshot.count() / mTimeStep.load(std::memory_order_relaxed),
+        0.0f, 1.0f);
+
+    ApplyMovedBodies(registry, alpha);
+}
+
+void Physics::ConsumeSnapshot()
+{
+    if (!mSnapshots.Update())
+    {
+        return;
+    }
+
+    Snapshot const &snapshot = mSnapshots.GetReadBuffer();
+    for (auto const &state : snapshot.bodies)
+    {
+        if (state.lastMovedStep <= mSnapshotStep || state.entity == entt::null)
+        {
+            continue;
+        }
 
-            registry.patch<Components::Base>(
-                entity, [&](Components::Base &base) {
-                    base.world = glm::make_mat4(floatWorld);
-                });
+        /* The previous state is the last one that reached us, which is
+         * older than one step if snapshots were skipped */
+        SyncedTransform &synced =
+            mSyncedTransforms[entt::to_entity(state.entity)];
+        if (synced.body != state.body)
+        {
+            /* Destroyed since, maybe replaced by a new body */
+            continue;
+        }
+        synced.previousPosition = synced.position;
+        synced.previousRotation = synced.rotation;
+        synced.position = state.position;
+        synced.rotation = state.rotation;
+        synced.lastMovedStep = state.lastMovedStep;
+
+        if (!synced.isQueued)
+        {
+            synced.isQueued = true;
+            mMovedEntities.push_back(state.entity);
+        }
+    }
+
+    mSnapshotStep = snapshot.step;
+    mSnapshotTime = snapshot.time;
+    mConsumedStep.store(snapshot.step, std::memory_order_release);
+    mStatistics = snapshot.statistics;
+}
+
+void Physics::ApplyMovedBodies(entt::registry &registry, f32 alpha)
+{
+    /* Entries whose body got destroyed are skipped, their synced transform
+     * doesn't point back at them anymore */
+    for (entt::entity entity : mInterpolatedEntities)
+    {
+        SyncedTransform &synced = mSyncedTransforms[entt::to_entity(entity)];
+        if (synced.entity == entity && !synced.isQueued)
+        {
+            synced.isQueued = true;
+            mMovedEntities.push_back(entity);
+        }
+    }
+    mInterpolatedEntities.clear();
+
+    /* Different entities touch different components, so the writes can be
+     * spread over threads. The signals are not thread safe, they go out
+     * afterwards. */
+    auto jobSystem = Jnrlib::JobSystem::Get();
+    jobSystem->ParallelFor(
+        0, (u32)mMovedEntities.size(), MIN_BODIES_PER_JOB, [&](u32 i) {
+            entt::entity entity = mMovedEntities[i];
+            SyncedTransform const &synced =
+                mSyncedTransforms[entt::to_entity(entity)];
+            if (synced.entity != entity)
+            {
+                return;
+            }
+
+            /* Bodies that didn't move in the last step are at rest */
+            glm::vec3 position = synced.position;
+            glm::quat rotation = synced.rotation;
+            if (synced.lastMovedStep == mSnapshotStep)
+            {
+                position =
+                    glm::mix(synced.previousPosition, synced.position, alpha);
+                rotation =
+                    glm::slerp(synced.previousRotation, synced.rotation, alpha);
+            }
+
+            if (auto *local = registry.try_get<Components::Transform>(entity))
+            {
+                /* Let the transform system move the children as well */
+                local->position = position;
+                local->rotation = rotation;
+            }
+            else
+            {
+                glm::mat4x4 world = glm::mat4_cast(rotation);
+                world[3] = glm::vec4(position, 1.0f);
+                registry.get<Components::Base>(entity).world = world;
+            }
+        });
+
+    for (entt::entity entity : mMovedEntities)
+    {
+        SyncedTransform &synced = mSyncedTransforms[entt::to_entity(entity)];
+        if (synced.entity != entity)
+        {
+            continue;
+        }
+
+        synced.isQueued = false;
+        if (synced.lastMovedStep == mSnapshotStep)
+        {
+            mInterpolatedEntities.push_back(entity);
+        }
+
+        if (registry.all_of<Components::Transform>(entity))
+        {
+            registry.patch<Components::Transform>(entity);
+        }
+        else
+        {
+            registry.patch<Components::Base>(entity);
         }
     }
+    mMovedEntities.clear();
 }
 } // namespace Systems
@@ -6,43 +6,326 @@
 
 #include "entt/entt.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PoolAllocator.h"
+#include "TripleBuffer.h"
 
 #include "Gameplay/Components/Base.h"
 #include "Gameplay/Components/Mesh.h"
 #include "Gameplay/Components/RigidBody.h"
+#include "Gameplay/Components/Vehicle.h"
+#include "Gameplay/Systems/ShapeCache.h"
+#include "Gameplay/Systems/UniformGridBroadphase.h"
+#include "Gameplay/Systems/Vehicles.h"
+#include "Utils/Constants.h"
+#include "Utils/Vertex.h"
 
 namespace Systems
 {
+enum class Broadphase
+{
+    DynamicAabbTree,
+    AxisSweep,
+    UniformGrid,
+};
+
+struct PhysicsSettings
+{
+    /* Threads processing collision pairs and islands */
+    u32 workerCount = Constants::PHYSICS_WORKER_COUNT;
+    Broadphase broadphase = Broadphase::DynamicAabbTree;
+    /* Axis sweep only handles bodies inside these bounds */
+    glm::vec3 worldHalfExtents = glm::vec3(2048.0f);
+    f32 gridCellSize = 4.0f;
+    /* Empty rebuilds the BVHs of triangle meshes every time instead of
+     * caching them on disk */
+    std::string cacheDirectory = Constants::PHYSICS_CACHE_DIRECTORY;
+};
+
+/* Of the step that produced the latest snapshot */
+struct PhysicsStatistics
+{
+    u64 step = 0;
+    u32 bodyCount = 0;
+    u32 overlappingPairCount = 0;
+    u32 manifoldCount = 0;
+    f32 stepMilliseconds = 0.0f;
+};
+
+/* The simulation runs on its own thread at a fixed tick rate. Gameplay talks
+ * to it through commands, it answers with a snapshot of the bodies after
+ * every step, which Update interpolates into the registry. Once Start was
+ * called the Bullet world belongs to the physics thread. */
 class Physics
 {
+    static constexpr const u32 BODIES_PER_CHUNK = 256;
+
+    class TaskScheduler;
+
+    /* Bullet calls setWorldTransform only for the active bodies that moved
+     * during the step, so only those get their state updated */
+    class MotionState : public btMotionState
+    {
+    public:
+        MotionState(Physics *physics, u32 bodyIndex,
+                    btTransform const &startTransform)
+            : mPhysics(physics), mBodyIndex(bodyIndex),
+              mWorldTransform(startTransform)
+        {
+        }
+
+        void getWorldTransform(btTransform &worldTransform) const override
+        {
+            worldTransform = mWorldTransform;
+        }
+
+        void setWorldTransform(btTransform const &worldTransform) override
+        {
+            mWorldTransform = worldTransform;
+            mPhysics->OnBodyMoved(mBodyIndex, worldTransform);
+        }
+
+    private:
+        Physics *mPhysics;
+        u32 mBodyIndex;
+        btTransform mWorldTransform;
+    };
+
+    /* Everything a body needs in one pool slot */
+    struct Body
+    {
+        Body(Physics *physics, u32 bodyIndex, f32 mass,
+             btCollisionShape *collisionShape, btVector3 const &localInertia,
+             btTransform const &startTransform)
+            : motionState(physics, bodyIndex, startTransform),
+              rigidBody(btRigidBody::btRigidBodyConstructionInfo(
+                  mass, &motionState, collisionShape, localInertia))
+        {
+        }
+
+        MotionState motionState;
+        btRigidBody rigidBody;
+    };
+
+    /* Main thread bookkeeping of a body slot */
+    struct BodySlot
+    {
+        /* Bumped when the body is destroyed, invalidating its handles */
+        u32 generation = 1;
+        /* Null while the slot is free */
+        entt::entity entity = entt::null;
+        /* Zero for static bodies */
+        f32 mass = 0.0f;
+        bool hasVehicle = false;
+    };
+
+    /* State of a body after a step, written on the physics thread */
+    struct BodyState
+    {
+        entt::entity entity;
+        /* Tells the body apart from an older body of the same entity */
+        Components::BodyHandle body;
+        glm::vec3 position;
+        glm::quat rotation;
+        /* Last step that moved the body */
+        u64 lastMovedStep;
+    };
+
+    struct Snapshot
+    {
+        u64 step = 0;
+        std::chrono::steady_clock::time_point time;
+        PhysicsStatistics statistics;
+        /* Only the bodies that moved since the snapshot the main thread last
+         * picked up */
+        std::vector<BodyState> bodies;
+    };
+
+    struct Command
+    {
+        enum class Type
+        {
+            AddRigidBody,
+            RemoveRigidBody,
+            ApplyCentralImpulse,
+            SetAngularVelocity,
+            AddVehicle,
+            RemoveVehicle,
+            SetVehicleControls,
+        };
+
+        Type type;
+        u32 bodyIndex;
+        /* Start position for AddRigidBody, throttle, brake and steering for
+         * SetVehicleControls */
+        btVector3 value;
+
+        /* AddRigidBody only */
+        entt::entity entity;
+        u32 generation;
+        btCollisionShape *collisionShape;
+        f32 mass;
+
+        /* AddVehicle only */
+        VehicleSettings vehicleSettings;
+    };
+
+    /* Keeps the state of the last two snapshots that moved the body to
+     * interpolate between them, indexed by entity. Main thread only. */
+    struct SyncedTransform
+    {
+        /* Null once the body was destroyed */
+        entt::entity entity = entt::null;
+        /* Snapshot states only apply to the body they were taken from, the
+         * entity may have been given a new body since */
+        Components::BodyHandle body;
+
+        glm::vec3 previousPosition;
+        glm::quat previousRotation;
+        glm::vec3 position;
+        glm::quat rotation;
+
+        /* Step that produced position and rotation */
+        u64 lastMovedStep = 0;
+        bool isQueued = false;
+    };
+
 public:
-    Physics();
+    Physics(PhysicsSettings const &settings = {});
     ~Physics();
 
 public:
-    void Update(float dt, entt::registry &registry);
+    void Start();
+    void Stop();
+
+    /* Steps on the calling thread instead, for tools and benchmarks that
+     * don't start the physics thread */
+    void RunSteps(u32 stepCount);
+
+    /**
+     * @brief Picks up the latest snapshot from the physics thread and writes
+     * the bodies' transforms interpolated between the last two steps
+     */
+    void Update(entt::registry &registry);
+
+    void SetTickRate(f32 ticksPerSecond);
+
+    PhysicsStatistics const &GetStatistics() const
+    {
+        return mStatistics;
+    }
 
+    /* Must be called before Start, the interface is used on the physics
+     * thread */
     void SetDebugInterface(btIDebugDraw *debugInterface)
     {
         mWorld->setDebugDrawer(debugInterface);
     }
 
 public:
-    Components::RigidBody CreateRigidBody(Components::Base const &base,
-                                          Components::Mesh const &mesh,
-                                          float mass);
+    /* vertices are the mesh's, used the first time a shape gets built for
+     * it */
+    Components::RigidBody
+    CreateRigidBody(entt::entity entity, Components::Base const &base,
+                    Components::Mesh const &mesh,
+                    std::span<VertexPositionNormal const> vertices, float mass);
+    /* Exact collision for static geometry like the track, the triangles
+     * have to stay in place while the body is alive */
+    Components::RigidBody
+    CreateStaticMeshBody(entt::entity entity, Components::Base const &base,
+                         Components::Mesh const &mesh,
+                         TriangleMeshData const &triangles);
+    /* Frees the body's slot right away, the handle is invalid after this */
+    void DestroyRigidBody(Components::BodyHandle body);
+    bool IsAlive(Components::BodyHandle body) const;
+
+    void ApplyCentralImpulse(Components::BodyHandle body,
+                             glm::vec3 const &impulse);
+    void SetAngularVelocity(Components::BodyHandle body,
+                            glm::vec3 const &velocity);
+
+    /* Turns a dynamic body into the chassis of a car, the vehicle goes away
+     * with the body */
+    Components::Vehicle CreateVehicle(Components::BodyHandle body,
+                                      VehicleSettings const &settings = {});
+    void DestroyVehicle(Components::Vehicle const &vehicle);
+    /* See Vehicles::SetControls for the ranges */
+    void SetVehicleControls(Components::Vehicle const &vehicle, f32 throttle,
+                            f32 brake, f32 steering);
 
 private:
+    Components::RigidBody CreateBody(entt::entity entity,
+                                     glm::vec3 const &translation,
+                                     btCollisionShape *collisionShape,
+                                     float mass);
+
+    /* Physics thread */
+    void Run(std::stop_token stopToken);
+    void ExecuteCommands();
+    void Step();
+    void OnBodyMoved(u32 bodyIndex, btTransform const &transform);
+
+    /* Main thread */
+    void PushCommand(Command const &command);
+    void ConsumeSnapshot();
+    void ApplyMovedBodies(entt::registry &registry, f32 alpha);
+
+private:
+    std::unique_ptr<TaskScheduler> mTaskScheduler;
     std::unique_ptr<btDefaultCollisionConfiguration>
         mDefaultCollisionConfiguration;
     std::unique_ptr<btCollisionDispatcher> mDispatcher;
     std::unique_ptr<btBroadphaseInterface> mBroadphaseInterface;
-    std::unique_ptr<btSequentialImpulseConstraintSolver> mSolver;
+    std::unique_ptr<btConstraintSolver> mSolver;
     std::unique_ptr<btDiscreteDynamicsWorld> mWorld;
 
-    std::vector<std::unique_ptr<btRigidBody>> mRigidBodies;
-    std::vector<std::unique_ptr<btCollisionShape>> mCollisionShapes;
-    std::vector<std::unique_ptr<btDefaultMotionState>> mDefaultMotionStates;
+    ShapeCache mShapeCache;
+
+    /* Main thread side of the body slots */
+    std::vector<BodySlot> mBodySlots;
+    std::vector<u32> mFreeBodyIndices;
+
+    std::atomic<f32> mTimeStep;
+    std::jthread mThread;
+
+    /* Physics thread state, bodies are indexed by body index */
+    PoolAllocator<Body, BODIES_PER_CHUNK> mBodyPool;
+    std::vector<Body *> mBodies;
+    Vehicles mVehicles;
+    u64 mStepCount = 0;
+    std::vector<BodyState> mBodyStates;
+    /* Bodies that moved since the last consumed snapshot, once each */
+    std::vector<u32> mMovedBodies;
+    std::vector<u8> mIsBodyMoved;
+    std::vector<Command> mExecutingCommands;
+
+    std::mutex mCommandsMutex;
+    std::vector<Command> mPendingCommands;
+
+    TripleBuffer<Snapshot> mSnapshots;
+    /* Step of the last snapshot the main thread picked up */
+    std::atomic<u64> mConsumedStep = 0;
+
+    /* Main thread state */
+    u64 mSnapshotStep = 0;
+    std::chrono::steady_clock::time_point mSnapshotTime;
+    PhysicsStatistics mStatistics;
+
+    std::vector<SyncedTransform> mSyncedTransforms;
+    /* Bodies moved by the snapshots since the last ApplyMovedBodies */
+    std::vector<entt::entity> mMovedEntities;
+    /* Bodies that moved in the last step, they have to be interpolated every
+     * frame until the next snapshot */
+    std::vector<entt::entity> mInterpolatedEntities;
 };
 } // namespace Systems
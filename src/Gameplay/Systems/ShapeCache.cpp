@@ -0,0 +1,347 @@
+#include "ShapeCache.h"
+#include "BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h"
+#include "BulletCollision/CollisionShapes/btShapeHull.h"
+#include "BulletCollision/CollisionShapes/btUniformScalingShape.h"
+#include "Check.h"
+#include "FileHelpers.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+
+namespace Systems
+{
+/* Scales coming out of a decomposed world matrix are a bit noisy, round them
+ * so they still share a shape */
+static constexpr const f32 SCALE_PRECISION = 1.0f / 1024.0f;
+
+/* 'JBVH' */
+static constexpr const u32 BVH_FILE_MAGIC = 0x4856424a;
+static constexpr const u32 BVH_FILE_VERSION = 1;
+
+/* Followed by the BVH serialized in place, which has to be 16 byte aligned */
+struct alignas(16) BvhFileHeader
+{
+    u32 magic;
+    u32 version;
+    /* Of the triangles the BVH was built for */
+    u64 hash;
+    u32 bvhSize;
+};
+
+static btVector3 ToBullet(glm::vec3 const &vector)
+{
+    return btVector3(vector.x, vector.y, vector.z);
+}
+
+template <typename T>
+static u64 HashBytes(u64 hash, std::span<T const> data)
+{
+    /* FNV-1a */
+    auto const *bytes = (unsigned char const *)data.data();
+    for (size_t i = 0; i < data.size_bytes(); ++i)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3;
+    }
+    return hash;
+}
+
+/* The in place layout depends on the build of Bullet as well */
+static u64 HashTriangles(TriangleMeshData const &triangles)
+{
+    u64 hash = 0xcbf29ce484222325;
+    u32 layout[] = {(u32)sizeof(btScalar), (u32)sizeof(void *),
+                    (u32)sizeof(btQuantizedBvh)};
+    hash = HashBytes(hash, std::span<u32 const>(layout));
+    hash = HashBytes(hash, triangles.vertices);
+    hash = HashBytes(hash, triangles.indices16);
+    hash = HashBytes(hash, triangles.indices32);
+    return hash;
+}
+
+std::size_t ShapeCache::KeyHash::operator()(Key const &key) const
+{
+    std::size_t hash = std::hash<std::string>()(key.path) ^ key.isTriangleMesh;
+    for (u32 i = 0; i < 3; ++i)
+    {
+        hash ^= std::hash<f32>()(key.scale[i]) + 0x9e3779b9 + (hash << 6) +
+                (hash >> 2);
+    }
+    return hash;
+}
+
+btCollisionShape *
+ShapeCache::Acquire(Components::Mesh const &mesh,
+                    std::span<VertexPositionNormal const> vertices,
+                    glm::vec3 scale)
+{
+    Key key{.path = mesh.path,
+            .scale = glm::round(scale / SCALE_PRECISION) * SCALE_PRECISION};
+
+    std::scoped_lock lock(mMutex);
+    return AcquireLocked(key, mesh, vertices);
+}
+
+btCollisionShape *
+ShapeCache::AcquireTriangleMesh(Components::Mesh const &mesh,
+                                TriangleMeshData const &triangles,
+                                glm::vec3 scale)
+{
+    Key key{.path = mesh.path,
+            .scale = glm::round(scale / SCALE_PRECISION) * SCALE_PRECISION,
+            .isTriangleMesh = true};
+
+    std::scoped_lock lock(mMutex);
+
+    /* Scaled versions are built on top of the unscaled shape by
+     * AcquireLocked, it only has to exist */
+    Key baseKey{.path = key.path,
+                .scale = glm::vec3(1.0f),
+                .isTriangleMesh = true};
+    if (mEntries.find(baseKey) == mEntries.end())
+    {
+        Entry entry;
+        CreateTriangleMeshShape(entry, mesh, triangles);
+
+        mKeys[entry.shape.get()] = baseKey;
+        mEntries.emplace(baseKey, std::move(entry));
+    }
+    return AcquireLocked(key, mesh, {});
+}
+
+void ShapeCache::Release(btCollisionShape *shape)
+{
+    std::scoped_lock lock(mMutex);
+    ReleaseLocked(shape);
+}
+
+u32 ShapeCache::GetShapeCount() const
+{
+    std::scoped_lock lock(mMutex);
+    return (u32)mEntries.size();
+}
+
+btCollisionShape *
+ShapeCache::AcquireLocked(Key const &key, Components::Mesh const &mesh,
+                          std::span<VertexPositionNormal const> vertices)
+{
+    if (auto it = mEntries.find(key); it != mEntries.end())
+    {
+        it->second.refCount++;
+        return it->second.shape.get();
+    }
+
+    Entry entry;
+    if (key.scale == glm::vec3(1.0f))
+    {
+        entry.shape = CreateShape(mesh, vertices);
+    }
+    else
+    {
+        Key baseKey{.path = key.path,
+                    .scale = glm::vec3(1.0f),
+                    .isTriangleMesh = key.isTriangleMesh};
+        entry.base = AcquireLocked(baseKey, mesh, vertices);
+        entry.shape = CreateScaledShape(entry.base, key.scale);
+    }
+    entry.refCount = 1;
+
+    btCollisionShape *shape = entry.shape.get();
+    mKeys[shape] = key;
+    mEntries.emplace(key, std::move(entry));
+    return shape;
+}
+
+void ShapeCache::ReleaseLocked(btCollisionShape *shape)
+{
+    auto keyIt = mKeys.find(shape);
+    CHECK_FATAL(keyIt != mKeys.end(),
+                "Releasing a collision shape that's not in the cache");
+
+    auto entryIt = mEntries.find(keyIt->second);
+    if (--entryIt->second.refCount > 0)
+    {
+        return;
+    }
+
+    btCollisionShape *base = entryIt->second.base;
+    mKeys.erase(keyIt);
+    mEntries.erase(entryIt);
+    if (base != nullptr)
+    {
+        ReleaseLocked(base);
+    }
+}
+
+std::unique_ptr<btCollisionShape>
+ShapeCache::CreateShape(Components::Mesh const &mesh,
+                        std::span<VertexPositionNormal const> vertices) const
+{
+    if (mesh.path == "cube")
+    {
+        return std::make_unique<btBoxShape>(ToBullet(mesh.bounds.extents));
+    }
+
+    CHECK_FATAL(!vertices.empty(), "Can't build a collision shape for ",
+                mesh.path, " without vertices");
+
+    /* Collision detection cost grows with the hull's vertex count, keep only
+     * the ones that define its silhouette */
+    btConvexHullShape points;
+    for (auto const &vertex : vertices)
+    {
+        points.addPoint(ToBullet(vertex.position), false);
+    }
+    points.recalcLocalAabb();
+
+    btShapeHull hull(&points);
+    hull.buildHull(points.getMargin());
+    DSHOWINFO("Built convex hull for ", mesh.path, ": vertices ",
+              vertices.size(), " -> ", hull.numVertices());
+
+    return std::make_unique<btConvexHullShape>(
+        &hull.getVertexPointer()->getX(), hull.numVertices(),
+        (i32)sizeof(btVector3));
+}
+
+void ShapeCache::CreateTriangleMeshShape(
+    Entry &entry, Components::Mesh const &mesh,
+    TriangleMeshData const &triangles) const
+{
+    bool use16BitIndices = !triangles.indices16.empty();
+    CHECK_FATAL(use16BitIndices != !triangles.indices32.empty(),
+                "A triangle mesh needs exactly one kind of indices");
+
+    /* Bullet reads the triangles straight from the geometry buffers */
+    btIndexedMesh indexedMesh;
+    indexedMesh.m_numVertices = (i32)triangles.vertices.size();
+    indexedMesh.m_vertexBase =
+        (unsigned char const *)triangles.vertices.data();
+    indexedMesh.m_vertexStride = sizeof(VertexPositionNormal);
+    indexedMesh.m_vertexType = PHY_FLOAT;
+    if (use16BitIndices)
+    {
+        indexedMesh.m_numTriangles = (i32)triangles.indices16.size() / 3;
+        indexedMesh.m_triangleIndexBase =
+            (unsigned char const *)triangles.indices16.data();
+        indexedMesh.m_triangleIndexStride = 3 * sizeof(u16);
+        indexedMesh.m_indexType = PHY_SHORT;
+    }
+    else
+    {
+        indexedMesh.m_numTriangles = (i32)triangles.indices32.size() / 3;
+        indexedMesh.m_triangleIndexBase =
+            (unsigned char const *)triangles.indices32.data();
+        indexedMesh.m_triangleIndexStride = 3 * sizeof(u32);
+        indexedMesh.m_indexType = PHY_INTEGER;
+    }
+
+    entry.triangles = std::make_unique<btTriangleIndexVertexArray>();
+    entry.triangles->addIndexedMesh(indexedMesh, indexedMesh.m_indexType);
+
+    u64 hash = HashTriangles(triangles);
+    if (mCacheDirectory.empty())
+    {
+        entry.shape = std::make_unique<btBvhTriangleMeshShape>(
+            entry.triangles.get(), true, true);
+        return;
+    }
+
+    /* Named after the triangles rather than the mesh path, procedural meshes
+     * have no file to sit next to */
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.bvh",
+                  (unsigned long long)hash);
+    std::string bvhPath =
+        (std::filesystem::path(mCacheDirectory) / fileName).string();
+    if (entry.bvhFile.Open(bvhPath))
+    {
+        auto const *header = (BvhFileHeader const *)entry.bvhFile.GetData();
+        bool isValid = entry.bvhFile.GetSize() >= sizeof(BvhFileHeader) &&
+                       header->magic == BVH_FILE_MAGIC &&
+                       header->version == BVH_FILE_VERSION &&
+                       header->hash == hash &&
+                       header->bvhSize ==
+                           entry.bvhFile.GetSize() - sizeof(BvhFileHeader);
+
+        /* Fixes up the pointers inside the mapping, which only copies the
+         * first page */
+        btQuantizedBvh *bvh =
+            isValid ? btQuantizedBvh::deSerializeInPlace(
+                          entry.bvhFile.GetData() + sizeof(BvhFileHeader),
+                          header->bvhSize, false)
+                    : nullptr;
+        if (bvh != nullptr)
+        {
+            auto shape = std::make_unique<btBvhTriangleMeshShape>(
+                entry.triangles.get(), true, false);
+            shape->setOptimizedBvh(static_cast<btOptimizedBvh *>(bvh));
+            entry.shape = std::move(shape);
+            DSHOWINFO("Loaded BVH for ", mesh.path, " from ", bvhPath);
+            return;
+        }
+
+        SHOWWARNING("BVH in ", bvhPath, " is out of date, rebuilding it");
+        entry.bvhFile.Close();
+    }
+
+    auto shape = std::make_unique<btBvhTriangleMeshShape>(
+        entry.triangles.get(), true, true);
+
+    btOptimizedBvh *bvh = shape->getOptimizedBvh();
+    u32 bvhSize = bvh->calculateSerializeBufferSize();
+
+    static_assert(__STDCPP_DEFAULT_NEW_ALIGNMENT__ >= alignof(BvhFileHeader),
+                  "The serialized BVH wouldn't be aligned");
+    std::vector<unsigned char> data(sizeof(BvhFileHeader) + bvhSize);
+    BvhFileHeader header{.magic = BVH_FILE_MAGIC,
+                         .version = BVH_FILE_VERSION,
+                         .hash = hash,
+                         .bvhSize = bvhSize};
+    std::memcpy(data.data(), &header, sizeof(header));
+    std::error_code error;
+    std::filesystem::create_directories(mCacheDirectory, error);
+    if (!error && bvh->serializeInPlace(data.data() + sizeof(BvhFileHeader),
+                                        bvhSize, false))
+    {
+        Jnrlib::DumpWholeFile(bvhPath, data, false);
+    }
+
+    SHOWINFO("Built BVH for ", mesh.path, " with ",
+             indexedMesh.m_numTriangles, " triangles");
+    entry.shape = std::move(shape);
+}
+
+std::unique_ptr<btCollisionShape>
+ShapeCache::CreateScaledShape(btCollisionShape *base, glm::vec3 scale) const
+{
+    if (base->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE)
+    {
+        return std::make_unique<btScaledBvhTriangleMeshShape>(
+            static_cast<btBvhTriangleMeshShape *>(base), ToBullet(scale));
+    }
+
+    if (base->getShapeType() == BOX_SHAPE_PROXYTYPE)
+    {
+        /* A box is as cheap as a wrapper and scales exactly */
+        btVector3 halfExtents =
+            static_cast<btBoxShape *>(base)->getHalfExtentsWithMargin();
+        return std::make_unique<btBoxShape>(halfExtents * ToBullet(scale));
+    }
+
+    if (scale.x == scale.y && scale.y == scale.z)
+    {
+        return std::make_unique<btUniformScalingShape>(
+            static_cast<btConvexShape *>(base), scale.x);
+    }
+
+    /* Non uniform scaling has to be baked in a copy of the hull */
+    auto *hull = static_cast<btConvexHullShape *>(base);
+    auto scaled = std::make_unique<btConvexHullShape>(
+        &hull->getUnscaledPoints()->getX(), hull->getNumPoints(),
+        (i32)sizeof(btVector3));
+    scaled->setLocalScaling(ToBullet(scale));
+    return scaled;
+}
+} // namespace Systems
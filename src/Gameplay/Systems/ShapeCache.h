@@ -0,0 +1,115 @@
+#pragma once
+
+#include "btBulletCollisionCommon.h"
+
+#include "MappedFile.h"
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+#include "Gameplay/Components/Mesh.h"
+#include "Utils/Vertex.h"
+
+namespace Systems
+{
+/* Triangles of a mesh as they are laid out in the global geometry buffers,
+ * exactly one of the index spans is set. Triangle mesh shapes read straight
+ * from these, so they must not move while the shape is alive. */
+struct TriangleMeshData
+{
+    std::span<VertexPositionNormal const> vertices;
+    std::span<u16 const> indices16;
+    std::span<u32 const> indices32;
+};
+
+/* Collision shapes shared between every body using the same mesh at the same
+ * scale. The unscaled shape of a mesh is built once, scaled shapes wrap it
+ * when Bullet allows it. Shapes are reference counted and destroyed with
+ * their last body. Bodies are created on the main thread and destroyed on the
+ * physics thread, so the cache locks. */
+class ShapeCache
+{
+    struct Key
+    {
+        std::string path;
+        glm::vec3 scale;
+        bool isTriangleMesh = false;
+
+        bool operator==(Key const &other) const = default;
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(Key const &key) const;
+    };
+
+    struct Entry
+    {
+        /* Only for triangle meshes, used by the shape */
+        std::unique_ptr<btTriangleIndexVertexArray> triangles;
+        Jnrlib::MappedFile bvhFile;
+
+        std::unique_ptr<btCollisionShape> shape;
+        u32 refCount = 0;
+        /* Unscaled shape this one was derived from, kept alive by it */
+        btCollisionShape *base = nullptr;
+    };
+
+public:
+    /* BVHs are cached in cacheDirectory, or not at all if it's empty */
+    explicit ShapeCache(std::string cacheDirectory)
+        : mCacheDirectory(std::move(cacheDirectory)) {};
+    ~ShapeCache() = default;
+
+    ShapeCache(ShapeCache const &) = delete;
+    ShapeCache &operator=(ShapeCache const &) = delete;
+
+public:
+    /**
+     * @brief Returns the shape of mesh scaled by scale, building it from
+     * vertices the first time the mesh is used. Boxes stay boxes, every other
+     * mesh gets a simplified convex hull.
+     */
+    btCollisionShape *Acquire(Components::Mesh const &mesh,
+                              std::span<VertexPositionNormal const> vertices,
+                              glm::vec3 scale);
+
+    /**
+     * @brief Returns an exact triangle mesh shape for static bodies. The BVH
+     * over the triangles is baked to a file in the cache directory named
+     * after the hash of the triangles and mapped from there the next time.
+     */
+    btCollisionShape *AcquireTriangleMesh(Components::Mesh const &mesh,
+                                          TriangleMeshData const &triangles,
+                                          glm::vec3 scale);
+
+    void Release(btCollisionShape *shape);
+
+    u32 GetShapeCount() const;
+
+private:
+    btCollisionShape *
+    AcquireLocked(Key const &key, Components::Mesh const &mesh,
+                  std::span<VertexPositionNormal const> vertices);
+    void ReleaseLocked(btCollisionShape *shape);
+
+    std::unique_ptr<btCollisionShape>
+    CreateShape(Components::Mesh const &mesh,
+                std::span<VertexPositionNormal const> vertices) const;
+    void CreateTriangleMeshShape(Entry &entry, Components::Mesh const &mesh,
+                                 TriangleMeshData const &triangles) const;
+    std::unique_ptr<btCollisionShape> CreateScaledShape(btCollisionShape *base,
+                                                        glm::vec3 scale) const;
+
+private:
+    std::string mCacheDirectory;
+
+    mutable std::mutex mMutex;
+    std::unordered_map<Key, Entry, KeyHash> mEntries;
+    std::unordered_map<btCollisionShape *, Key> mKeys;
+};
+} // namespace Systems
@@ -0,0 +1,252 @@
+#include "TransformSystem.h"
+
+#include "Check.h"
+#include "JobSystem.h"
+#include "Gameplay/Components/Base.h"
+#include "Gameplay/Components/Hierarchy.h"
+#include "Gameplay/Components/InverseWorld.h"
+#include "Gameplay/Components/Transform.h"
+#include "Gameplay/Components/Update.h"
+#include "Utils/Constants.h"
+
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace Systems
+{
+/* Levels smaller than this are not worth waking up other threads for */
+static constexpr const u32 MIN_NODES_PER_JOB = 2048;
+
+static glm::mat4x4 ComposeTransform(Components::Transform const &transform)
+{
+    glm::mat4x4 result = glm::mat4_cast(transform.rotation);
+    result[0] *= transform.scale.x;
+    result[1] *= transform.scale.y;
+    result[2] *= transform.scale.z;
+    result[3] = glm::vec4(transform.position, 1.0f);
+    return result;
+}
+
+void TransformSystem::Connect(entt::registry &registry)
+{
+    registry.on_construct<Components::Transform>().connect<&TransformSystem::OnLayoutChanged>(this);
+    registry.on_destroy<Components::Transform>().connect<&TransformSystem::OnLayoutChanged>(this);
+    registry.on_update<Components::Transform>().connect<&TransformSystem::OnTransformChanged>(this);
+
+    registry.on_construct<Components::Hierarchy>().connect<&TransformSystem::OnLayoutChanged>(this);
+    registry.on_destroy<Components::Hierarchy>().connect<&TransformSystem::OnLayoutChanged>(this);
+    registry.on_update<Components::Hierarchy>().connect<&TransformSystem::OnLayoutChanged>(this);
+
+    mIsLayoutDirty = true;
+}
+
+void TransformSystem::OnLayoutChanged(entt::registry &, entt::entity)
+{
+    mIsLayoutDirty = true;
+}
+
+void TransformSystem::OnTransformChanged(entt::registry &registry, entt::entity entity)
+{
+    if (mIsLayoutDirty)
+    {
+        /* Everything is recomputed anyway */
+        return;
+    }
+
+    u32 index = mDenseIndices[entt::to_entity(entity)];
+    mLocal[index] = ComposeTransform(registry.get<Components::Transform>(entity));
+    mDirtyNodes.push_back(index);
+}
+
+void TransformSystem::Rebuild(entt::registry const &registry)
+{
+    auto transforms = registry.view<const Components::Transform>();
+
+    std::vector<entt::entity> nodes(transforms.begin(), transforms.end());
+    u32 maxEntityId = 0;
+    for (auto entity : nodes)
+    {
+        maxEntityId = std::max(maxEntityId, (u32)entt::to_entity(entity));
+    }
+    mDenseIndices.assign(nodes.empty() ? 0 : maxEntityId + 1, INVALID_INDEX);
+    for (u32 i = 0; i < nodes.size(); ++i)
+    {
+        mDenseIndices[entt::to_entity(nodes[i])] = i;
+    }
+
+    auto getParentNode = [&](u32 node) -> u32 {
+        auto const *hierarchy = registry.try_get<Components::Hierarchy>(nodes[node]);
+        if (hierarchy == nullptr || hierarchy->parent == entt::null || !transforms.contains(hierarchy->parent))
+        {
+            return INVALID_INDEX;
+        }
+        return mDenseIndices[entt::to_entity(hierarchy->parent)];
+    };
+
+    std::vector<u32> parentNodes(nodes.size());
+    for (u32 i = 0; i < nodes.size(); ++i)
+    {
+        parentNodes[i] = getParentNode(i);
+    }
+
+    /* Children of node i are childNodes[childOffsets[i], childOffsets[i + 1]) */
+    std::vector<u32> childOffsets(nodes.size() + 1, 0);
+    for (u32 parent : parentNodes)
+    {
+        if (parent != INVALID_INDEX)
+        {
+            childOffsets[parent + 1]++;
+        }
+    }
+    for (u32 i = 0; i < nodes.size(); ++i)
+    {
+        childOffsets[i + 1] += childOffsets[i];
+    }
+    std::vector<u32> childNodes(childOffsets.back());
+    {
+        std::vector<u32> cursors(childOffsets.begin(), childOffsets.end() - 1);
+        for (u32 i = 0; i < nodes.size(); ++i)
+        {
+            if (parentNodes[i] != INVALID_INDEX)
+            {
+                childNodes[cursors[parentNodes[i]]++] = i;
+            }
+        }
+    }
+
+    /* Pre-order walk from every root. A subtree ends where the walk leaves it, which is when the stack drops below
+     * the node again */
+    std::vector<u32> sortedNodes;
+    sortedNodes.reserve(nodes.size());
+    mSubtreeEnds.resize(nodes.size());
+    std::vector<u32> stack;
+    std::vector<u32> openSubtrees;
+    for (u32 root = 0; root < nodes.size(); ++root)
+    {
+        if (parentNodes[root] != INVALID_INDEX)
+        {
+            continue;
+        }
+
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            u32 node = stack.back();
+            stack.pop_back();
+
+            /* Close the subtrees the walk is leaving */
+            while (!openSubtrees.empty() && openSubtrees.back() != parentNodes[node])
+            {
+                mSubtreeEnds[openSubtrees.back()] = (u32)sortedNodes.size();
+                openSubtrees.pop_back();
+            }
+
+            sortedNodes.push_back(node);
+            openSubtrees.push_back(node);
+            for (u32 child = childOffsets[node + 1]; child > childOffsets[node]; --child)
+            {
+                stack.push_back(childNodes[child - 1]);
+            }
+        }
+        for (u32 node : openSubtrees)
+        {
+            mSubtreeEnds[node] = (u32)sortedNodes.size();
+        }
+        openSubtrees.clear();
+    }
+    /* Nodes in a cycle have no root to be reached from */
+    CHECK_FATAL(sortedNodes.size() == nodes.size(), "Cycle found in the entity hierarchy");
+
+    /* mSubtreeEnds is indexed by node so far, remap it along with everything else */
+    std::vector<u32> subtreeEnds(nodes.size());
+    for (u32 i = 0; i < sortedNodes.size(); ++i)
+    {
+        subtreeEnds[i] = mSubtreeEnds[sortedNodes[i]];
+        mDenseIndices[entt::to_entity(nodes[sortedNodes[i]])] = i;
+    }
+    mSubtreeEnds = std::move(subtreeEnds);
+
+    mEntities.resize(nodes.size());
+    mParents.resize(nodes.size());
+    mLocal.resize(nodes.size());
+    mWorld.resize(nodes.size());
+    for (u32 i = 0; i < sortedNodes.size(); ++i)
+    {
+        u32 node = sortedNodes[i];
+        mEntities[i] = nodes[node];
+        mParents[i] = parentNodes[node] == INVALID_INDEX ? INVALID_INDEX
+                                                         : mDenseIndices[entt::to_entity(nodes[parentNodes[node]])];
+        mLocal[i] = ComposeTransform(transforms.get<const Components::Transform>(nodes[node]));
+    }
+
+    /* Every root, which covers every node */
+    mDirtyNodes.clear();
+    for (u32 i = 0; i < mEntities.size(); i = mSubtreeEnds[i])
+    {
+        mDirtyNodes.push_back(i);
+    }
+
+    mIsLayoutDirty = false;
+}
+
+void TransformSystem::UpdateSubtree(u32 first)
+{
+    for (u32 i = first; i < mSubtreeEnds[first]; ++i)
+    {
+        /* Parents come first, so they are already done */
+        u32 parent = mParents[i];
+        mWorld[i] = parent == INVALID_INDEX ? mLocal[i] : mWorld[parent] * mLocal[i];
+    }
+}
+
+void TransformSystem::Update(entt::registry &registry)
+{
+    if (mIsLayoutDirty)
+    {
+        Rebuild(registry);
+    }
+    if (mDirtyNodes.empty())
+    {
+        return;
+    }
+
+    /* A dirty node inside the subtree of an earlier dirty node is covered by it */
+    std::sort(mDirtyNodes.begin(), mDirtyNodes.end());
+    mDirtySubtrees.clear();
+    u32 dirtyNodeCount = 0;
+    u32 coveredEnd = 0;
+    for (u32 node : mDirtyNodes)
+    {
+        if (node < coveredEnd)
+        {
+            continue;
+        }
+        mDirtySubtrees.push_back(node);
+        coveredEnd = mSubtreeEnds[node];
+        dirtyNodeCount += coveredEnd - node;
+    }
+    mDirtyNodes.clear();
+
+    /* Subtrees don't overlap, hand each job about MIN_NODES_PER_JOB nodes */
+    u32 subtreeCount = (u32)mDirtySubtrees.size();
+    u32 subtreesPerJob = std::max((u32)((u64)MIN_NODES_PER_JOB * subtreeCount / dirtyNodeCount), 1u);
+    Jnrlib::JobSystem::Get()->ParallelFor(0, subtreeCount, subtreesPerJob,
+                                          [this](u32 i) { UpdateSubtree(mDirtySubtrees[i]); });
+
+    /* Written directly instead of through registry.patch, the side effects of
+     * the Base listener of Systems::UpdateFrame are done here instead */
+    for (u32 first : mDirtySubtrees)
+    {
+        for (u32 i = first; i < mSubtreeEnds[first]; ++i)
+        {
+            if (auto *base = registry.try_get<Components::Base>(mEntities[i]); base != nullptr)
+            {
+                base->world = mWorld[i];
+                Components::InvalidateInverseWorld(registry, mEntities[i]);
+                Components::MarkDirty(registry, mEntities[i]);
+            }
+        }
+    }
+}
+} // namespace Systems
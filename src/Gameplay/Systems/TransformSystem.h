@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Jnrlib.h"
+#include "entt/entt.hpp"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace Systems
+{
+/* Computes Components::Base::world from Components::Transform for every
+ * entity that has one, following Components::Hierarchy.
+ *
+ * The nodes are kept in dense arrays in depth-first order, so a parent always
+ * comes before its children and every subtree is a contiguous range. Only the
+ * subtrees under a changed transform are recomputed and written back, separate
+ * subtrees in parallel. */
+class TransformSystem
+{
+public:
+    TransformSystem() = default;
+
+    TransformSystem(const TransformSystem &) = delete;
+    TransformSystem(TransformSystem &&) = delete;
+    TransformSystem &operator=(const TransformSystem &) = delete;
+    TransformSystem &operator=(TransformSystem &&) = delete;
+
+public:
+    /**
+     * @brief Starts listening for transform and hierarchy changes in registry
+     */
+    void Connect(entt::registry &registry);
+
+    /**
+     * @brief Propagates the transforms that changed since the last update
+     */
+    void Update(entt::registry &registry);
+
+private:
+    void OnLayoutChanged(entt::registry &registry, entt::entity entity);
+    void OnTransformChanged(entt::registry &registry, entt::entity entity);
+
+    void Rebuild(entt::registry const &registry);
+    /* Recomputes [first, mSubtreeEnds[first]), the parent of first is up to date */
+    void UpdateSubtree(u32 first);
+
+private:
+    static constexpr const u32 INVALID_INDEX = ~0u;
+
+    /* Dense arrays, in depth-first order */
+    std::vector<entt::entity> mEntities;
+    std::vector<u32> mParents;
+    /* The subtree of node i is [i, mSubtreeEnds[i]) */
+    std::vector<u32> mSubtreeEnds;
+    std::vector<glm::mat4x4> mLocal;
+    std::vector<glm::mat4x4> mWorld;
+
+    /* Nodes whose transform changed since the last update, may repeat */
+    std::vector<u32> mDirtyNodes;
+    /* First node of every subtree the update recomputes, reused between
+     * updates */
+    std::vector<u32> mDirtySubtrees;
+
+    /* Indexed by entt::to_entity */
+    std::vector<u32> mDenseIndices;
+
+    bool mIsLayoutDirty = true;
+};
+} // namespace Systems
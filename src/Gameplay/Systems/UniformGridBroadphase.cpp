@@ -0,0 +1,341 @@
+#include "UniformGridBroadphase.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Systems
+{
+/* Cell coordinates are packed in 21 bits each */
+static constexpr const i32 CELL_COORDINATE_OFFSET = 1 << 20;
+
+static i32 ToCell(btScalar coordinate, f32 inverseCellSize)
+{
+    /* Clamped before the conversion, bounds like BT_LARGE_FLOAT don't fit in
+     * an i32 */
+    f64 cell = std::floor((f64)coordinate * inverseCellSize);
+    cell = std::clamp(cell, (f64)-CELL_COORDINATE_OFFSET,
+                      (f64)(CELL_COORDINATE_OFFSET - 1));
+    return (i32)cell + CELL_COORDINATE_OFFSET;
+}
+
+static u64 PackCell(i32 x, i32 y, i32 z)
+{
+    return (u64)x | ((u64)y << 21) | ((u64)z << 42);
+}
+
+static bool Overlaps(btBroadphaseProxy const *first,
+                     btBroadphaseProxy const *second)
+{
+    return TestAabbAgainstAabb2(first->m_aabbMin, first->m_aabbMax,
+                                second->m_aabbMin, second->m_aabbMax);
+}
+
+UniformGridBroadphase::UniformGridBroadphase(f32 cellSize)
+    : mInverseCellSize(1.0f / cellSize),
+      mPairCache(std::make_unique<btHashedOverlappingPairCache>())
+{
+    CHECK_FATAL(cellSize > 0.0f, "Grid cells must have a positive size");
+}
+
+UniformGridBroadphase::~UniformGridBroadphase()
+{
+    for (Proxy *proxy : mProxies)
+    {
+        mProxyPool.Free(proxy);
+    }
+}
+
+btBroadphaseProxy *UniformGridBroadphase::createProxy(
+    btVector3 const &aabbMin, btVector3 const &aabbMax, int shapeType,
+    void *userPtr, int collisionFilterGroup, int collisionFilterMask,
+    btDispatcher *dispatcher)
+{
+    Proxy *proxy = mProxyPool.Allocate(aabbMin, aabbMax, userPtr,
+                                       collisionFilterGroup,
+                                       collisionFilterMask);
+    proxy->m_uniqueId = mNextUniqueId++;
+    proxy->listIndex = (u32)mProxies.size();
+    mProxies.push_back(proxy);
+    mIsGridValid.store(false, std::memory_order_relaxed);
+    return proxy;
+}
+
+void UniformGridBroadphase::destroyProxy(btBroadphaseProxy *proxy,
+                                         btDispatcher *dispatcher)
+{
+    mPairCache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+
+    Proxy *removed = static_cast<Proxy *>(proxy);
+    Proxy *last = mProxies.back();
+    mProxies[removed->listIndex] = last;
+    last->listIndex = removed->listIndex;
+    mProxies.pop_back();
+    mIsGridValid.store(false, std::memory_order_relaxed);
+
+    mProxyPool.Free(removed);
+}
+
+void UniformGridBroadphase::setAabb(btBroadphaseProxy *proxy,
+                                    btVector3 const &aabbMin,
+                                    btVector3 const &aabbMax,
+                                    btDispatcher *dispatcher)
+{
+    /* The grid is rebuilt from scratch every step, or by the next query */
+    proxy->m_aabbMin = aabbMin;
+    proxy->m_aabbMax = aabbMax;
+    mIsGridValid.store(false, std::memory_order_relaxed);
+}
+
+void UniformGridBroadphase::getAabb(btBroadphaseProxy *proxy,
+                                    btVector3 &aabbMin,
+                                    btVector3 &aabbMax) const
+{
+    aabbMin = proxy->m_aabbMin;
+    aabbMax = proxy->m_aabbMax;
+}
+
+void UniformGridBroadphase::rayTest(btVector3 const &rayFrom,
+                                    btVector3 const &rayTo,
+                                    btBroadphaseRayCallback &rayCallback,
+                                    btVector3 const &aabbMin,
+                                    btVector3 const &aabbMax)
+{
+    /* Bounds of the ray swept by the cast box, the callback does the precise
+     * test */
+    btVector3 rayMin = rayFrom;
+    rayMin.setMin(rayTo);
+    rayMin += aabbMin;
+    btVector3 rayMax = rayFrom;
+    rayMax.setMax(rayTo);
+    rayMax += aabbMax;
+
+    ForEachOverlappingProxy(rayMin, rayMax, [&rayCallback](Proxy *proxy) {
+        rayCallback.process(proxy);
+    });
+}
+
+void UniformGridBroadphase::aabbTest(btVector3 const &aabbMin,
+                                     btVector3 const &aabbMax,
+                                     btBroadphaseAabbCallback &callback)
+{
+    ForEachOverlappingProxy(aabbMin, aabbMax, [&callback](Proxy *proxy) {
+        callback.process(proxy);
+    });
+}
+
+template <typename Process>
+void UniformGridBroadphase::ForEachOverlappingProxy(btVector3 const &aabbMin,
+                                                    btVector3 const &aabbMax,
+                                                    Process &&process)
+{
+    EnsureGrid();
+
+    i32 minX = ToCell(aabbMin.x(), mInverseCellSize);
+    i32 minY = ToCell(aabbMin.y(), mInverseCellSize);
+    i32 minZ = ToCell(aabbMin.z(), mInverseCellSize);
+    i32 maxX = ToCell(aabbMax.x(), mInverseCellSize);
+    i32 maxY = ToCell(aabbMax.y(), mInverseCellSize);
+    i32 maxZ = ToCell(aabbMax.z(), mInverseCellSize);
+
+    /* Past this, looking the cells up costs more than testing every proxy */
+    u64 cellCount = (u64)(maxX - minX + 1) * (u64)(maxY - minY + 1) *
+                    (u64)(maxZ - minZ + 1);
+    if (cellCount > mProxies.size())
+    {
+        for (Proxy *proxy : mProxies)
+        {
+            if (TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin,
+                                     proxy->m_aabbMax))
+            {
+                process(proxy);
+            }
+        }
+        return;
+    }
+
+    /* Cells of a row along x are contiguous in the sorted entries */
+    for (i32 z = minZ; z <= maxZ; ++z)
+    {
+        for (i32 y = minY; y <= maxY; ++y)
+        {
+            u64 rowEnd = PackCell(maxX, y, z);
+            auto entry = std::lower_bound(
+                mCellEntries.begin(), mCellEntries.end(), PackCell(minX, y, z),
+                [](CellEntry const &entry, u64 cell) {
+                    return entry.cell < cell;
+                });
+            for (; entry != mCellEntries.end() && entry->cell <= rowEnd;
+                 ++entry)
+            {
+                Proxy *proxy = entry->proxy;
+                if (!TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin,
+                                          proxy->m_aabbMax))
+                {
+                    continue;
+                }
+
+                /* A proxy is in every cell it covers, it's only reported
+                 * from the first cell it shares with the query */
+                i32 firstX = std::max(
+                    minX, ToCell(proxy->m_aabbMin.x(), mInverseCellSize));
+                i32 firstY = std::max(
+                    minY, ToCell(proxy->m_aabbMin.y(), mInverseCellSize));
+                i32 firstZ = std::max(
+                    minZ, ToCell(proxy->m_aabbMin.z(), mInverseCellSize));
+                if (entry->cell == PackCell(firstX, firstY, firstZ))
+                {
+                    process(proxy);
+                }
+            }
+        }
+    }
+
+    for (Proxy *large : mLargeProxies)
+    {
+        if (TestAabbAgainstAabb2(aabbMin, aabbMax, large->m_aabbMin,
+                                 large->m_aabbMax))
+        {
+            process(large);
+        }
+    }
+}
+
+void UniformGridBroadphase::EnsureGrid()
+{
+    /* Within a step the grid is still the one calculateOverlappingPairs
+     * built, so the vehicle jobs only take the fast path */
+    if (mIsGridValid.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    std::lock_guard lock(mGridMutex);
+    if (!mIsGridValid.load(std::memory_order_relaxed))
+    {
+        BuildGrid();
+    }
+}
+
+void UniformGridBroadphase::calculateOverlappingPairs(btDispatcher *dispatcher)
+{
+    BuildGrid();
+    AddPairs(dispatcher);
+    RemoveStalePairs(dispatcher);
+}
+
+void UniformGridBroadphase::BuildGrid()
+{
+    mCellEntries.clear();
+    mLargeProxies.clear();
+    for (Proxy *proxy : mProxies)
+    {
+        i32 minX = ToCell(proxy->m_aabbMin.x(), mInverseCellSize);
+        i32 minY = ToCell(proxy->m_aabbMin.y(), mInverseCellSize);
+        i32 minZ = ToCell(proxy->m_aabbMin.z(), mInverseCellSize);
+        i32 maxX = ToCell(proxy->m_aabbMax.x(), mInverseCellSize);
+        i32 maxY = ToCell(proxy->m_aabbMax.y(), mInverseCellSize);
+        i32 maxZ = ToCell(proxy->m_aabbMax.z(), mInverseCellSize);
+
+        u64 cellCount = (u64)(maxX - minX + 1) * (u64)(maxY - minY + 1) *
+                        (u64)(maxZ - minZ + 1);
+        if (cellCount > MAX_CELLS_PER_PROXY)
+        {
+            mLargeProxies.push_back(proxy);
+            continue;
+        }
+
+        for (i32 z = minZ; z <= maxZ; ++z)
+        {
+            for (i32 y = minY; y <= maxY; ++y)
+            {
+                for (i32 x = minX; x <= maxX; ++x)
+                {
+                    mCellEntries.push_back(
+                        CellEntry{.cell = PackCell(x, y, z), .proxy = proxy});
+                }
+            }
+        }
+    }
+
+    std::sort(mCellEntries.begin(), mCellEntries.end(),
+              [](CellEntry const &first, CellEntry const &second) {
+                  return first.cell < second.cell;
+              });
+    mIsGridValid.store(true, std::memory_order_release);
+}
+
+void UniformGridBroadphase::AddPairs(btDispatcher *dispatcher)
+{
+    /* Proxies sharing more than one cell are found more than once, the pair
+     * cache ignores pairs it already has */
+    for (size_t begin = 0; begin < mCellEntries.size();)
+    {
+        size_t end = begin + 1;
+        while (end < mCellEntries.size() &&
+               mCellEntries[end].cell == mCellEntries[begin].cell)
+        {
+            end++;
+        }
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            for (size_t j = i + 1; j < end; ++j)
+            {
+                Proxy *first = mCellEntries[i].proxy;
+                Proxy *second = mCellEntries[j].proxy;
+                if (Overlaps(first, second))
+                {
+                    mPairCache->addOverlappingPair(first, second);
+                }
+            }
+        }
+        begin = end;
+    }
+
+    for (Proxy *large : mLargeProxies)
+    {
+        for (Proxy *proxy : mProxies)
+        {
+            if (proxy != large && Overlaps(large, proxy))
+            {
+                mPairCache->addOverlappingPair(large, proxy);
+            }
+        }
+    }
+}
+
+void UniformGridBroadphase::RemoveStalePairs(btDispatcher *dispatcher)
+{
+    mStalePairs.clear();
+    btBroadphasePairArray &pairs = mPairCache->getOverlappingPairArray();
+    for (i32 i = 0; i < pairs.size(); ++i)
+    {
+        if (!Overlaps(pairs[i].m_pProxy0, pairs[i].m_pProxy1))
+        {
+            mStalePairs.emplace_back(pairs[i].m_pProxy0, pairs[i].m_pProxy1);
+        }
+    }
+
+    /* Removing reorders the pair array */
+    for (auto const &[first, second] : mStalePairs)
+    {
+        mPairCache->removeOverlappingPair(first, second, dispatcher);
+    }
+}
+
+void UniformGridBroadphase::getBroadphaseAabb(btVector3 &aabbMin,
+                                              btVector3 &aabbMax) const
+{
+    /* The grid is unbounded */
+    aabbMin.setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+    aabbMax.setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+}
+
+void UniformGridBroadphase::printStats()
+{
+    SHOWINFO("Uniform grid broadphase: ", mProxies.size(), " proxies, ",
+             mLargeProxies.size(), " outside the grid, ",
+             mPairCache->getNumOverlappingPairs(), " pairs");
+}
+} // namespace Systems
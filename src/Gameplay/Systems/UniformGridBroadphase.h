@@ -0,0 +1,113 @@
+#pragma once
+
+#include "btBulletCollisionCommon.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "PoolAllocator.h"
+
+namespace Systems
+{
+/* Broadphase that buckets the proxies in a uniform grid every step and only
+ * tests the ones sharing a cell. Meant for scenes full of similarly sized
+ * bodies. Proxies spanning too many cells, like the ground, are tested
+ * against everything instead of being put in the grid. Ray and AABB queries
+ * look up the cells they cover in the same grid. */
+class UniformGridBroadphase : public btBroadphaseInterface
+{
+    /* A proxy covering more cells than this isn't put in the grid */
+    static constexpr const u32 MAX_CELLS_PER_PROXY = 64;
+
+    struct Proxy : public btBroadphaseProxy
+    {
+        Proxy(btVector3 const &aabbMin, btVector3 const &aabbMax, void *userPtr,
+              int collisionFilterGroup, int collisionFilterMask)
+            : btBroadphaseProxy(aabbMin, aabbMax, userPtr,
+                                collisionFilterGroup, collisionFilterMask)
+        {
+        }
+
+        /* Position in mProxies */
+        u32 listIndex = 0;
+    };
+
+    struct CellEntry
+    {
+        u64 cell;
+        Proxy *proxy;
+    };
+
+public:
+    UniformGridBroadphase(f32 cellSize);
+    ~UniformGridBroadphase() override;
+
+public:
+    btBroadphaseProxy *createProxy(btVector3 const &aabbMin,
+                                   btVector3 const &aabbMax, int shapeType,
+                                   void *userPtr, int collisionFilterGroup,
+                                   int collisionFilterMask,
+                                   btDispatcher *dispatcher) override;
+    void destroyProxy(btBroadphaseProxy *proxy,
+                      btDispatcher *dispatcher) override;
+    void setAabb(btBroadphaseProxy *proxy, btVector3 const &aabbMin,
+                 btVector3 const &aabbMax, btDispatcher *dispatcher) override;
+    void getAabb(btBroadphaseProxy *proxy, btVector3 &aabbMin,
+                 btVector3 &aabbMax) const override;
+
+    void rayTest(btVector3 const &rayFrom, btVector3 const &rayTo,
+                 btBroadphaseRayCallback &rayCallback,
+                 btVector3 const &aabbMin = btVector3(0, 0, 0),
+                 btVector3 const &aabbMax = btVector3(0, 0, 0)) override;
+    void aabbTest(btVector3 const &aabbMin, btVector3 const &aabbMax,
+                  btBroadphaseAabbCallback &callback) override;
+
+    void calculateOverlappingPairs(btDispatcher *dispatcher) override;
+
+    btOverlappingPairCache *getOverlappingPairCache() override
+    {
+        return mPairCache.get();
+    }
+    btOverlappingPairCache const *getOverlappingPairCache() const override
+    {
+        return mPairCache.get();
+    }
+
+    void getBroadphaseAabb(btVector3 &aabbMin,
+                           btVector3 &aabbMax) const override;
+    void printStats() override;
+
+private:
+    /* Buckets the proxies by their current bounds */
+    void BuildGrid();
+    /* Rebuilds the grid if a proxy changed since it was built. Queries can
+     * come from several threads at once. */
+    void EnsureGrid();
+    /* Calls process once for every proxy overlapping [aabbMin, aabbMax] */
+    template <typename Process>
+    void ForEachOverlappingProxy(btVector3 const &aabbMin,
+                                 btVector3 const &aabbMax, Process &&process);
+
+    void AddPairs(btDispatcher *dispatcher);
+    void RemoveStalePairs(btDispatcher *dispatcher);
+
+private:
+    f32 mInverseCellSize;
+    std::unique_ptr<btHashedOverlappingPairCache> mPairCache;
+
+    PoolAllocator<Proxy> mProxyPool;
+    std::vector<Proxy *> mProxies;
+    i32 mNextUniqueId = 1;
+
+    /* Rebuilt every step, kept around for their memory. The entries are
+     * sorted by cell. */
+    std::vector<CellEntry> mCellEntries;
+    std::vector<Proxy *> mLargeProxies;
+    std::atomic<bool> mIsGridValid = false;
+    std::mutex mGridMutex;
+    std::vector<std::pair<btBroadphaseProxy *, btBroadphaseProxy *>>
+        mStalePairs;
+};
+} // namespace Systems
@@ -2,23 +2,51 @@
 
 #include <entt/entt.hpp>
 
+#include "Gameplay/Components/Base.h"
+#include "Gameplay/Components/InverseWorld.h"
 #include "Gameplay/Components/Update.h"
 
+#include <vector>
+
 namespace Systems
 {
 class UpdateFrame
 {
 public:
+    /**
+     * @brief Listens for Components::Base changes in registry. A single
+     * listener for all the entities, the patched entity is the only one
+     * touched.
+     */
+    void Connect(entt::registry &registry)
+    {
+        registry.on_construct<Components::Base>().connect<&UpdateFrame::OnBaseChanged>();
+        registry.on_update<Components::Base>().connect<&UpdateFrame::OnBaseChanged>();
+    }
+
     void Update(entt::registry &registry)
     {
-        auto updatables = registry.view<Components::Update>();
-        for (auto [entity, update] : updatables.each())
+        auto dirtyEntities = registry.view<Components::Dirty>();
+        for (auto [entity, dirty] : dirtyEntities.each())
         {
-            if (update.dirtyFrames)
+            if (--dirty.dirtyFrames == 0)
             {
-                update.dirtyFrames--;
+                mCleanEntities.push_back(entity);
             }
         }
+
+        registry.remove<Components::Dirty>(mCleanEntities.begin(), mCleanEntities.end());
+        mCleanEntities.clear();
     }
+
+private:
+    static void OnBaseChanged(entt::registry &registry, entt::entity entity)
+    {
+        Components::MarkDirty(registry, entity);
+        Components::InvalidateInverseWorld(registry, entity);
+    }
+
+private:
+    std::vector<entt::entity> mCleanEntities;
 };
 } // namespace Systems
@@ -0,0 +1,394 @@
+#include "Vehicles.h"
+#include "Check.h"
+#include "LinearMath/btThreads.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Systems;
+
+/* Objects the wheel rays of the car being updated can hit, one list per
+ * thread */
+static thread_local std::vector<btCollisionObject *> tCandidates;
+
+template <typename T>
+static void SwapRemove(std::vector<T> &values, u32 index, u32 count = 1)
+{
+    u32 last = (u32)values.size() - count;
+    for (u32 i = 0; i < count; ++i)
+    {
+        values[index + i] = values[last + i];
+    }
+    values.resize(last);
+}
+
+void Vehicles::Add(u32 bodyIndex, btRigidBody *chassis,
+                   VehicleSettings const &settings)
+{
+    if (bodyIndex >= mVehicleByBody.size())
+    {
+        mVehicleByBody.resize(bodyIndex + 1, INVALID_VEHICLE);
+    }
+    CHECK_FATAL(mVehicleByBody[bodyIndex] == INVALID_VEHICLE,
+                "Body ", bodyIndex, " already is a vehicle");
+
+    mVehicleByBody[bodyIndex] = (u32)mChassis.size();
+    mChassis.push_back(chassis);
+    mBodyIndices.push_back(bodyIndex);
+    mSettings.push_back(settings);
+    mThrottle.push_back(0.0f);
+    mBrake.push_back(0.0f);
+    mSteering.push_back(0.0f);
+
+    for (u32 i = 0; i < WHEEL_COUNT; ++i)
+    {
+        mContactPoints.emplace_back(0.0f, 0.0f, 0.0f);
+        mContactNormals.emplace_back(0.0f, 1.0f, 0.0f);
+        mSuspensionLengths.push_back(settings.suspensionRestLength);
+        mSuspensionForces.push_back(0.0f);
+        mIsInContact.push_back(0);
+    }
+
+    /* The suspension keeps a resting car busy, it only sleeps once it
+     * settled */
+    chassis->activate(true);
+}
+
+void Vehicles::Remove(u32 bodyIndex)
+{
+    if (bodyIndex >= mVehicleByBody.size() ||
+        mVehicleByBody[bodyIndex] == INVALID_VEHICLE)
+    {
+        return;
+    }
+
+    u32 index = mVehicleByBody[bodyIndex];
+    mVehicleByBody[bodyIndex] = INVALID_VEHICLE;
+    if (index != mChassis.size() - 1)
+    {
+        mVehicleByBody[mBodyIndices.back()] = index;
+    }
+
+    SwapRemove(mChassis, index);
+    SwapRemove(mBodyIndices, index);
+    SwapRemove(mSettings, index);
+    SwapRemove(mThrottle, index);
+    SwapRemove(mBrake, index);
+    SwapRemove(mSteering, index);
+
+    u32 firstWheel = index * WHEEL_COUNT;
+    SwapRemove(mContactPoints, firstWheel, WHEEL_COUNT);
+    SwapRemove(mContactNormals, firstWheel, WHEEL_COUNT);
+    SwapRemove(mSuspensionLengths, firstWheel, WHEEL_COUNT);
+    SwapRemove(mSuspensionForces, firstWheel, WHEEL_COUNT);
+    SwapRemove(mIsInContact, firstWheel, WHEEL_COUNT);
+}
+
+void Vehicles::SetControls(u32 bodyIndex, f32 throttle, f32 brake,
+                           f32 steering)
+{
+    CHECK_FATAL(bodyIndex < mVehicleByBody.size() &&
+                    mVehicleByBody[bodyIndex] != INVALID_VEHICLE,
+                "Body ", bodyIndex, " is not a vehicle");
+
+    u32 index = mVehicleByBody[bodyIndex];
+    mThrottle[index] = std::clamp(throttle, -1.0f, 1.0f);
+    mBrake[index] = std::clamp(brake, 0.0f, 1.0f);
+    mSteering[index] = std::clamp(steering, -1.0f, 1.0f);
+    mChassis[index]->activate(true);
+}
+
+void Vehicles::updateAction(btCollisionWorld *world, btScalar timeStep)
+{
+    struct UpdateBody : public btIParallelForBody
+    {
+        Vehicles *vehicles;
+        btCollisionWorld *world;
+        btScalar timeStep;
+
+        void forLoop(int begin, int end) const override
+        {
+            for (int i = begin; i < end; ++i)
+            {
+                vehicles->UpdateVehicle(world, (u32)i, timeStep);
+            }
+        }
+    };
+
+    /* A car only pushes its own chassis, so the cars don't depend on each
+     * other within a step */
+    UpdateBody body;
+    body.vehicles = this;
+    body.world = world;
+    body.timeStep = timeStep;
+    if (mIsParallel)
+    {
+        btParallelFor(0, (int)mChassis.size(), VEHICLES_PER_JOB, body);
+    }
+    else
+    {
+        body.forLoop(0, (int)mChassis.size());
+    }
+}
+
+void Vehicles::UpdateVehicle(btCollisionWorld *world, u32 vehicleIndex,
+                             btScalar timeStep)
+{
+    if (!mChassis[vehicleIndex]->isActive())
+    {
+        return;
+    }
+
+    CastWheelRays(world, vehicleIndex);
+    ApplySuspension(vehicleIndex, timeStep);
+    ApplyFriction(vehicleIndex, timeStep);
+}
+
+void Vehicles::CastWheelRays(btCollisionWorld *world, u32 vehicleIndex)
+{
+    struct CandidateCollector : public btBroadphaseAabbCallback
+    {
+        btCollisionObject const *chassis;
+
+        bool process(btBroadphaseProxy const *proxy) override
+        {
+            auto *object =
+                static_cast<btCollisionObject *>(proxy->m_clientObject);
+            if (object != chassis && object->hasContactResponse())
+            {
+                tCandidates.push_back(object);
+            }
+            return true;
+        }
+    };
+
+    btRigidBody const *chassis = mChassis[vehicleIndex];
+    VehicleSettings const &settings = mSettings[vehicleIndex];
+    btTransform const &transform = chassis->getWorldTransform();
+    btVector3 down = -transform.getBasis().getColumn(1);
+    btScalar rayLength = settings.suspensionRestLength + settings.wheelRadius;
+
+    std::array<btVector3, WHEEL_COUNT> rayFrom;
+    std::array<btVector3, WHEEL_COUNT> rayTo;
+    btVector3 aabbMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+    btVector3 aabbMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+    for (u32 i = 0; i < WHEEL_COUNT; ++i)
+    {
+        glm::vec3 const &position = settings.wheelPositions[i];
+        rayFrom[i] = transform(btVector3(position.x, position.y, position.z));
+        rayTo[i] = rayFrom[i] + down * rayLength;
+        aabbMin.setMin(rayFrom[i]);
+        aabbMin.setMin(rayTo[i]);
+        aabbMax.setMax(rayFrom[i]);
+        aabbMax.setMax(rayTo[i]);
+    }
+
+    /* One broadphase query for all of the car's wheels */
+    tCandidates.clear();
+    CandidateCollector collector;
+    collector.chassis = chassis;
+    world->getBroadphase()->aabbTest(aabbMin, aabbMax, collector);
+
+    for (u32 i = 0; i < WHEEL_COUNT; ++i)
+    {
+        u32 wheelIndex = vehicleIndex * WHEEL_COUNT + i;
+        btCollisionWorld::ClosestRayResultCallback callback(rayFrom[i],
+                                                            rayTo[i]);
+
+        btVector3 rayMin = rayFrom[i];
+        btVector3 rayMax = rayFrom[i];
+        rayMin.setMin(rayTo[i]);
+        rayMax.setMax(rayTo[i]);
+
+        btTransform rayFromTransform(btMatrix3x3::getIdentity(), rayFrom[i]);
+        btTransform rayToTransform(btMatrix3x3::getIdentity(), rayTo[i]);
+        for (btCollisionObject *object : tCandidates)
+        {
+            btBroadphaseProxy const *proxy = object->getBroadphaseHandle();
+            if (!TestAabbAgainstAabb2(rayMin, rayMax, proxy->m_aabbMin,
+                                      proxy->m_aabbMax))
+            {
+                continue;
+            }
+            btCollisionWorld::rayTestSingle(
+                rayFromTransform, rayToTransform, object,
+                object->getCollisionShape(), object->getWorldTransform(),
+                callback);
+        }
+
+        if (callback.hasHit())
+        {
+            mIsInContact[wheelIndex] = 1;
+            mContactPoints[wheelIndex] = callback.m_hitPointWorld;
+            mContactNormals[wheelIndex] =
+                callback.m_hitNormalWorld.normalized();
+            mSuspensionLengths[wheelIndex] =
+                callback.m_closestHitFraction * rayLength -
+                settings.wheelRadius;
+        }
+        else
+        {
+            mIsInContact[wheelIndex] = 0;
+            mSuspensionLengths[wheelIndex] = settings.suspensionRestLength;
+        }
+    }
+}
+
+void Vehicles::ApplySuspension(u32 vehicleIndex, btScalar timeStep)
+{
+    btRigidBody *chassis = mChassis[vehicleIndex];
+    VehicleSettings const &settings = mSettings[vehicleIndex];
+    btScalar mass = chassis->getMass();
+
+    for (u32 i = 0; i < WHEEL_COUNT; ++i)
+    {
+        u32 wheelIndex = vehicleIndex * WHEEL_COUNT + i;
+        if (!mIsInContact[wheelIndex])
+        {
+            mSuspensionForces[wheelIndex] = 0.0f;
+            continue;
+        }
+
+        btVector3 const &normal = mContactNormals[wheelIndex];
+        btVector3 relativePosition =
+            mContactPoints[wheelIndex] - chassis->getCenterOfMassPosition();
+        btScalar velocity =
+            normal.dot(chassis->getVelocityInLocalPoint(relativePosition));
+        btScalar compression =
+            settings.suspensionRestLength - mSuspensionLengths[wheelIndex];
+
+        btScalar force = mass * (settings.suspensionStiffness * compression -
+                                 settings.suspensionDamping * velocity);
+        force = std::clamp(force, btScalar(0.0),
+                           btScalar(settings.maxSuspensionForce));
+        mSuspensionForces[wheelIndex] = (f32)force;
+
+        chassis->applyImpulse(normal * force * timeStep, relativePosition);
+    }
+}
+
+void Vehicles::ApplyFriction(u32 vehicleIndex, btScalar timeStep)
+{
+    btRigidBody *chassis = mChassis[vehicleIndex];
+    VehicleSettings const &settings = mSettings[vehicleIndex];
+    btVector3 up = chassis->getWorldTransform().getBasis().getColumn(1);
+
+    u32 firstWheel = vehicleIndex * WHEEL_COUNT;
+    /* The rear wheels on the ground share the engine force */
+    u32 drivenWheelCount = mIsInContact[firstWheel + 2] +
+                           mIsInContact[firstWheel + 3];
+
+    for (u32 i = 0; i < WHEEL_COUNT; ++i)
+    {
+        u32 wheelIndex = firstWheel + i;
+        if (!mIsInContact[wheelIndex])
+        {
+            continue;
+        }
+
+        btVector3 const &contactPoint = mContactPoints[wheelIndex];
+        btVector3 const &normal = mContactNormals[wheelIndex];
+
+        /* Tire axes in the ground's plane */
+        btVector3 forward = GetWheelForward(vehicleIndex, i);
+        forward -= normal * normal.dot(forward);
+        if (forward.fuzzyZero())
+        {
+            continue;
+        }
+        forward.normalize();
+        btVector3 side = normal.cross(forward);
+
+        btVector3 relativePosition =
+            contactPoint - chassis->getCenterOfMassPosition();
+        btVector3 velocity = chassis->getVelocityInLocalPoint(relativePosition);
+
+        /* Cancel the sliding along the axle */
+        btScalar sideImpulse =
+            -side.dot(velocity) /
+            chassis->computeImpulseDenominator(contactPoint, side);
+
+        btScalar forwardImpulse = 0.0f;
+        if (i >= 2 && drivenWheelCount != 0)
+        {
+            forwardImpulse = mThrottle[vehicleIndex] * settings.maxEngineForce /
+                             drivenWheelCount * timeStep;
+        }
+        {
+            /* Braking and rolling resistance can at most stop the wheel */
+            btScalar stoppingImpulse =
+                -forward.dot(velocity) /
+                chassis->computeImpulseDenominator(contactPoint, forward);
+            btScalar maxStoppingImpulse =
+                (mBrake[vehicleIndex] * settings.maxBrakeForce / WHEEL_COUNT +
+                 settings.rollingResistance * mSuspensionForces[wheelIndex]) *
+                timeStep;
+            forwardImpulse += std::clamp(stoppingImpulse, -maxStoppingImpulse,
+                                         maxStoppingImpulse);
+        }
+
+        /* The tire only grips as much as it's pressed into the ground */
+        btScalar maxImpulse = settings.frictionCoefficient *
+                              mSuspensionForces[wheelIndex] * timeStep;
+        btScalar impulse = btSqrt(sideImpulse * sideImpulse +
+                                  forwardImpulse * forwardImpulse);
+        if (impulse > maxImpulse)
+        {
+            btScalar scale = maxImpulse / impulse;
+            sideImpulse *= scale;
+            forwardImpulse *= scale;
+        }
+
+        chassis->applyImpulse(forward * forwardImpulse, relativePosition);
+        /* Pushing sideways closer to the center of mass keeps the chassis
+         * from rolling over */
+        btVector3 sidePosition =
+            relativePosition - up * (up.dot(relativePosition) *
+                                     (1.0f - settings.rollInfluence));
+        chassis->applyImpulse(side * sideImpulse, sidePosition);
+    }
+}
+
+btVector3 Vehicles::GetWheelForward(u32 vehicleIndex, u32 wheel) const
+{
+    btScalar angle = 0.0f;
+    if (wheel < 2)
+    {
+        /* +X is left, so steering right turns towards -X */
+        angle = -mSteering[vehicleIndex] *
+                mSettings[vehicleIndex].maxSteeringAngle;
+    }
+    return mChassis[vehicleIndex]->getWorldTransform().getBasis() *
+           btVector3(btSin(angle), 0.0f, btCos(angle));
+}
+
+void Vehicles::debugDraw(btIDebugDraw *debugDrawer)
+{
+    btVector3 const color(1.0f, 0.6f, 0.0f);
+    for (u32 vehicleIndex = 0; vehicleIndex < mChassis.size(); ++vehicleIndex)
+    {
+        VehicleSettings const &settings = mSettings[vehicleIndex];
+        btTransform const &transform =
+            mChassis[vehicleIndex]->getWorldTransform();
+        btVector3 down = -transform.getBasis().getColumn(1);
+
+        for (u32 i = 0; i < WHEEL_COUNT; ++i)
+        {
+            u32 wheelIndex = vehicleIndex * WHEEL_COUNT + i;
+            glm::vec3 const &position = settings.wheelPositions[i];
+            btVector3 center =
+                transform(btVector3(position.x, position.y, position.z)) +
+                down * mSuspensionLengths[wheelIndex];
+
+            /* Cylinder around the axle, which is the wheel's X */
+            btVector3 forward = GetWheelForward(vehicleIndex, i);
+            btVector3 up = -down;
+            btVector3 axle = up.cross(forward);
+            btMatrix3x3 basis(axle.x(), up.x(), forward.x(), axle.y(), up.y(),
+                              forward.y(), axle.z(), up.z(), forward.z());
+            debugDrawer->drawCylinder(settings.wheelRadius,
+                                      settings.wheelWidth * 0.5f, 0,
+                                      btTransform(basis, center), color);
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "BulletDynamics/Dynamics/btActionInterface.h"
+#include "btBulletDynamicsCommon.h"
+
+#include <array>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Jnrlib.h"
+
+namespace Systems
+{
+/* Chassis space has +Z forward, +Y up and +X to the left. Forces are per
+ * wheel unless stated otherwise. */
+struct VehicleSettings
+{
+    static constexpr const u32 WHEEL_COUNT = 4;
+
+    /* Where the suspension is attached: front left, front right, rear left,
+     * rear right. The front wheels steer, the rear ones are driven. */
+    std::array<glm::vec3, WHEEL_COUNT> wheelPositions = {
+        glm::vec3(0.9f, -0.3f, 1.4f), glm::vec3(-0.9f, -0.3f, 1.4f),
+        glm::vec3(0.9f, -0.3f, -1.4f), glm::vec3(-0.9f, -0.3f, -1.4f)};
+    f32 wheelRadius = 0.4f;
+    f32 wheelWidth = 0.3f;
+
+    f32 suspensionRestLength = 0.5f;
+    /* Per unit of chassis mass */
+    f32 suspensionStiffness = 40.0f;
+    f32 suspensionDamping = 4.0f;
+    f32 maxSuspensionForce = 60000.0f;
+
+    /* Largest tire force as a fraction of the suspension force */
+    f32 frictionCoefficient = 1.5f;
+    f32 rollingResistance = 0.015f;
+    /* Lower keeps the car from rolling over in corners */
+    f32 rollInfluence = 0.1f;
+
+    /* For the whole car */
+    f32 maxEngineForce = 6000.0f;
+    f32 maxBrakeForce = 4000.0f;
+    /* Radians */
+    f32 maxSteeringAngle = 0.5f;
+};
+
+/* Raycast vehicles: every chassis is a rigid body held up by one suspension
+ * ray per wheel. Runs as an action of the Bullet world, so it belongs to the
+ * physics thread and sees every step. Each car queries the broadphase once
+ * for all of its wheels and, in multithreaded worlds, the cars are processed
+ * in parallel through Bullet's task scheduler. The state is kept in arrays
+ * indexed by vehicle, or by vehicle * WHEEL_COUNT + wheel for the wheels. */
+class Vehicles : public btActionInterface
+{
+    static constexpr const u32 WHEEL_COUNT = VehicleSettings::WHEEL_COUNT;
+    static constexpr const u32 INVALID_VEHICLE = (u32)-1;
+    /* Cars per task */
+    static constexpr const i32 VEHICLES_PER_JOB = 4;
+
+public:
+    Vehicles() = default;
+    ~Vehicles() override = default;
+
+    Vehicles(Vehicles const &) = delete;
+    Vehicles &operator=(Vehicles const &) = delete;
+
+public:
+    void Add(u32 bodyIndex, btRigidBody *chassis,
+             VehicleSettings const &settings);
+    /* Does nothing if the body has no vehicle */
+    void Remove(u32 bodyIndex);
+    /* throttle and steering go from -1 to 1, positive steers right, brake
+     * from 0 to 1 */
+    void SetControls(u32 bodyIndex, f32 throttle, f32 brake, f32 steering);
+
+    /* Only worlds that installed a task scheduler should update in parallel,
+     * off by default */
+    void SetParallel(bool isParallel)
+    {
+        mIsParallel = isParallel;
+    }
+
+    u32 GetVehicleCount() const
+    {
+        return (u32)mChassis.size();
+    }
+
+    void updateAction(btCollisionWorld *world, btScalar timeStep) override;
+    void debugDraw(btIDebugDraw *debugDrawer) override;
+
+private:
+    void UpdateVehicle(btCollisionWorld *world, u32 vehicleIndex,
+                       btScalar timeStep);
+    void CastWheelRays(btCollisionWorld *world, u32 vehicleIndex);
+    void ApplySuspension(u32 vehicleIndex, btScalar timeStep);
+    void ApplyFriction(u32 vehicleIndex, btScalar timeStep);
+
+    btVector3 GetWheelForward(u32 vehicleIndex, u32 wheel) const;
+
+private:
+    bool mIsParallel = false;
+
+    /* Indexed by body index */
+    std::vector<u32> mVehicleByBody;
+
+    /* Per vehicle */
+    std::vector<btRigidBody *> mChassis;
+    std::vector<u32> mBodyIndices;
+    std::vector<VehicleSettings> mSettings;
+    std::vector<f32> mThrottle;
+    std::vector<f32> mBrake;
+    std::vector<f32> mSteering;
+
+    /* Per wheel, written by the last step */
+    std::vector<btVector3> mContactPoints;
+    std::vector<btVector3> mContactNormals;
+    std::vector<f32> mSuspensionLengths;
+    std::vector<f32> mSuspensionForces;
+    std::vector<u8> mIsInContact;
+};
+} // namespace Systems
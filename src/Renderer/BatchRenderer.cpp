@@ -1,10 +1,15 @@
 #include "BatchRenderer.h"
 #include "Application.h"
+#include "Check.h"
 #include "Renderer/Vulkan/CommandList.h"
 #include "Renderer/Vulkan/MemoryAllocator.h"
 #include "Utils/Vertex.h"
 #include "vulkan/vulkan_core.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstring>
+#include <glm/gtc/constants.hpp>
 #include <memory>
 
 void BatchRenderer::InitVulkanState()
@@ -19,7 +24,49 @@ void BatchRenderer::InitVulkanState()
 
 void BatchRenderer::OnResize()
 {
-    /* Create simple mPipeline */
+    /* Lines carry their own color, primitives combine the unit mesh's color
+     * with the instance's */
+    {
+        auto attributes = VertexPositionColor::GetInputAttributeDescription();
+        auto bindings = VertexPositionColor::GetInputBindingDescription();
+        BuildPipeline(mPipeline, "color.vert.spv", attributes, bindings);
+    }
+    {
+        std::array<VkVertexInputAttributeDescription, 6> attributes{};
+        auto vertexAttributes =
+            VertexPositionColor::GetInputAttributeDescription();
+        std::copy(vertexAttributes.begin(), vertexAttributes.end(),
+                  attributes.begin());
+        for (u32 i = 0; i < 3; ++i)
+        {
+            attributes[2 + i].binding = 1;
+            attributes[2 + i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attributes[2 + i].location = 2 + i;
+            attributes[2 + i].offset = (u32)(
+                offsetof(DebugPrimitiveInstance, transform) +
+                sizeof(glm::vec4) * i);
+        }
+        attributes[5].binding = 1;
+        attributes[5].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributes[5].location = 5;
+        attributes[5].offset = offsetof(DebugPrimitiveInstance, color);
+
+        std::array<VkVertexInputBindingDescription, 2> bindings{};
+        bindings[0] = VertexPositionColor::GetInputBindingDescription()[0];
+        bindings[1].binding = 1;
+        bindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        bindings[1].stride = sizeof(DebugPrimitiveInstance);
+
+        BuildPipeline(mPrimitivePipeline, "debugprimitive.vert.spv",
+                      attributes, bindings);
+    }
+}
+
+void BatchRenderer::BuildPipeline(
+    Vulkan::Pipeline &pipeline, char const *vertexShader,
+    std::span<VkVertexInputAttributeDescription const> attributes,
+    std::span<VkVertexInputBindingDescription const> bindings)
+{
     glm::vec2 windowDimensions = Application::Get()->GetWindowDimensions();
     VkViewport viewport = {};
     {
@@ -36,27 +83,27 @@ void BatchRenderer::OnResize()
         scissor.extent = {(u32)windowDimensions.x, (u32)windowDimensions.y};
     }
 
-    mPipeline.Clear();
+    pipeline.Clear();
     {
-        mPipeline.SetRootSignature(&mRootSignature);
-        mPipeline.AddShader("color.vert.spv");
-        mPipeline.AddShader("color.frag.spv");
+        pipeline.SetRootSignature(&mRootSignature);
+        pipeline.AddShader(vertexShader);
+        pipeline.AddShader("color.frag.spv");
     }
     {
-        auto &viewportState = mPipeline.GetViewportStateCreateInfo();
+        auto &viewportState = pipeline.GetViewportStateCreateInfo();
         viewportState.viewportCount = 1;
         viewportState.pViewports = &viewport;
         viewportState.scissorCount = 1;
         viewportState.pScissors = &scissor;
     }
     {
-        auto &rasterizationState = mPipeline.GetRasterizationStateCreateInfo();
+        auto &rasterizationState = pipeline.GetRasterizationStateCreateInfo();
         rasterizationState.cullMode = VkCullModeFlagBits::VK_CULL_MODE_NONE;
         rasterizationState.lineWidth = 3.0f;
     }
     VkPipelineColorBlendAttachmentState attachmentInfo{};
     {
-        auto &blendState = mPipeline.GetColorBlendStateCreateInfo();
+        auto &blendState = pipeline.GetColorBlendStateCreateInfo();
         attachmentInfo.blendEnable = VK_FALSE;
         attachmentInfo.colorWriteMask =
             VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
@@ -65,23 +112,15 @@ void BatchRenderer::OnResize()
         blendState.attachmentCount = 1;
         blendState.pAttachments = &attachmentInfo;
     }
-    auto vertexPositionAttributeDescription =
-        VertexPositionColor::GetInputAttributeDescription();
-    auto vertexPositionBindingDescription =
-        VertexPositionColor::GetInputBindingDescription();
     {
-        auto &vertexInput = mPipeline.GetVertexInputStateCreateInfo();
-        vertexInput.vertexAttributeDescriptionCount =
-            (u32)vertexPositionAttributeDescription.size();
-        vertexInput.pVertexAttributeDescriptions =
-            vertexPositionAttributeDescription.data();
-        vertexInput.vertexBindingDescriptionCount =
-            (u32)vertexPositionBindingDescription.size();
-        vertexInput.pVertexBindingDescriptions =
-            vertexPositionBindingDescription.data();
+        auto &vertexInput = pipeline.GetVertexInputStateCreateInfo();
+        vertexInput.vertexAttributeDescriptionCount = (u32)attributes.size();
+        vertexInput.pVertexAttributeDescriptions = attributes.data();
+        vertexInput.vertexBindingDescriptionCount = (u32)bindings.size();
+        vertexInput.pVertexBindingDescriptions = bindings.data();
     }
     {
-        auto &depthState = mPipeline.GetDepthStencilStateCreateInfo();
+        auto &depthState = pipeline.GetDepthStencilStateCreateInfo();
         depthState.depthTestEnable = VK_TRUE;
         depthState.depthWriteEnable = VK_TRUE;
         depthState.depthBoundsTestEnable = VK_TRUE;
@@ -90,55 +129,243 @@ void BatchRenderer::OnResize()
         depthState.minDepthBounds = 0.0f;
         depthState.maxDepthBounds = 1.0f;
     }
-    mPipeline.GetInputAssemblyStateCreateInfo().topology =
+    pipeline.GetInputAssemblyStateCreateInfo().topology =
         VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
 
-    mPipeline.AddBackbufferColorOutput();
-    mPipeline.SetBackbufferDepthStencilOutput();
-    mPipeline.Bake();
+    pipeline.AddBackbufferColorOutput();
+    pipeline.SetBackbufferDepthStencilOutput();
+    pipeline.Bake();
 }
 
-void BatchRenderer::Resize(u32 newCount)
+static void AddCircle(std::vector<VertexPositionColor> &vertices,
+                      glm::vec3 const &axisX, glm::vec3 const &axisY,
+                      u32 segmentCount, f32 arc)
 {
-    auto newBuffer =
-        Vulkan::Buffer(sizeof(VertexPositionColor), newCount,
+    glm::vec4 white(1.0f);
+    for (u32 i = 0; i < segmentCount; ++i)
+    {
+        f32 angle = arc * (f32)i / (f32)segmentCount;
+        f32 nextAngle = arc * (f32)(i + 1) / (f32)segmentCount;
+        vertices.emplace_back(
+            axisX * std::cos(angle) + axisY * std::sin(angle), white);
+        vertices.emplace_back(
+            axisX * std::cos(nextAngle) + axisY * std::sin(nextAngle), white);
+    }
+}
+
+void BatchRenderer::InitUnitMeshes()
+{
+    constexpr f32 TWO_PI = glm::two_pi<f32>();
+    constexpr f32 PI = glm::pi<f32>();
+    glm::vec3 const x(1.0f, 0.0f, 0.0f);
+    glm::vec3 const y(0.0f, 1.0f, 0.0f);
+    glm::vec3 const z(0.0f, 0.0f, 1.0f);
+    glm::vec4 const white(1.0f);
+
+    std::vector<VertexPositionColor> vertices;
+    auto addLine = [&](glm::vec3 const &from, glm::vec3 const &to,
+                       glm::vec4 const &color) {
+        vertices.emplace_back(from, color);
+        vertices.emplace_back(to, color);
+    };
+    auto beginMesh = [&](DebugPrimitive primitive) {
+        mUnitMeshes[(u32)primitive].firstVertex = (u32)vertices.size();
+    };
+    auto endMesh = [&](DebugPrimitive primitive) {
+        auto &mesh = mUnitMeshes[(u32)primitive];
+        mesh.vertexCount = (u32)vertices.size() - mesh.firstVertex;
+    };
+
+    beginMesh(DebugPrimitive::Box);
+    for (u32 axis = 0; axis < 3; ++axis)
+    {
+        /* 4 edges parallel to every axis */
+        u32 u = (axis + 1) % 3;
+        u32 v = (axis + 2) % 3;
+        for (f32 su : {-1.0f, 1.0f})
+        {
+            for (f32 sv : {-1.0f, 1.0f})
+            {
+                glm::vec3 from(0.0f);
+                from[axis] = -1.0f;
+                from[u] = su;
+                from[v] = sv;
+                glm::vec3 to = from;
+                to[axis] = 1.0f;
+                addLine(from, to, white);
+            }
+        }
+    }
+    endMesh(DebugPrimitive::Box);
+
+    beginMesh(DebugPrimitive::Sphere);
+    AddCircle(vertices, x, y, CIRCLE_SEGMENTS, TWO_PI);
+    AddCircle(vertices, y, z, CIRCLE_SEGMENTS, TWO_PI);
+    AddCircle(vertices, z, x, CIRCLE_SEGMENTS, TWO_PI);
+    endMesh(DebugPrimitive::Sphere);
+
+    beginMesh(DebugPrimitive::Hemisphere);
+    AddCircle(vertices, z, x, CIRCLE_SEGMENTS, TWO_PI);
+    AddCircle(vertices, x, y, CIRCLE_SEGMENTS / 2, PI);
+    AddCircle(vertices, z, y, CIRCLE_SEGMENTS / 2, PI);
+    endMesh(DebugPrimitive::Hemisphere);
+
+    beginMesh(DebugPrimitive::Cylinder);
+    {
+        u32 firstRing = (u32)vertices.size();
+        AddCircle(vertices, z, x, CIRCLE_SEGMENTS, TWO_PI);
+        u32 ringEnd = (u32)vertices.size();
+        for (u32 i = firstRing; i < ringEnd; ++i)
+        {
+            VertexPositionColor top = vertices[i];
+            vertices[i].position.y = -1.0f;
+            top.position.y = 1.0f;
+            vertices.push_back(top);
+        }
+        for (glm::vec3 side : {x, -x, z, -z})
+        {
+            addLine(side - y, side + y, white);
+        }
+    }
+    endMesh(DebugPrimitive::Cylinder);
+
+    beginMesh(DebugPrimitive::Arrow);
+    addLine(glm::vec3(0.0f), y, white);
+    for (glm::vec3 side : {x, -x, z, -z})
+    {
+        addLine(y, y * 0.8f + side * 0.1f, white);
+    }
+    endMesh(DebugPrimitive::Arrow);
+
+    beginMesh(DebugPrimitive::Axes);
+    addLine(glm::vec3(0.0f), x, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+    addLine(glm::vec3(0.0f), y, glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
+    addLine(glm::vec3(0.0f), z, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+    endMesh(DebugPrimitive::Axes);
+
+    mUnitMeshBuffer =
+        Vulkan::Buffer(sizeof(VertexPositionColor), vertices.size(),
                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-    if (mVertexBuffer.GetCount())
+    mUnitMeshBuffer.Copy(vertices.data());
+}
+
+/* The whole buffer gets rewritten after this, so the old contents aren't
+ * copied over when it grows */
+static void ReserveBuffer(Vulkan::Buffer &buffer, u64 elementSize, u64 count,
+                          u64 initialCount)
+{
+    if (buffer.GetCount() >= count)
+    {
+        return;
+    }
+
+    u64 newCount = std::max<u64>(buffer.GetCount(), initialCount);
+    while (newCount < count)
     {
-        for (u32 i = 0; i < mVertexBuffer.GetCount(); ++i)
+        newCount *= 2;
+    }
+    buffer = Vulkan::Buffer(
+        elementSize, newCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+}
+
+void BatchRenderer::Upload(PerFrameResource &resource)
+{
+    ReserveBuffer(resource.vertexBuffer, sizeof(VertexPositionColor),
+                  mVertices.size(), INITIAL_VERTEX_COUNT);
+    if (!mVertices.empty())
+    {
+        memcpy(resource.vertexBuffer.GetData(), mVertices.data(),
+               mVertices.size() * sizeof(VertexPositionColor));
+    }
+
+    u64 instanceCount = 0;
+    for (auto const &instances : mInstances)
+    {
+        instanceCount += instances.size();
+    }
+    ReserveBuffer(resource.instanceBuffer, sizeof(DebugPrimitiveInstance),
+                  instanceCount, INITIAL_INSTANCE_COUNT);
+    u64 firstInstance = 0;
+    for (auto const &instances : mInstances)
+    {
+        if (!instances.empty())
         {
-            auto dst = newBuffer.GetElement(i);
-            auto src = mVertexBuffer.GetElement(i);
-            memcpy(dst, src, mVertexBuffer.GetElementSize());
+            memcpy(resource.instanceBuffer.GetElement((u32)firstInstance),
+                   instances.data(),
+                   instances.size() * sizeof(DebugPrimitiveInstance));
+            firstInstance += instances.size();
         }
     }
-    mVertexBuffer = std::move(newBuffer);
+
+    resource.version = mVersion;
 }
 
-void BatchRenderer::Render(Vulkan::CommandList &cmdList, Camera const &camera)
+void BatchRenderer::Render(Vulkan::CommandList &cmdList, u32 currentFrameIndex,
+                           Camera const &camera)
 {
+    auto &resource = mPerFrameResources[currentFrameIndex];
+    if (resource.version != mVersion)
+    {
+        Upload(resource);
+    }
+
     auto viewProj = camera.GetProjection() * camera.GetView();
 
-    cmdList.BindPipeline(mPipeline);
-    cmdList.BindVertexBuffer(mVertexBuffer, 0);
-    cmdList.BindPushRange<glm::mat4x4>(mRootSignature, 0, 1, &viewProj);
-    cmdList.Draw(mVertexCount, 0);
+    if (!mVertices.empty())
+    {
+        cmdList.BindPipeline(mPipeline);
+        cmdList.BindVertexBuffer(resource.vertexBuffer, 0);
+        cmdList.BindPushRange<glm::mat4x4>(mRootSignature, 0, 1, &viewProj);
+        cmdList.Draw((u32)mVertices.size(), 0);
+    }
 
-    Clear();
+    bool isPipelineBound = false;
+    u32 firstInstance = 0;
+    for (u32 i = 0; i < PRIMITIVE_COUNT; ++i)
+    {
+        u32 instanceCount = (u32)mInstances[i].size();
+        if (instanceCount == 0)
+        {
+            continue;
+        }
+
+        if (!isPipelineBound)
+        {
+            cmdList.BindPipeline(mPrimitivePipeline);
+            cmdList.BindVertexBuffer(mUnitMeshBuffer, 0);
+            cmdList.BindVertexBuffer(resource.instanceBuffer, 1);
+            cmdList.BindPushRange<glm::mat4x4>(mRootSignature, 0, 1,
+                                               &viewProj);
+            isPipelineBound = true;
+        }
+        cmdList.DrawInstanced(mUnitMeshes[i].vertexCount, instanceCount,
+                              mUnitMeshes[i].firstVertex, firstInstance);
+        firstInstance += instanceCount;
+    }
 }
 
 void BatchRenderer::AddVertex(VertexPositionColor const &vertex)
 {
-    if (mVertexCount > mVertexBuffer.GetCount())
-    {
-        Resize(mVertexBuffer.GetCount() * 2);
-        AddVertex(vertex);
-        return;
-    }
+    mVertices.push_back(vertex);
+    mVersion++;
+}
 
-    auto *element =
-        (VertexPositionColor *)mVertexBuffer.GetElement(mVertexCount);
-    *element = vertex;
-    mVertexCount++;
+void BatchRenderer::AddLines(std::span<VertexPositionColor const> vertices)
+{
+    CHECK_FATAL(vertices.size() % 2 == 0,
+                "Lines need an even number of vertices, got ",
+                vertices.size());
+    mVertices.insert(mVertices.end(), vertices.begin(), vertices.end());
+    mVersion++;
+}
+
+void BatchRenderer::AddPrimitives(
+    DebugPrimitive primitive, std::span<DebugPrimitiveInstance const> instances)
+{
+    auto &primitiveInstances = mInstances[(u32)primitive];
+    primitiveInstances.insert(primitiveInstances.end(), instances.begin(),
+                              instances.end());
+    mVersion++;
 }
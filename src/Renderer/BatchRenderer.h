@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Jnrlib.h"
+#include "Utils/Constants.h"
 #include "Utils/Vertex.h"
 
 #include "Renderer/Vulkan/Buffer.h"
@@ -9,13 +10,83 @@
 
 #include "Gameplay/Camera.h"
 
+#include <array>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+/* Wireframe unit meshes drawn instanced, see BatchRenderer::InitUnitMeshes
+ * for their exact shape */
+enum class DebugPrimitive
+{
+    /* [-1, 1] on every axis */
+    Box,
+    /* Radius 1 */
+    Sphere,
+    /* Upper half of the sphere */
+    Hemisphere,
+    /* Radius 1, from y = -1 to y = 1 */
+    Cylinder,
+    /* From the origin to (0, 1, 0) */
+    Arrow,
+    /* Unit X, Y and Z axes in red, green and blue */
+    Axes,
+
+    Count,
+};
+
+struct DebugPrimitiveInstance
+{
+    /* Rows of the affine object to world transform of the unit mesh */
+    std::array<glm::vec4, 3> transform;
+    /* Multiplied with the mesh's own color */
+    glm::vec4 color;
+
+    DebugPrimitiveInstance() = default;
+    DebugPrimitiveInstance(glm::mat4x4 const &world, glm::vec4 const &color)
+        : transform{glm::vec4(world[0][0], world[1][0], world[2][0],
+                              world[3][0]),
+                    glm::vec4(world[0][1], world[1][1], world[2][1],
+                              world[3][1]),
+                    glm::vec4(world[0][2], world[1][2], world[2][2],
+                              world[3][2])},
+          color(color) {};
+};
+
+/* Lines and primitives are collected on the CPU and stay until Clear, so
+ * producers slower than the frame rate don't flicker. Every frame in flight
+ * draws from its own buffers, refreshed only when something changed since
+ * that frame last used them. */
 class BatchRenderer
 {
+    static constexpr const u32 INITIAL_VERTEX_COUNT = 1024;
+    static constexpr const u32 INITIAL_INSTANCE_COUNT = 256;
+    static constexpr const u32 CIRCLE_SEGMENTS = 24;
+    static constexpr const u32 PRIMITIVE_COUNT = (u32)DebugPrimitive::Count;
+
+    struct PerFrameResource
+    {
+        Vulkan::Buffer vertexBuffer;
+        /* Instances of every primitive, one after the other */
+        Vulkan::Buffer instanceBuffer;
+        /* Of the contents of both buffers */
+        u64 version = 0;
+    };
+
+    struct UnitMesh
+    {
+        u32 firstVertex;
+        u32 vertexCount;
+    };
+
 public:
-    BatchRenderer() : mPipeline("BatchRendererPipeline")
+    BatchRenderer()
+        : mPipeline("BatchRendererPipeline"),
+          mPrimitivePipeline("BatchRendererPrimitivePipeline")
     {
         InitVulkanState();
-        Resize(1024);
+        InitUnitMeshes();
+        mVertices.reserve(INITIAL_VERTEX_COUNT);
     };
 
     ~BatchRenderer() = default;
@@ -23,20 +94,49 @@ public:
 public:
     void Clear()
     {
-        mVertexCount = 0;
+        mVertices.clear();
+        for (auto &instances : mInstances)
+        {
+            instances.clear();
+        }
+        mVersion++;
     }
-    void Render(Vulkan::CommandList &cmdList, Camera const &camera);
+    /* Must be called after the frame's previous use of currentFrameIndex
+     * finished on the GPU */
+    void Render(Vulkan::CommandList &cmdList, u32 currentFrameIndex,
+                Camera const &camera);
     void AddVertex(VertexPositionColor const &vertex);
+    /* Every two vertices make a line */
+    void AddLines(std::span<VertexPositionColor const> vertices);
+    void AddPrimitives(DebugPrimitive primitive,
+                       std::span<DebugPrimitiveInstance const> instances);
 
     void OnResize();
 
 private:
     void InitVulkanState();
-    void Resize(u32 newCount);
+    void InitUnitMeshes();
+    void BuildPipeline(
+        Vulkan::Pipeline &pipeline, char const *vertexShader,
+        std::span<VkVertexInputAttributeDescription const> attributes,
+        std::span<VkVertexInputBindingDescription const> bindings);
+    void Upload(PerFrameResource &resource);
 
 private:
-    u32 mVertexCount = 0;
-    Vulkan::Buffer mVertexBuffer;
+    std::vector<VertexPositionColor> mVertices;
+    std::array<std::vector<DebugPrimitiveInstance>, PRIMITIVE_COUNT>
+        mInstances;
+    /* Bumped whenever the lines or instances change, starts ahead of the
+     * frames so they upload the first time */
+    u64 mVersion = 1;
+
+    /* Line lists of every primitive, never written after creation */
+    Vulkan::Buffer mUnitMeshBuffer;
+    std::array<UnitMesh, PRIMITIVE_COUNT> mUnitMeshes;
+
+    std::array<PerFrameResource, Constants::MAX_IN_FLIGHT_FRAMES>
+        mPerFrameResources;
     Vulkan::Pipeline mPipeline;
+    Vulkan::Pipeline mPrimitivePipeline;
     Vulkan::RootSignature mRootSignature;
 };
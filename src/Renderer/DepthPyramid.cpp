@@ -0,0 +1,170 @@
+#include "DepthPyramid.h"
+
+#include "Renderer/Vulkan/Renderer.h"
+
+#include <algorithm>
+#include <bit>
+
+DepthPyramid::DepthPyramid() : mPipeline("DepthPyramidPipeline")
+{
+    auto renderer = Vulkan::Renderer::Get();
+
+    VkSamplerCreateInfo samplerInfo = {};
+    {
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        samplerInfo.mipLodBias = 0.0f;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    }
+    vkThrowIfFailed(jnrCreateSampler(renderer->GetDevice(), &samplerInfo, nullptr, &mSampler));
+
+    {
+        mDescriptorSet.AddCombinedImageSampler(0, nullptr, VK_SHADER_STAGE_COMPUTE_BIT);
+        mDescriptorSet.AddStorageImage(1, VK_SHADER_STAGE_COMPUTE_BIT);
+        mDescriptorSet.AddStorageImage(2, VK_SHADER_STAGE_COMPUTE_BIT);
+        mDescriptorSet.Bake(MAX_MIP_LEVELS);
+    }
+    {
+        mRootSignature.AddPushRange<PushConstant>(0, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        mRootSignature.AddDescriptorSet(&mDescriptorSet);
+    }
+    mRootSignature.Bake();
+
+    mPipeline.SetRootSignature(&mRootSignature);
+    mPipeline.SetShader("depthpyramid.comp.spv");
+    mPipeline.Bake();
+}
+
+DepthPyramid::~DepthPyramid()
+{
+    if (mSampler != VK_NULL_HANDLE)
+    {
+        jnrDestroySampler(Vulkan::Renderer::Get()->GetDevice(), mSampler, nullptr);
+    }
+}
+
+void DepthPyramid::OnResize(Vulkan::Image &depthImage)
+{
+    auto depthExtent = depthImage.GetExtent2D();
+    mDepthWidth = depthExtent.width;
+    mDepthHeight = depthExtent.height;
+    mWidth = std::bit_floor(mDepthWidth);
+    mHeight = std::bit_floor(mDepthHeight);
+    mMipLevels = std::bit_width(std::max(mWidth, mHeight));
+    CHECK_FATAL(mMipLevels <= MAX_MIP_LEVELS, "Depth image is too big for the depth pyramid");
+
+    Vulkan::Image::Info2D pyramidInfo;
+    {
+        pyramidInfo.width = mWidth;
+        pyramidInfo.height = mHeight;
+        pyramidInfo.mipLevels = mMipLevels;
+        pyramidInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        pyramidInfo.format = VK_FORMAT_R32_SFLOAT;
+        pyramidInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    mPyramid = Vulkan::Image(pyramidInfo);
+
+    /* The depth image is read only while the pyramid is being built */
+    auto depthView = depthImage.GetImageView(VK_IMAGE_ASPECT_DEPTH_BIT);
+    depthView.SetLayout(VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+    auto pointSampler = Vulkan::Renderer::Get()->GetPointSampler();
+    for (u32 mip = 0; mip < mMipLevels; ++mip)
+    {
+        mDescriptorSet.SetActiveInstance(mip);
+        mDescriptorSet.BindCombinedImageSampler(0, depthView, VK_IMAGE_ASPECT_DEPTH_BIT, pointSampler);
+        /* The first level doesn't read the source, but every binding must be valid */
+        mDescriptorSet.BindStorageImage(1, mPyramid.GetImageView(VK_IMAGE_ASPECT_COLOR_BIT, mip == 0 ? 0 : mip - 1));
+        mDescriptorSet.BindStorageImage(2, mPyramid.GetImageView(VK_IMAGE_ASPECT_COLOR_BIT, mip));
+    }
+
+    mIsValid = false;
+}
+
+void DepthPyramid::Build(Vulkan::CommandList &cmdList, Vulkan::Image &depthImage)
+{
+    {
+        Vulkan::CommandList::TransitionInfo ti{};
+        {
+            ti.newLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL;
+            ti.srcStage = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            ti.dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            ti.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            ti.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+        cmdList.TransitionImageTo(&depthImage, ti);
+    }
+    {
+        Vulkan::CommandList::TransitionInfo ti{};
+        {
+            ti.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            ti.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            ti.dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            ti.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        }
+        cmdList.TransitionImageTo(&mPyramid, ti);
+    }
+    /* The culling pass of this frame may still be reading the previous pyramid */
+    cmdList.ImageBarrier(mPyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+    cmdList.BindPipeline(mPipeline);
+
+    glm::uvec2 sourceSize = {mDepthWidth, mDepthHeight};
+    for (u32 mip = 0; mip < mMipLevels; ++mip)
+    {
+        glm::uvec2 destinationSize = {std::max(mWidth >> mip, 1u), std::max(mHeight >> mip, 1u)};
+
+        PushConstant pushConstant{
+            .sourceSize = sourceSize, .destinationSize = destinationSize, .fromDepth = mip == 0 ? 1u : 0u};
+        cmdList.BindDescriptorSet(mDescriptorSet, mip, mRootSignature, VK_PIPELINE_BIND_POINT_COMPUTE);
+        cmdList.BindPushRange<PushConstant>(mRootSignature, 0, 1, &pushConstant, VK_SHADER_STAGE_COMPUTE_BIT);
+        cmdList.Dispatch((destinationSize.x + GROUP_SIZE - 1) / GROUP_SIZE,
+                         (destinationSize.y + GROUP_SIZE - 1) / GROUP_SIZE);
+
+        cmdList.ImageBarrier(mPyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+        sourceSize = destinationSize;
+    }
+
+    /* Give the depth image back to the rasterizer */
+    {
+        Vulkan::CommandList::TransitionInfo ti{};
+        {
+            ti.newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+            ti.srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            ti.dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            ti.srcAccessMask = 0;
+            ti.dstAccessMask =
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        }
+        cmdList.TransitionImageTo(&depthImage, ti);
+    }
+
+    mIsValid = true;
+}
+
+void DepthPyramid::PrepareForReading(Vulkan::CommandList &cmdList)
+{
+    {
+        Vulkan::CommandList::TransitionInfo ti{};
+        {
+            ti.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            ti.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            ti.dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            ti.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+        cmdList.TransitionImageTo(&mPyramid, ti);
+    }
+    /* Written by the previous frame */
+    cmdList.ImageBarrier(mPyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Jnrlib.h"
+
+#include "Renderer/Vulkan/CommandList.h"
+#include "Renderer/Vulkan/Image.h"
+#include "Renderer/Vulkan/Pipeline.h"
+#include "Renderer/Vulkan/RootSignature.h"
+
+#include <glm/glm.hpp>
+
+/* Hierarchical depth buffer used for occlusion culling. Every texel holds the
+ * farthest depth of the area it covers, so anything whose nearest depth is
+ * behind it is hidden. The first level is the depth image size rounded down to
+ * a power of two, which keeps every following level an exact 2x reduction. */
+class DepthPyramid
+{
+public:
+    DepthPyramid();
+    ~DepthPyramid();
+
+    DepthPyramid(const DepthPyramid &) = delete;
+    DepthPyramid(DepthPyramid &&) = delete;
+    DepthPyramid &operator=(const DepthPyramid &) = delete;
+    DepthPyramid &operator=(DepthPyramid &&) = delete;
+
+public:
+    /**
+     * @brief Recreates the pyramid for depthImage. The previous contents are
+     * lost, so it becomes valid again only after the next Build.
+     */
+    void OnResize(Vulkan::Image &depthImage);
+
+    /**
+     * @brief Downsamples depthImage into every level of the pyramid. Must be
+     * called outside of a rendering scope, depthImage is left as a depth
+     * attachment.
+     */
+    void Build(Vulkan::CommandList &cmdList, Vulkan::Image &depthImage);
+
+    /**
+     * @brief Makes the last built pyramid visible to compute shaders
+     */
+    void PrepareForReading(Vulkan::CommandList &cmdList);
+
+public:
+    Vulkan::Image &GetImage()
+    {
+        return mPyramid;
+    }
+
+    /* Nearest filtering, normalized coordinates and access to every level */
+    VkSampler GetSampler() const
+    {
+        return mSampler;
+    }
+
+    glm::uvec2 GetSize() const
+    {
+        return {mWidth, mHeight};
+    }
+
+    u32 GetMipLevels() const
+    {
+        return mMipLevels;
+    }
+
+    /* False until the pyramid was built at least once at the current size */
+    bool IsValid() const
+    {
+        return mIsValid;
+    }
+
+private:
+    struct PushConstant
+    {
+        glm::uvec2 sourceSize;
+        glm::uvec2 destinationSize;
+        u32 fromDepth;
+    };
+
+    /* Enough for a 65536x65536 depth image */
+    static constexpr const u32 MAX_MIP_LEVELS = 16;
+    static constexpr const u32 GROUP_SIZE = 8;
+
+private:
+    Vulkan::ComputePipeline mPipeline;
+    Vulkan::RootSignature mRootSignature;
+    /* One instance for each level */
+    Vulkan::DescriptorSet mDescriptorSet;
+
+    Vulkan::Image mPyramid;
+    VkSampler mSampler = VK_NULL_HANDLE;
+
+    u32 mWidth = 0;
+    u32 mHeight = 0;
+    u32 mMipLevels = 0;
+    u32 mDepthWidth = 0;
+    u32 mDepthHeight = 0;
+
+    bool mIsValid = false;
+};
@@ -6,9 +6,47 @@
 struct BasicPerObjectInfo
 {
     glm::mat4 world;
+    /* Dequantization parameters of the mesh, see VertexPositionNormalPacked */
+    glm::vec4 positionScale;
+    glm::vec4 positionOffset;
 };
 
-struct BasicPushConstant
+/* Per object input of cull.comp, indexed the same way as BasicPerObjectInfo */
+struct GPUCullingObjectInfo
 {
-    u32 objectIndex;
+    /* Object space bounds */
+    glm::vec4 boundsCenter;
+    glm::vec4 boundsExtents;
+
+    glm::uvec4 lodFirstIndex;
+    glm::uvec4 lodIndexCount;
+    glm::vec4 lodError;
+    u32 lodCount;
+
+    u32 firstVertex;
+    u32 use32BitIndices;
+    /* Slots without an entity are skipped */
+    u32 isValid;
+};
+
+struct GPUCullingFrameInfo
+{
+    glm::vec4 frustumPlanes[6];
+    glm::mat4 view;
+    glm::mat4 viewProjection;
+    /* The depth pyramid tested by the early pass was rendered from this one */
+    glm::mat4 previousViewProjection;
+    /* x = pixels per world unit at distance 1, y = LOD error threshold in pixels */
+    glm::vec4 lodParameters;
+    /* xy = size of the first level, z = level count, w = 1 if the pyramid can be used */
+    glm::vec4 depthPyramidParameters;
+};
+
+struct GPUCullingPushConstant
+{
+    u32 objectCount;
+    /* Size of each of the draw regions (16-bit and 32-bit indices for each pass) */
+    u32 maxDrawCount;
+    /* 0 = early pass, 1 = late pass (see Systems::GPUCulling::Pass) */
+    u32 pass;
 };
@@ -162,11 +162,104 @@ void CommandList::Draw(u32 vertexCount, u32 firstVertex)
                firstVertex, 0);
 }
 
+void CommandList::DrawInstanced(u32 vertexCount, u32 instanceCount,
+                                u32 firstVertex, u32 firstInstance)
+{
+    jnrCmdDraw(mCommandBuffers[mActiveCommandIndex], vertexCount,
+               instanceCount, firstVertex, firstInstance);
+}
+
 void Vulkan::CommandList::DrawIndexedInstanced(u32 indexCount, u32 firstIndex,
-                                               u32 vertexOffset)
+                                               u32 vertexOffset,
+                                               u32 firstInstance)
 {
     jnrCmdDrawIndexed(mCommandBuffers[mActiveCommandIndex], indexCount, 1,
-                      firstIndex, vertexOffset, 0);
+                      firstIndex, vertexOffset, firstInstance);
+}
+
+void CommandList::DrawIndexedIndirectCount(Vulkan::Buffer const &commandBuffer,
+                                           u64 commandOffset,
+                                           Vulkan::Buffer const &countBuffer,
+                                           u64 countOffset, u32 maxDrawCount)
+{
+    jnrCmdDrawIndexedIndirectCount(
+        mCommandBuffers[mActiveCommandIndex], commandBuffer.mBuffer,
+        commandOffset, countBuffer.mBuffer, countOffset, maxDrawCount,
+        sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void CommandList::Dispatch(u32 groupCountX, u32 groupCountY, u32 groupCountZ)
+{
+    jnrCmdDispatch(mCommandBuffers[mActiveCommandIndex], groupCountX,
+                   groupCountY, groupCountZ);
+}
+
+void CommandList::DispatchIndirect(Vulkan::Buffer const &buffer, u64 offset)
+{
+    jnrCmdDispatchIndirect(mCommandBuffers[mActiveCommandIndex],
+                           buffer.mBuffer, offset);
+}
+
+void CommandList::FillBuffer(Vulkan::Buffer &buffer, u32 value)
+{
+    jnrCmdFillBuffer(mCommandBuffers[mActiveCommandIndex], buffer.mBuffer, 0,
+                     VK_WHOLE_SIZE, value);
+}
+
+void CommandList::BufferBarrier(Vulkan::Buffer const &buffer,
+                                VkPipelineStageFlags srcStage,
+                                VkPipelineStageFlags dstStage,
+                                VkAccessFlags srcAccessMask,
+                                VkAccessFlags dstAccessMask)
+{
+    VkBufferMemoryBarrier bufferMemoryBarrier{};
+    {
+        bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferMemoryBarrier.srcAccessMask = srcAccessMask;
+        bufferMemoryBarrier.dstAccessMask = dstAccessMask;
+        bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferMemoryBarrier.buffer = buffer.mBuffer;
+        bufferMemoryBarrier.offset = 0;
+        bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+    }
+
+    jnrCmdPipelineBarrier(mCommandBuffers[mActiveCommandIndex], srcStage,
+                          dstStage, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0,
+                          nullptr);
+}
+
+void CommandList::ImageBarrier(Image const &image,
+                               VkPipelineStageFlags srcStage,
+                               VkPipelineStageFlags dstStage,
+                               VkAccessFlags srcAccessMask,
+                               VkAccessFlags dstAccessMask)
+{
+    VkImageLayout layout = mLayoutTracker.GetImageLayout(
+        const_cast<Image &>(image));
+    VkImageMemoryBarrier imageMemoryBarrier{};
+    {
+        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageMemoryBarrier.srcAccessMask = srcAccessMask;
+        imageMemoryBarrier.dstAccessMask = dstAccessMask;
+        imageMemoryBarrier.oldLayout = layout;
+        imageMemoryBarrier.newLayout = layout;
+        imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageMemoryBarrier.image = image.mImage;
+
+        imageMemoryBarrier.subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = image.mCreateInfo.mipLevels,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        };
+    }
+
+    jnrCmdPipelineBarrier(mCommandBuffers[mActiveCommandIndex], srcStage,
+                          dstStage, 0, 0, nullptr, 0, nullptr, 1,
+                          &imageMemoryBarrier);
 }
 
 void CommandList::BindPipeline(Pipeline &pipeline)
@@ -175,23 +268,30 @@ void CommandList::BindPipeline(Pipeline &pipeline)
                        VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.mPipeline);
 }
 
+void CommandList::BindPipeline(ComputePipeline &pipeline)
+{
+    jnrCmdBindPipeline(mCommandBuffers[mActiveCommandIndex],
+                       VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.mPipeline);
+}
+
 void CommandList::BindDescriptorSet(DescriptorSet &set,
                                     u32 descriptorSetInstance,
-                                    RootSignature &rootSignature)
+                                    RootSignature &rootSignature,
+                                    VkPipelineBindPoint bindPoint)
 {
-    jnrCmdBindDescriptorSets(
-        mCommandBuffers[mActiveCommandIndex], VK_PIPELINE_BIND_POINT_GRAPHICS,
-        rootSignature.mPipelineLayout, 0, 1,
-        &set.mDescriptorSets[descriptorSetInstance], 0, nullptr);
+    jnrCmdBindDescriptorSets(mCommandBuffers[mActiveCommandIndex], bindPoint,
+                             rootSignature.mPipelineLayout, 0, 1,
+                             &set.mDescriptorSets[descriptorSetInstance], 0,
+                             nullptr);
 }
 
-void CommandList::SetScissor(std::vector<VkRect2D> const &scissors)
+void CommandList::SetScissor(std::span<VkRect2D const> scissors)
 {
     jnrCmdSetScissor(mCommandBuffers[mActiveCommandIndex], 0,
                      (u32)scissors.size(), scissors.data());
 }
 
-void CommandList::SetViewports(std::vector<VkViewport> const &viewports)
+void CommandList::SetViewports(std::span<VkViewport const> viewports)
 {
     jnrCmdSetViewport(mCommandBuffers[mActiveCommandIndex], 0,
                       (u32)viewports.size(), viewports.data());
@@ -236,7 +336,8 @@ void CommandList::TransitionImageTo(Image *img,
                                     TransitionInfo const &transitionInfo)
 {
     VkImageAspectFlags aspectMask = 0;
-    if (transitionInfo.newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL)
+    if (transitionInfo.newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL ||
+        transitionInfo.newLayout == VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL)
     {
         aspectMask |= VK_IMAGE_ASPECT_DEPTH_BIT;
     }
@@ -262,7 +363,7 @@ void CommandList::TransitionImageTo(Image *img,
         imageMemoryBarrier.subresourceRange = {
             .aspectMask = aspectMask,
             .baseMipLevel = 0,
-            .levelCount = 1,
+            .levelCount = img->mCreateInfo.mipLevels,
             .baseArrayLayer = 0,
             .layerCount = 1,
         };
@@ -297,7 +398,8 @@ void CommandList::CopyWholeBufferToImage(Image *image, Buffer *buffer)
     VkImageAspectFlags imageAspectFlags = 0;
     for (auto const &[key, value] : image->mImageViews)
     {
-        imageAspectFlags |= key;
+        /* The lower half of the key holds the aspect */
+        imageAspectFlags |= (VkImageAspectFlags)key;
     }
     VkImageSubresourceLayers imageLayers = {};
     {
@@ -431,7 +533,8 @@ void CommandList::BeginRenderingOnBackbuffer(float const backgroundColor[4],
                        : VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
         depthAttachment.imageView = depthImageView.GetView();
         depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        /* Kept around for building the depth pyramid */
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         depthAttachment.clearValue = clearValue;
     }
     VkRenderingInfo renderingInfo{};
@@ -452,6 +555,69 @@ void CommandList::BeginRenderingOnBackbuffer(float const backgroundColor[4],
     jnrCmdBeginRendering(mCommandBuffers[mActiveCommandIndex], &renderingInfo);
 }
 
+void CommandList::ResumeRenderingOnBackbuffer(Image *depth, bool useStencil)
+{
+    ThrowIfFailed(mImageIndex != -1,
+                  "Rendering on the backbuffer was never started");
+
+    auto renderer = Renderer::Get();
+    if (depth)
+    {
+        TransitionInfo ti{};
+        {
+            ti.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            ti.newLayout =
+                useStencil ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                           : VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+            ti.srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            ti.dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        }
+        TransitionImageTo(depth, ti);
+    }
+
+    VkRenderingAttachmentInfo colorAttachment{};
+    {
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.imageView =
+            renderer->GetSwapchainImageView(mImageIndex);
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    }
+
+    VkRenderingAttachmentInfo depthAttachment{};
+    if (depth)
+    {
+        VkImageAspectFlags depthAspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
+        depthAspectFlags |= useStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0;
+        auto depthImageView = depth->GetImageView(depthAspectFlags);
+
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageLayout =
+            useStencil ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                       : VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+        depthAttachment.imageView = depthImageView.GetView();
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    }
+    VkRenderingInfo renderingInfo{};
+    {
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        renderingInfo.pDepthAttachment =
+            depth != nullptr ? &depthAttachment : nullptr;
+        renderingInfo.pStencilAttachment =
+            useStencil ? &depthAttachment : nullptr;
+        renderingInfo.renderArea = {.offset = VkOffset2D{.x = 0, .y = 0},
+                                    .extent = renderer->GetBackbufferExtent()};
+        renderingInfo.viewMask = 0;
+        renderingInfo.layerCount = 1;
+    }
+
+    jnrCmdBeginRendering(mCommandBuffers[mActiveCommandIndex], &renderingInfo);
+}
+
 void CommandList::BeginRenderingOnImage(Image *img,
                                         float const backgroundColor[4],
                                         Image *depth, bool useStencil)
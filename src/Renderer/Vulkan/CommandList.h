@@ -6,10 +6,12 @@
 #include "RootSignature.h"
 #include "SynchronizationObjects.h"
 #include <Jnrlib.h>
+#include <span>
 
 namespace Vulkan
 {
 class Pipeline;
+class ComputePipeline;
 class DescriptorSet;
 class Renderer;
 class RenderPass;
@@ -87,12 +89,41 @@ public:
     void BindIndexBuffer(Vulkan::Buffer const &buffer);
 
     void BindPipeline(Pipeline &pipeline);
-    void BindDescriptorSet(DescriptorSet &set, u32 descriptorSetInstance,
-                           RootSignature &rootSignature);
-    void SetScissor(std::vector<VkRect2D> const &scissors);
-    void SetViewports(std::vector<VkViewport> const &viewports);
+    void BindPipeline(ComputePipeline &pipeline);
+    void BindDescriptorSet(
+        DescriptorSet &set, u32 descriptorSetInstance,
+        RootSignature &rootSignature,
+        VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+    void SetScissor(std::span<VkRect2D const> scissors);
+    void SetViewports(std::span<VkViewport const> viewports);
     void Draw(u32 vertexCount, u32 firstVertex);
-    void DrawIndexedInstanced(u32 indexCount, u32 firstIndex, u32 vertexOffset);
+    void DrawInstanced(u32 vertexCount, u32 instanceCount, u32 firstVertex,
+                       u32 firstInstance = 0);
+    void DrawIndexedInstanced(u32 indexCount, u32 firstIndex, u32 vertexOffset,
+                              u32 firstInstance = 0);
+    /* Draws VkDrawIndexedIndirectCommands, the number of draws is read from
+     * countBuffer at countOffset (both offsets are in bytes) */
+    void DrawIndexedIndirectCount(Vulkan::Buffer const &commandBuffer,
+                                  u64 commandOffset,
+                                  Vulkan::Buffer const &countBuffer,
+                                  u64 countOffset, u32 maxDrawCount);
+
+    void Dispatch(u32 groupCountX, u32 groupCountY = 1, u32 groupCountZ = 1);
+    /* Reads a VkDispatchIndirectCommand from buffer at offset (in bytes) */
+    void DispatchIndirect(Vulkan::Buffer const &buffer, u64 offset = 0);
+
+    void FillBuffer(Vulkan::Buffer &buffer, u32 value);
+    void BufferBarrier(Vulkan::Buffer const &buffer,
+                       VkPipelineStageFlags srcStage,
+                       VkPipelineStageFlags dstStage,
+                       VkAccessFlags srcAccessMask,
+                       VkAccessFlags dstAccessMask);
+    /* Synchronizes accesses to all the mips of a color image without
+     * changing its layout */
+    void ImageBarrier(Image const &image, VkPipelineStageFlags srcStage,
+                      VkPipelineStageFlags dstStage,
+                      VkAccessFlags srcAccessMask,
+                      VkAccessFlags dstAccessMask);
 
     void TransitionBackbufferTo(TransitionInfo const &transitionInfo);
     void TransitionImageTo(Image *img, TransitionInfo const &transitionInfo);
@@ -109,6 +140,9 @@ public:
 
     void BeginRenderingOnBackbuffer(float const backgroundColor[4],
                                     Image *depth, bool useStencil);
+    /* Continues rendering on the backbuffer acquired by the last
+     * BeginRenderingOnBackbuffer, keeping its contents */
+    void ResumeRenderingOnBackbuffer(Image *depth, bool useStencil);
     void BeginRenderingOnImage(Image *img, float const backgroundColor[4],
                                Image *depth, bool useStencil);
     void EndRendering();
@@ -22,7 +22,7 @@ Image::Image(Info2D const &info)
         imageInfo.flags = 0;
         imageInfo.extent = {.width = info.width, .height = info.height, .depth = 1};
         imageInfo.arrayLayers = 1;
-        imageInfo.mipLevels = 1;
+        imageInfo.mipLevels = info.mipLevels;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.samples = info.samples;
@@ -74,9 +74,15 @@ Image::~Image()
 
 void Image::EnsureAspect(VkImageAspectFlags aspectMask)
 {
-    if (auto it = mImageViews.find(aspectMask); it != mImageViews.end())
+    EnsureView(aspectMask, ALL_MIP_LEVELS);
+}
+
+VkImageView Image::EnsureView(VkImageAspectFlags aspectMask, u32 mipLevel)
+{
+    u64 key = GetViewKey(aspectMask, mipLevel);
+    if (auto it = mImageViews.find(key); it != mImageViews.end())
     {
-        return;
+        return it->second;
     }
     auto renderer = Renderer::Get();
     auto device = renderer->GetDevice();
@@ -90,23 +96,28 @@ void Image::EnsureAspect(VkImageAspectFlags aspectMask)
                                .g = VK_COMPONENT_SWIZZLE_G,
                                .b = VK_COMPONENT_SWIZZLE_B,
                                .a = VK_COMPONENT_SWIZZLE_A};
-        viewInfo.subresourceRange = {
-            .aspectMask = aspectMask, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1};
+        viewInfo.subresourceRange = {.aspectMask = aspectMask,
+                                     .baseMipLevel = mipLevel == ALL_MIP_LEVELS ? 0 : mipLevel,
+                                     .levelCount = mipLevel == ALL_MIP_LEVELS ? mCreateInfo.mipLevels : 1,
+                                     .baseArrayLayer = 0,
+                                     .layerCount = 1};
     }
 
     VkImageView imageView;
     vkThrowIfFailed(jnrCreateImageView(device, &viewInfo, nullptr, &imageView));
-    mImageViews[aspectMask] = imageView;
+    mImageViews[key] = imageView;
+    return imageView;
 }
 
 ImageView Image::GetImageView(VkImageAspectFlags aspectMask)
 {
-    if (auto it = mImageViews.find(aspectMask); it != mImageViews.end())
-    {
-        return {it->second, aspectMask, mLayout};
-    }
-    EnsureAspect(aspectMask);
-    return {mImageViews[aspectMask], aspectMask, mLayout};
+    return {EnsureView(aspectMask, ALL_MIP_LEVELS), aspectMask, mLayout};
+}
+
+ImageView Image::GetImageView(VkImageAspectFlags aspectMask, u32 mipLevel)
+{
+    ThrowIfFailed(mipLevel < mCreateInfo.mipLevels, "Invalid mip level requested");
+    return {EnsureView(aspectMask, mipLevel), aspectMask, mLayout};
 }
 
 VkFormat Image::GetFormat() const
@@ -148,3 +159,8 @@ VkSampleCountFlagBits Vulkan::Image::GetSampleCount() const
 {
     return mCreateInfo.samples;
 }
+
+u32 Vulkan::Image::GetMipLevels() const
+{
+    return mCreateInfo.mipLevels;
+}
@@ -9,8 +9,8 @@ class ImageView
 {
 public:
     ImageView(VkImageView imageView, VkImageAspectFlags aspect,
-              VkImageLayout mLayout)
-        : mImageView(imageView), mAspectFlags(aspect)
+              VkImageLayout layout)
+        : mImageView(imageView), mAspectFlags(aspect), mLayout(layout)
     {
     }
 
@@ -62,6 +62,7 @@ public:
         VkImageUsageFlags usage;
         VkFormat format;
         VkImageLayout initialLayout;
+        u32 mipLevels = 1;
 
         VmaAllocationCreateFlags allocationFlags = 0;
         VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_AUTO;
@@ -103,17 +104,30 @@ public:
     }
 
     void EnsureAspect(VkImageAspectFlags aspectMask);
+    /* View of the whole mip chain */
     ImageView GetImageView(VkImageAspectFlags aspectMask);
+    /* View of a single mip level, used to write the mips one at a time */
+    ImageView GetImageView(VkImageAspectFlags aspectMask, u32 mipLevel);
     VkExtent2D GetExtent2D() const;
     VkImageLayout GetLayout() const;
     VkImageUsageFlags GetUsage() const;
     VkSampleCountFlagBits GetSampleCount() const;
+    u32 GetMipLevels() const;
 
     VkFormat GetFormat() const;
 
 public:
     void SetPixelColor(u32 x, u32 y, float color[4]);
 
+private:
+    static constexpr const u32 ALL_MIP_LEVELS = ~0u;
+
+    static u64 GetViewKey(VkImageAspectFlags aspectMask, u32 mipLevel)
+    {
+        return ((u64)mipLevel << 32) | aspectMask;
+    }
+    VkImageView EnsureView(VkImageAspectFlags aspectMask, u32 mipLevel);
+
 private:
     VkImageCreateInfo mCreateInfo{};
     VkImage mImage = VK_NULL_HANDLE;
@@ -121,7 +135,8 @@ private:
     /* Pretty much used only to be working with the default back-end */
     VkDescriptorSet mImguiTextureID = VK_NULL_HANDLE;
 
-    std::unordered_map<VkImageAspectFlags, VkImageView> mImageViews;
+    /* Indexed by GetViewKey */
+    std::unordered_map<u64, VkImageView> mImageViews;
     VkImageLayout mLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     std::vector<u32> mQueueFamilies;
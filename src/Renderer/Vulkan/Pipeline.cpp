@@ -279,3 +279,80 @@ void Pipeline::Bake(
 
     DSHOWINFO("Successfully baked pipeline ", mName);
 }
+
+void ComputePipeline::Clear()
+{
+    VkDevice device = Renderer::Get()->GetDevice();
+
+    if (mShaderModule != VK_NULL_HANDLE)
+    {
+        jnrDestroyShaderModule(device, mShaderModule, nullptr);
+        mShaderModule = VK_NULL_HANDLE;
+    }
+
+    if (mPipeline != VK_NULL_HANDLE)
+    {
+        jnrDestroyPipeline(device, mPipeline, nullptr);
+        mPipeline = VK_NULL_HANDLE;
+    }
+}
+
+void ComputePipeline::SetShader(std::string const &path)
+{
+    ThrowIfFailed(Jnrlib::contains(path, ".comp."), "\"", path,
+                  "\" is not a compute shader");
+    ThrowIfFailed(mShaderModule == VK_NULL_HANDLE,
+                  "A compute pipeline can have only a single shader");
+
+    VkDevice device = Renderer::Get()->GetDevice();
+    auto shaderContent = Jnrlib::ReadWholeFile(path);
+
+    VkShaderModuleCreateInfo shaderInfo = {};
+    shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderInfo.pCode = reinterpret_cast<const u32 *>(shaderContent.data());
+    shaderInfo.codeSize = (u32)shaderContent.size();
+
+    vkThrowIfFailed(
+        jnrCreateShaderModule(device, &shaderInfo, nullptr, &mShaderModule));
+}
+
+void ComputePipeline::SetRootSignature(RootSignature const *rootSignature)
+{
+    mRootSignature = rootSignature;
+}
+
+void ComputePipeline::Bake()
+{
+    ThrowIfFailed(mShaderModule != VK_NULL_HANDLE,
+                  "A compute pipeline needs a shader before baking");
+
+    VkPipelineLayout layout;
+    if (mRootSignature)
+    {
+        layout = mRootSignature->mPipelineLayout;
+    }
+    else
+    {
+        layout = Renderer::Get()->GetEmptyPipelineLayout();
+    }
+
+    auto device = Renderer::Get()->GetDevice();
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    {
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.layout = layout;
+        pipelineInfo.stage.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = mShaderModule;
+        pipelineInfo.stage.pName = "main";
+    }
+
+    auto cache = Renderer::Get()->GetPipelineCache();
+
+    vkThrowIfFailed(jnrCreateComputePipelines(device, cache, 1, &pipelineInfo,
+                                              nullptr, &mPipeline));
+
+    DSHOWINFO("Successfully baked compute pipeline ", mName);
+}
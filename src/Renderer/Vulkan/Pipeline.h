@@ -147,4 +147,53 @@ private:
     VkPipeline mPipeline = VK_NULL_HANDLE;
 };
 
+class ComputePipeline
+{
+    friend class CommandList;
+
+public:
+    ComputePipeline(std::string const &name) : mName(name)
+    {
+    }
+    ~ComputePipeline()
+    {
+        Clear();
+    }
+
+    ComputePipeline(ComputePipeline const &) = delete;
+    ComputePipeline &operator=(ComputePipeline const &) = delete;
+
+    ComputePipeline(ComputePipeline &&rhs)
+    {
+        *this = std::move(rhs);
+    }
+    ComputePipeline &operator=(ComputePipeline &&rhs)
+    {
+        if (this != &rhs)
+        {
+            std::swap(mName, rhs.mName);
+            std::swap(mRootSignature, rhs.mRootSignature);
+            std::swap(mShaderModule, rhs.mShaderModule);
+            std::swap(mPipeline, rhs.mPipeline);
+        }
+
+        return *this;
+    }
+
+public:
+    void Clear();
+    void SetShader(std::string const &path);
+    void SetRootSignature(RootSignature const *rootSignature);
+
+    void Bake();
+
+private:
+    std::string mName = "";
+
+    RootSignature const *mRootSignature = nullptr;
+
+    VkShaderModule mShaderModule = VK_NULL_HANDLE;
+    VkPipeline mPipeline = VK_NULL_HANDLE;
+};
+
 } // namespace Vulkan
\ No newline at end of file
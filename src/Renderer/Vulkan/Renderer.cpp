@@ -281,6 +281,28 @@ void Renderer::InitDevice(VulkanRendererInfo const &info)
     mDeviceLayers = GetEnabledDeviceLayers(info.deviceLayers);
     mDeviceExtensions = HandleEnabledDeviceExtensions(info.deviceExtensions);
 
+    /* Optional Vulkan 1.2 features */
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+    {
+        VkPhysicalDeviceVulkan12Features supportedVulkan12Features = {};
+        supportedVulkan12Features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 supportedFeatures = {};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = &supportedVulkan12Features;
+        jnrGetPhysicalDeviceFeatures2(mPhysicalDevice, &supportedFeatures);
+
+        vulkan12Features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.drawIndirectCount =
+            supportedVulkan12Features.drawIndirectCount;
+        mSupportsDrawIndirectCount =
+            supportedVulkan12Features.drawIndirectCount == VK_TRUE;
+        /* The depth image is transitioned to depth-only layouts */
+        vulkan12Features.separateDepthStencilLayouts =
+            supportedVulkan12Features.separateDepthStencilLayouts;
+    }
+
     VkDeviceCreateInfo deviceInfo = {};
     {
         deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -295,9 +317,10 @@ void Renderer::InitDevice(VulkanRendererInfo const &info)
         deviceInfo.ppEnabledExtensionNames =
             mDeviceExtensions.extensionNames.data();
 
+        deviceInfo.pNext = &vulkan12Features;
         if (mDeviceExtensions.dynamicRendering.has_value())
         {
-            deviceInfo.pNext = &(*mDeviceExtensions.dynamicRendering);
+            vulkan12Features.pNext = &(*mDeviceExtensions.dynamicRendering);
         }
     }
 
@@ -56,6 +56,12 @@ public:
     VkFormat GetDefaultDepthFormat();
     VkExtent2D GetBackbufferExtent();
 
+    /* Required for GPU driven rendering */
+    bool SupportsDrawIndirectCount() const
+    {
+        return mSupportsDrawIndirectCount;
+    }
+
     u32 AcquireNextImage(GPUSynchronizationObject const &);
     VkImageView GetSwapchainImageView(u32 index);
     u32 GetSwapchainImageCount();
@@ -151,6 +157,7 @@ private:
     GLFWwindow *mWindow;
 
     bool mSupportsDynamicRendering = false;
+    bool mSupportsDrawIndirectCount = false;
 
     VkInstance mInstance;
     std::vector<const char *> mInstanceLayers;
@@ -3,8 +3,15 @@
 #include "Renderer.h"
 #include "VulkanLoader.h"
 
+#include <array>
+#include <memory_resource>
+
 using namespace Vulkan;
 
+/* The temporary arrays built while baking fit on the stack, they only spill
+ * to the heap for unusually large layouts */
+static constexpr const u32 BAKE_SCRATCH_SIZE = 1024;
+
 RootSignature::RootSignature()
 {
 }
@@ -27,7 +34,11 @@ void RootSignature::Bake()
 {
     auto device = Renderer::Get()->GetDevice();
 
-    std::vector<VkDescriptorSetLayout> descriptorSets;
+    std::array<std::byte, BAKE_SCRATCH_SIZE> scratchBuffer;
+    std::pmr::monotonic_buffer_resource scratch(scratchBuffer.data(), scratchBuffer.size());
+
+    std::pmr::vector<VkDescriptorSetLayout> descriptorSets(&scratch);
+    descriptorSets.reserve(mDescriptorSetLayouts.size());
     for (const auto &descriptorSet : mDescriptorSetLayouts)
     {
         descriptorSets.push_back(descriptorSet->mLayout);
@@ -120,6 +131,44 @@ void DescriptorSet::BindCombinedImageSampler(u32 binding, Vulkan::ImageView imag
     jnrUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 }
 
+void DescriptorSet::AddStorageImage(u32 binding, VkShaderStageFlags stages)
+{
+    VkDescriptorSetLayoutBinding layoutBinding{};
+    {
+        layoutBinding.binding = binding;
+        layoutBinding.descriptorCount = 1;
+        layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        layoutBinding.pImmutableSamplers = nullptr;
+        layoutBinding.stageFlags = stages;
+    }
+
+    mBindings.push_back(layoutBinding);
+
+    mStorageImageCount++;
+}
+
+void DescriptorSet::BindStorageImage(u32 binding, Vulkan::ImageView image)
+{
+    auto device = Renderer::Get()->GetDevice();
+    VkDescriptorImageInfo imageInfo{};
+    {
+        imageInfo.sampler = VK_NULL_HANDLE;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageInfo.imageView = image.GetView();
+    }
+    VkWriteDescriptorSet writeDescriptorSet{};
+    {
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeDescriptorSet.dstArrayElement = 0;
+        writeDescriptorSet.dstBinding = binding;
+        writeDescriptorSet.dstSet = mDescriptorSets[mActiveInstance];
+        writeDescriptorSet.pImageInfo = &imageInfo;
+    }
+    jnrUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+}
+
 void DescriptorSet::AddStorageBuffer(u32 binding, u32 descriptorCount, VkShaderStageFlags stages)
 {
     VkDescriptorSetLayoutBinding layoutBinding{};
@@ -223,13 +272,16 @@ void DescriptorSet::Bake(u32 instances)
     if (mLayout == VK_NULL_HANDLE)
         BakeLayout();
 
-    std::vector<VkDescriptorPoolSize> sizes = {};
+    std::array<std::byte, BAKE_SCRATCH_SIZE> scratchBuffer;
+    std::pmr::monotonic_buffer_resource scratch(scratchBuffer.data(), scratchBuffer.size());
+
+    std::pmr::vector<VkDescriptorPoolSize> sizes(&scratch);
     if (mInputBufferCount != 0)
     {
         VkDescriptorPoolSize &inputBufferSize = sizes.emplace_back();
         {
             inputBufferSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            inputBufferSize.descriptorCount = mInputBufferCount;
+            inputBufferSize.descriptorCount = mInputBufferCount * instances;
         }
     }
     if (mStorageBufferCount != 0)
@@ -237,7 +289,7 @@ void DescriptorSet::Bake(u32 instances)
         VkDescriptorPoolSize &inputBufferSize = sizes.emplace_back();
         {
             inputBufferSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            inputBufferSize.descriptorCount = mStorageBufferCount;
+            inputBufferSize.descriptorCount = mStorageBufferCount * instances;
         }
     }
     if (mSamplerCount != 0)
@@ -245,7 +297,7 @@ void DescriptorSet::Bake(u32 instances)
         VkDescriptorPoolSize &inputBufferSize = sizes.emplace_back();
         {
             inputBufferSize.type = VK_DESCRIPTOR_TYPE_SAMPLER;
-            inputBufferSize.descriptorCount = mSamplerCount;
+            inputBufferSize.descriptorCount = mSamplerCount * instances;
         }
     }
     if (mCombinedImageSamplerCount != 0)
@@ -253,7 +305,15 @@ void DescriptorSet::Bake(u32 instances)
         VkDescriptorPoolSize &inputBufferSize = sizes.emplace_back();
         {
             inputBufferSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            inputBufferSize.descriptorCount = mCombinedImageSamplerCount;
+            inputBufferSize.descriptorCount = mCombinedImageSamplerCount * instances;
+        }
+    }
+    if (mStorageImageCount != 0)
+    {
+        VkDescriptorPoolSize &inputBufferSize = sizes.emplace_back();
+        {
+            inputBufferSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            inputBufferSize.descriptorCount = mStorageImageCount * instances;
         }
     }
     VkDescriptorPoolCreateInfo &poolInfo = mPoolInfo;
@@ -267,7 +327,7 @@ void DescriptorSet::Bake(u32 instances)
     vkThrowIfFailed(jnrCreateDescriptorPool(device, &poolInfo, nullptr, &mDescriptorPool));
 
     mDescriptorSets.resize(mPoolInfo.maxSets);                              /* Make space for descriptor sets */
-    std::vector<VkDescriptorSetLayout> layouts(mPoolInfo.maxSets, mLayout); /* Have enought layouts */
+    std::pmr::vector<VkDescriptorSetLayout> layouts(mPoolInfo.maxSets, mLayout, &scratch); /* Have enought layouts */
     VkDescriptorSetAllocateInfo allocInfo{};
     {
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -38,6 +38,7 @@ public:
             std::swap(mSamplerCount, rhs.mSamplerCount);
             std::swap(mCombinedImageSamplerCount,
                       rhs.mCombinedImageSamplerCount);
+            std::swap(mStorageImageCount, rhs.mStorageImageCount);
             std::swap(mActiveInstance, rhs.mActiveInstance);
             std::swap(mBindings, rhs.mBindings);
             std::swap(mLayout, rhs.mLayout);
@@ -61,6 +62,11 @@ public:
                                   VkImageAspectFlags aspectFlags,
                                   VkSampler sampler);
 
+    void AddStorageImage(u32 binding,
+                         VkShaderStageFlags stages = VK_SHADER_STAGE_ALL);
+    /* The image must be in VK_IMAGE_LAYOUT_GENERAL when used */
+    void BindStorageImage(u32 binding, Vulkan::ImageView image);
+
     void AddStorageBuffer(u32 binding, u32 descriptorCount,
                           VkShaderStageFlags stages = VK_SHADER_STAGE_ALL);
     void BindStorageBuffer(Vulkan::Buffer &buffer, u32 binding,
@@ -92,6 +98,7 @@ private:
     u32 mStorageBufferCount = 0;
     u32 mSamplerCount = 0;
     u32 mCombinedImageSamplerCount = 0;
+    u32 mStorageImageCount = 0;
 
     u32 mActiveInstance = 0;
 
@@ -105,6 +112,7 @@ private:
 class RootSignature
 {
     friend class Pipeline;
+    friend class ComputePipeline;
     friend class CommandList;
 
 public:
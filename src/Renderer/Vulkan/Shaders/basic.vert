@@ -2,13 +2,10 @@
 
 struct PerObjectInfo {
     mat4 world;
+    vec4 positionScale;
+    vec4 positionOffset;
 };
 
-layout(push_constant) uniform ObjectIndex
-{
-    uint objectIndex;
-} PushConstant;
-
 layout(std140, set = 0, binding = 0) readonly buffer ObjectBuffer {
     PerObjectInfo objects[];
 } objectBuffer;
@@ -21,18 +18,33 @@ layout(std140, set = 0, binding = 1) uniform UniformBufferObject
 layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec3 fragColor;
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
+/* Packed as snorm16 (see VertexPositionNormalPacked) */
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -t : t;
+    normal.y += normal.y >= 0.0 ? -t : t;
+    return normalize(normal);
+}
 
 void main()
 {
-    PerObjectInfo ob = objectBuffer.objects[PushConstant.objectIndex];
+    /* The object index is passed as firstInstance, both by the CPU and the GPU driven draws */
+    uint objectIndex = gl_InstanceIndex;
+    PerObjectInfo ob = objectBuffer.objects[objectIndex];
+
+    vec3 position = inPosition.xyz * ob.positionScale.xyz + ob.positionOffset.xyz;
+    vec3 normal = DecodeOctahedral(inNormal);
 
-    gl_Position = uniformObject.viewProj * ob.world * vec4(inPosition, 1.0);
+    gl_Position = uniformObject.viewProj * ob.world * vec4(position, 1.0);
     mat3 normalMatrix = transpose(inverse(mat3(ob.world)));
-    outNormal = normalize(normalMatrix * inNormal);
+    outNormal = normalize(normalMatrix * normal);
 
-    if (PushConstant.objectIndex == 0)
+    if (objectIndex == 0)
     {
         fragColor = vec3(1.0, 1.0, 1.0);
     }
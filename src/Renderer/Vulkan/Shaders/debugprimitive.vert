@@ -0,0 +1,28 @@
+#version 450
+
+layout(push_constant) uniform camera
+{
+    mat4 viewProj;
+} PushConstant;
+
+/* Unit mesh */
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec4 inColor;
+
+/* Instance, rows of the affine object to world transform */
+layout(location = 2) in vec4 inTransformRow0;
+layout(location = 3) in vec4 inTransformRow1;
+layout(location = 4) in vec4 inTransformRow2;
+layout(location = 5) in vec4 inInstanceColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main()
+{
+    vec4 position = vec4(inPosition, 1.0);
+    vec3 worldPosition = vec3(dot(inTransformRow0, position), dot(inTransformRow1, position),
+                              dot(inTransformRow2, position));
+    gl_Position = PushConstant.viewProj * vec4(worldPosition, 1.0);
+
+    fragColor = vec3(inColor * inInstanceColor);
+}
@@ -116,6 +116,11 @@ JNR_FN(CreateFramebuffer);
 JNR_FN(DestroyFramebuffer);
 JNR_FN(CmdBeginRenderPass);
 JNR_FN(CmdEndRenderPass);
+JNR_FN(CreateComputePipelines);
+JNR_FN(CmdDispatch);
+JNR_FN(CmdDispatchIndirect);
+JNR_FN(CmdFillBuffer);
+JNR_FN(CmdDrawIndexedIndirectCount);
 
 // Instance
 JNR_FN(DestroyInstance);
@@ -124,6 +129,7 @@ JNR_FN(DestroyDebugUtilsMessengerEXT);
 JNR_FN(EnumeratePhysicalDevices);
 JNR_FN(GetPhysicalDeviceProperties);
 JNR_FN(GetPhysicalDeviceFeatures);
+JNR_FN(GetPhysicalDeviceFeatures2);
 JNR_FN(GetPhysicalDeviceQueueFamilyProperties);
 JNR_FN(EnumerateDeviceLayerProperties);
 JNR_FN(CreateDevice);
@@ -165,6 +171,7 @@ void Vulkan::LoadFunctionsInstance(VkInstance instance)
     GET_INST_FN(EnumeratePhysicalDevices, instance);
     GET_INST_FN(GetPhysicalDeviceProperties, instance);
     GET_INST_FN(GetPhysicalDeviceFeatures, instance);
+    GET_INST_FN(GetPhysicalDeviceFeatures2, instance);
     GET_INST_FN(GetPhysicalDeviceQueueFamilyProperties, instance);
     GET_INST_FN(EnumerateDeviceLayerProperties, instance);
     GET_INST_FN(CreateDevice, instance);
@@ -256,6 +263,11 @@ void Vulkan::LoadFunctionsDevice(VkDevice device)
     GET_DEV_FN(DestroyFramebuffer, device);
     GET_DEV_FN(CmdBeginRenderPass, device);
     GET_DEV_FN(CmdEndRenderPass, device);
+    GET_DEV_FN(CreateComputePipelines, device);
+    GET_DEV_FN(CmdDispatch, device);
+    GET_DEV_FN(CmdDispatchIndirect, device);
+    GET_DEV_FN(CmdFillBuffer, device);
+    GET_DEV_FN(CmdDrawIndexedIndirectCount, device);
 }
 
 PFN_vkVoidFunction Vulkan::GetFunctionByName(char const *name, void *userData)
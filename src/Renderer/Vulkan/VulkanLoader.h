@@ -83,6 +83,11 @@ extern JNR_FN(CreateFramebuffer);
 extern JNR_FN(DestroyFramebuffer);
 extern JNR_FN(CmdBeginRenderPass);
 extern JNR_FN(CmdEndRenderPass);
+extern JNR_FN(CreateComputePipelines);
+extern JNR_FN(CmdDispatch);
+extern JNR_FN(CmdDispatchIndirect);
+extern JNR_FN(CmdFillBuffer);
+extern JNR_FN(CmdDrawIndexedIndirectCount);
 
 // Instance
 extern JNR_FN(DestroyInstance);
@@ -91,6 +96,7 @@ extern JNR_FN(DestroyDebugUtilsMessengerEXT);
 extern JNR_FN(EnumeratePhysicalDevices);
 extern JNR_FN(GetPhysicalDeviceProperties);
 extern JNR_FN(GetPhysicalDeviceFeatures);
+extern JNR_FN(GetPhysicalDeviceFeatures2);
 extern JNR_FN(GetPhysicalDeviceQueueFamilyProperties);
 extern JNR_FN(EnumerateDeviceLayerProperties);
 extern JNR_FN(CreateDevice);
@@ -7,6 +7,21 @@
 namespace Constants
 {
 static constexpr u32 MAX_IN_FLIGHT_FRAMES = 3;
+/* Including the full detail mesh */
+static constexpr u32 MAX_MESH_LODS = 4;
+/* LODs are picked so that their simplification error stays under this */
+static constexpr f32 LOD_ERROR_THRESHOLD_PIXELS = 1.0f;
+/* Physics runs at a fixed rate, independent of the frame rate */
+static constexpr f32 PHYSICS_TICK_RATE = 60.0f;
+/* After a hitch the simulation catches up with at most this many steps,
+ * the rest of the time is dropped instead of spiraling into longer frames */
+static constexpr u32 MAX_PHYSICS_STEPS_PER_UPDATE = 4;
+/* Threads stepping the physics world, 0 uses every job system thread and 1
+ * keeps the single threaded world */
+static constexpr u32 PHYSICS_WORKER_COUNT = 0;
+/* Where the baked BVHs of static triangle meshes go, relative to the working
+ * directory */
+static constexpr char const *PHYSICS_CACHE_DIRECTORY = "Cache/Physics";
 constexpr const static glm::vec4 DEFAULT_FORWARD_DIRECTION =
     glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
 constexpr const static glm::vec4 DEFAULT_RIGHT_DIRECTION =
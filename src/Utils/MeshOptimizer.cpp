@@ -0,0 +1,788 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+constexpr const u32 INVALID_INDEX = std::numeric_limits<u32>::max();
+
+/* Tweakables from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" */
+constexpr const u32 FORSYTH_CACHE_SIZE = 32;
+constexpr const f32 CACHE_DECAY_POWER = 1.5f;
+constexpr const f32 LAST_TRIANGLE_SCORE = 0.75f;
+constexpr const f32 VALENCE_BOOST_SCALE = 2.0f;
+constexpr const f32 VALENCE_BOOST_POWER = 0.5f;
+
+f32 ComputeVertexScore(i32 cachePosition, u32 remainingTriangles)
+{
+    if (remainingTriangles == 0)
+    {
+        return -1.0f;
+    }
+
+    f32 score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+        {
+            /* The vertices of the last triangle get a fixed score, so that strips don't get favoured over fans */
+            score = LAST_TRIANGLE_SCORE;
+        }
+        else
+        {
+            constexpr f32 scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (f32)(cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+
+    /* Boost vertices with few triangles left so that we don't leave lone triangles behind */
+    score += VALENCE_BOOST_SCALE * std::pow((f32)remainingTriangles, -VALENCE_BOOST_POWER);
+    return score;
+}
+
+/* FNV-1a over the raw bytes; the equality is bitwise as well */
+template <typename T> struct BitwiseHasher
+{
+    size_t operator()(T const &value) const
+    {
+        u8 const *bytes = (u8 const *)&value;
+        u64 hash = 14695981039346656037ull;
+        for (u32 i = 0; i < sizeof(T); ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return (size_t)hash;
+    }
+};
+
+template <typename T> struct BitwiseEqual
+{
+    bool operator()(T const &lhs, T const &rhs) const
+    {
+        return memcmp(&lhs, &rhs, sizeof(T)) == 0;
+    }
+};
+
+/* Border edges get a plane perpendicular to the surface, weighted heavier than the surface itself so that the
+ * silhouette of open meshes is preserved */
+constexpr const f32 BORDER_WEIGHT = 10.0f;
+
+struct Quadric
+{
+    f64 a00 = 0.0, a11 = 0.0, a22 = 0.0;
+    f64 a01 = 0.0, a02 = 0.0, a12 = 0.0;
+    f64 b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    f64 c = 0.0;
+    f64 weight = 0.0;
+
+    /* Squared distance to the plane dot(normal, p) + distance = 0 */
+    static Quadric FromPlane(glm::vec3 const &normal, f32 distance, f32 weight)
+    {
+        Quadric result;
+        f64 a = normal.x, b = normal.y, c = normal.z, d = distance, w = weight;
+
+        result.a00 = a * a * w;
+        result.a11 = b * b * w;
+        result.a22 = c * c * w;
+        result.a01 = a * b * w;
+        result.a02 = a * c * w;
+        result.a12 = b * c * w;
+        result.b0 = a * d * w;
+        result.b1 = b * d * w;
+        result.b2 = c * d * w;
+        result.c = d * d * w;
+        result.weight = w;
+        return result;
+    }
+
+    Quadric &operator+=(Quadric const &rhs)
+    {
+        a00 += rhs.a00;
+        a11 += rhs.a11;
+        a22 += rhs.a22;
+        a01 += rhs.a01;
+        a02 += rhs.a02;
+        a12 += rhs.a12;
+        b0 += rhs.b0;
+        b1 += rhs.b1;
+        b2 += rhs.b2;
+        c += rhs.c;
+        weight += rhs.weight;
+        return *this;
+    }
+
+    /* Weighted average distance from p to the accumulated planes */
+    f32 Error(glm::vec3 const &p) const
+    {
+        if (weight <= 0.0)
+        {
+            return 0.0f;
+        }
+
+        f64 x = p.x, y = p.y, z = p.z;
+        f64 result = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                     2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return (f32)std::sqrt(std::max(result, 0.0) / weight);
+    }
+};
+
+u64 EdgeKey(u32 a, u32 b)
+{
+    if (a > b)
+    {
+        std::swap(a, b);
+    }
+    return ((u64)a << 32) | b;
+}
+} // namespace
+
+namespace MeshOptimizer
+{
+static_assert(sizeof(VertexPositionNormal) == sizeof(f32) * 6, "Deduplication expects vertices without padding");
+
+void DeduplicateVertices(std::vector<VertexPositionNormal> &vertices, std::vector<u32> &indices)
+{
+    using VertexMap = std::unordered_map<VertexPositionNormal, u32, BitwiseHasher<VertexPositionNormal>,
+                                         BitwiseEqual<VertexPositionNormal>>;
+    VertexMap uniqueVertices;
+    uniqueVertices.reserve(vertices.size());
+
+    std::vector<u32> remap(vertices.size());
+    std::vector<VertexPositionNormal> result;
+    result.reserve(vertices.size());
+
+    for (u32 i = 0; i < (u32)vertices.size(); ++i)
+    {
+        auto [it, inserted] = uniqueVertices.emplace(vertices[i], (u32)result.size());
+        if (inserted)
+        {
+            result.push_back(vertices[i]);
+        }
+        remap[i] = it->second;
+    }
+
+    for (auto &index : indices)
+    {
+        index = remap[index];
+    }
+
+    vertices = std::move(result);
+}
+
+void OptimizeVertexCache(std::vector<u32> &indices, u32 vertexCount)
+{
+    u32 triangleCount = (u32)indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    /* Build vertex -> triangle adjacency. The first remainingTriangles[v] entries of each list are the triangles that
+     * haven't been emitted yet */
+    std::vector<u32> remainingTriangles(vertexCount, 0);
+    for (auto index : indices)
+    {
+        remainingTriangles[index]++;
+    }
+
+    std::vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        adjacencyOffsets[i + 1] = adjacencyOffsets[i] + remainingTriangles[i];
+    }
+
+    std::vector<u32> adjacency(indices.size());
+    {
+        std::vector<u32> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (u32 i = 0; i < (u32)indices.size(); ++i)
+        {
+            adjacency[cursor[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<f32> vertexScores(vertexCount);
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        vertexScores[i] = ComputeVertexScore(-1, remainingTriangles[i]);
+    }
+
+    std::vector<f32> triangleScores(triangleCount);
+    std::vector<bool> emittedTriangles(triangleCount, false);
+    u32 bestTriangle = 0;
+    for (u32 i = 0; i < triangleCount; ++i)
+    {
+        triangleScores[i] =
+            vertexScores[indices[i * 3 + 0]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+        if (triangleScores[i] > triangleScores[bestTriangle])
+        {
+            bestTriangle = i;
+        }
+    }
+
+    std::vector<u32> result;
+    result.reserve(indices.size());
+
+    std::array<u32, FORSYTH_CACHE_SIZE + 3> cache;
+    std::array<u32, FORSYTH_CACHE_SIZE + 3> newCache;
+    u32 cacheCount = 0;
+    u32 scanCursor = 0;
+
+    auto updateVertexScore = [&](u32 vertex, i32 cachePosition, u32 &bestTriangle, f32 &bestScore) {
+        f32 newScore = ComputeVertexScore(cachePosition, remainingTriangles[vertex]);
+        f32 delta = newScore - vertexScores[vertex];
+        vertexScores[vertex] = newScore;
+
+        u32 const *triangles = &adjacency[adjacencyOffsets[vertex]];
+        for (u32 i = 0; i < remainingTriangles[vertex]; ++i)
+        {
+            u32 triangle = triangles[i];
+            triangleScores[triangle] += delta;
+            if (triangleScores[triangle] > bestScore)
+            {
+                bestScore = triangleScores[triangle];
+                bestTriangle = triangle;
+            }
+        }
+    };
+
+    while (bestTriangle != INVALID_INDEX)
+    {
+        u32 const *triangleIndices = &indices[bestTriangle * 3];
+        result.insert(result.end(), triangleIndices, triangleIndices + 3);
+        emittedTriangles[bestTriangle] = true;
+
+        /* Remove the triangle from the adjacency of its vertices and put them in front of the LRU cache */
+        u32 newCacheCount = 0;
+        for (u32 i = 0; i < 3; ++i)
+        {
+            u32 vertex = triangleIndices[i];
+
+            u32 *begin = &adjacency[adjacencyOffsets[vertex]];
+            u32 *end = begin + remainingTriangles[vertex];
+            std::iter_swap(std::find(begin, end, bestTriangle), end - 1);
+            remainingTriangles[vertex]--;
+
+            if (std::find(newCache.begin(), newCache.begin() + newCacheCount, vertex) ==
+                newCache.begin() + newCacheCount)
+            {
+                newCache[newCacheCount++] = vertex;
+            }
+        }
+        for (u32 i = 0; i < cacheCount; ++i)
+        {
+            u32 vertex = cache[i];
+            if (vertex != triangleIndices[0] && vertex != triangleIndices[1] && vertex != triangleIndices[2])
+            {
+                newCache[newCacheCount++] = vertex;
+            }
+        }
+
+        bestTriangle = INVALID_INDEX;
+        f32 bestScore = -1.0f;
+
+        /* Vertices that fell out of the cache lose their cache score; their triangles are not candidates */
+        for (u32 i = FORSYTH_CACHE_SIZE; i < newCacheCount; ++i)
+        {
+            u32 ignoredTriangle = INVALID_INDEX;
+            f32 ignoredScore = std::numeric_limits<f32>::max();
+            updateVertexScore(newCache[i], -1, ignoredTriangle, ignoredScore);
+        }
+
+        cacheCount = std::min(newCacheCount, FORSYTH_CACHE_SIZE);
+        std::copy(newCache.begin(), newCache.begin() + cacheCount, cache.begin());
+        for (u32 i = 0; i < cacheCount; ++i)
+        {
+            updateVertexScore(cache[i], (i32)i, bestTriangle, bestScore);
+        }
+
+        if (bestTriangle == INVALID_INDEX)
+        {
+            /* Nothing adjacent to the cache, restart from the first triangle that hasn't been emitted yet */
+            for (; scanCursor < triangleCount; ++scanCursor)
+            {
+                if (!emittedTriangles[scanCursor])
+                {
+                    bestTriangle = scanCursor;
+                    break;
+                }
+            }
+        }
+    }
+
+    indices = std::move(result);
+}
+
+void OptimizeOverdraw(std::vector<u32> &indices, std::vector<VertexPositionNormal> const &vertices, u32 cacheSize)
+{
+    u32 triangleCount = (u32)indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    /* Split the index buffer in clusters at the triangles where the cache restarts (every vertex misses). Reordering
+     * whole clusters keeps the result of the vertex cache optimization */
+    std::vector<u32> clusterOffsets;
+    {
+        std::vector<u32> cacheTimestamps(vertices.size(), 0);
+        u32 timestamp = cacheSize + 1;
+
+        for (u32 i = 0; i < triangleCount; ++i)
+        {
+            u32 misses = 0;
+            for (u32 j = 0; j < 3; ++j)
+            {
+                u32 vertex = indices[i * 3 + j];
+                if (timestamp - cacheTimestamps[vertex] > cacheSize)
+                {
+                    cacheTimestamps[vertex] = timestamp++;
+                    misses++;
+                }
+            }
+
+            if (i == 0 || misses == 3)
+            {
+                clusterOffsets.push_back(i);
+            }
+        }
+    }
+
+    if (clusterOffsets.size() == 1)
+    {
+        return;
+    }
+
+    struct Cluster
+    {
+        u32 firstTriangle;
+        u32 triangleCount;
+        glm::vec3 centroid;
+        glm::vec3 normal;
+        f32 area;
+        f32 sortKey;
+    };
+
+    std::vector<Cluster> clusters(clusterOffsets.size());
+    glm::vec3 meshCentroid = glm::vec3(0.0f);
+    f32 meshArea = 0.0f;
+    for (u32 c = 0; c < (u32)clusters.size(); ++c)
+    {
+        auto &cluster = clusters[c];
+        cluster.firstTriangle = clusterOffsets[c];
+        cluster.triangleCount =
+            (c + 1 < (u32)clusterOffsets.size() ? clusterOffsets[c + 1] : triangleCount) - cluster.firstTriangle;
+        cluster.centroid = glm::vec3(0.0f);
+        cluster.normal = glm::vec3(0.0f);
+        cluster.area = 0.0f;
+
+        for (u32 i = cluster.firstTriangle; i < cluster.firstTriangle + cluster.triangleCount; ++i)
+        {
+            auto const &v0 = vertices[indices[i * 3 + 0]];
+            auto const &v1 = vertices[indices[i * 3 + 1]];
+            auto const &v2 = vertices[indices[i * 3 + 2]];
+
+            /* Use the vertex normals instead of the winding, so the result doesn't depend on the front face */
+            f32 area = glm::length(glm::cross(v1.position - v0.position, v2.position - v0.position)) * 0.5f;
+            cluster.centroid += (v0.position + v1.position + v2.position) * (area / 3.0f);
+            cluster.normal += (v0.normal + v1.normal + v2.normal) * area;
+            cluster.area += area;
+        }
+
+        meshCentroid += cluster.centroid;
+        meshArea += cluster.area;
+        if (cluster.area > 0.0f)
+        {
+            cluster.centroid /= cluster.area;
+        }
+    }
+    if (meshArea > 0.0f)
+    {
+        meshCentroid /= meshArea;
+    }
+
+    /* Clusters that face away from the center of the mesh are likely to occlude the rest, so draw them first */
+    for (auto &cluster : clusters)
+    {
+        f32 normalLength = glm::length(cluster.normal);
+        cluster.sortKey =
+            normalLength > 0.0f ? glm::dot(cluster.centroid - meshCentroid, cluster.normal / normalLength) : 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](Cluster const &lhs, Cluster const &rhs) { return lhs.sortKey > rhs.sortKey; });
+
+    std::vector<u32> result;
+    result.reserve(indices.size());
+    for (auto const &cluster : clusters)
+    {
+        auto begin = indices.begin() + cluster.firstTriangle * 3;
+        result.insert(result.end(), begin, begin + cluster.triangleCount * 3);
+    }
+
+    indices = std::move(result);
+}
+
+void OptimizeVertexFetch(std::vector<VertexPositionNormal> &vertices, std::vector<u32> &indices)
+{
+    std::vector<u32> remap(vertices.size(), INVALID_INDEX);
+    std::vector<VertexPositionNormal> result;
+    result.reserve(vertices.size());
+
+    for (auto &index : indices)
+    {
+        if (remap[index] == INVALID_INDEX)
+        {
+            remap[index] = (u32)result.size();
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(result);
+}
+
+VertexCacheStatistics AnalyzeVertexCache(std::vector<u32> const &indices, u32 vertexCount, u32 cacheSize)
+{
+    VertexCacheStatistics statistics = {};
+    u32 triangleCount = (u32)indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return statistics;
+    }
+
+    /* A vertex is in the FIFO if it got transformed less than cacheSize transforms ago */
+    std::vector<u32> cacheTimestamps(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    u32 timestamp = cacheSize + 1;
+    u32 referencedCount = 0;
+
+    for (auto index : indices)
+    {
+        if (timestamp - cacheTimestamps[index] > cacheSize)
+        {
+            cacheTimestamps[index] = timestamp++;
+            statistics.transformedVertices++;
+        }
+
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            referencedCount++;
+        }
+    }
+
+    statistics.acmr = (f32)statistics.transformedVertices / (f32)triangleCount;
+    statistics.atvr = (f32)statistics.transformedVertices / (f32)referencedCount;
+    return statistics;
+}
+
+std::vector<u32> Simplify(std::vector<VertexPositionNormal> const &vertices, std::vector<u32> const &indices,
+                          u32 targetIndexCount, f32 maxError, f32 *resultError)
+{
+    std::vector<u32> result = indices;
+    u32 vertexCount = (u32)vertices.size();
+    f32 error = 0.0f;
+
+    if (resultError)
+    {
+        *resultError = 0.0f;
+    }
+    if (result.size() <= targetIndexCount || vertexCount == 0)
+    {
+        return result;
+    }
+
+    /* Collapses are decided per position, wedges (vertices that only differ by their attributes) share the decision */
+    std::vector<u32> positionRemap(vertexCount);
+    std::vector<u32> wedgeCount(vertexCount, 0);
+    {
+        std::unordered_map<glm::vec3, u32, BitwiseHasher<glm::vec3>, BitwiseEqual<glm::vec3>> uniquePositions;
+        uniquePositions.reserve(vertexCount);
+        for (u32 i = 0; i < vertexCount; ++i)
+        {
+            auto [it, inserted] = uniquePositions.emplace(vertices[i].position, i);
+            positionRemap[i] = it->second;
+            wedgeCount[it->second]++;
+        }
+    }
+
+    auto countEdgeUses = [&](std::unordered_map<u64, u32> &edgeUses) {
+        edgeUses.clear();
+        for (u32 i = 0; i < (u32)result.size(); i += 3)
+        {
+            for (u32 j = 0; j < 3; ++j)
+            {
+                u32 a = positionRemap[result[i + j]];
+                u32 b = positionRemap[result[i + (j + 1) % 3]];
+                edgeUses[EdgeKey(a, b)]++;
+            }
+        }
+    };
+
+    std::unordered_map<u64, u32> edgeUses;
+    countEdgeUses(edgeUses);
+
+    enum class VertexKind : u8
+    {
+        Manifold,
+        Border,
+        Locked,
+    };
+    std::vector<VertexKind> kinds(vertexCount, VertexKind::Manifold);
+    {
+        std::vector<u32> borderEdges(vertexCount, 0);
+        for (auto const &[key, uses] : edgeUses)
+        {
+            u32 a = (u32)(key >> 32), b = (u32)key;
+            if (uses == 1)
+            {
+                borderEdges[a]++;
+                borderEdges[b]++;
+            }
+            else if (uses > 2)
+            {
+                kinds[a] = VertexKind::Locked;
+                kinds[b] = VertexKind::Locked;
+            }
+        }
+
+        for (u32 i = 0; i < vertexCount; ++i)
+        {
+            if (positionRemap[i] != i || kinds[i] == VertexKind::Locked)
+            {
+                continue;
+            }
+
+            if (wedgeCount[i] > 1)
+            {
+                /* Attribute seam, collapsing it would need to pick one of the wedges */
+                kinds[i] = VertexKind::Locked;
+            }
+            else if (borderEdges[i] == 2)
+            {
+                kinds[i] = VertexKind::Border;
+            }
+            else if (borderEdges[i] != 0)
+            {
+                kinds[i] = VertexKind::Locked;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (u32 i = 0; i < (u32)result.size(); i += 3)
+    {
+        u32 p[3] = {positionRemap[result[i + 0]], positionRemap[result[i + 1]], positionRemap[result[i + 2]]};
+        glm::vec3 const &p0 = vertices[p[0]].position;
+        glm::vec3 const &p1 = vertices[p[1]].position;
+        glm::vec3 const &p2 = vertices[p[2]].position;
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        f32 length = glm::length(normal);
+        if (length == 0.0f)
+        {
+            continue;
+        }
+        normal /= length;
+
+        Quadric quadric = Quadric::FromPlane(normal, -glm::dot(normal, p0), length * 0.5f);
+        for (u32 j = 0; j < 3; ++j)
+        {
+            quadrics[p[j]] += quadric;
+
+            u32 a = p[j], b = p[(j + 1) % 3];
+            if (edgeUses[EdgeKey(a, b)] == 1)
+            {
+                glm::vec3 edge = vertices[b].position - vertices[a].position;
+                glm::vec3 edgeNormal = glm::cross(edge, normal);
+                f32 edgeNormalLength = glm::length(edgeNormal);
+                if (edgeNormalLength > 0.0f)
+                {
+                    edgeNormal /= edgeNormalLength;
+                    Quadric borderQuadric =
+                        Quadric::FromPlane(edgeNormal, -glm::dot(edgeNormal, vertices[a].position),
+                                           glm::dot(edge, edge) * BORDER_WEIGHT);
+                    quadrics[a] += borderQuadric;
+                    quadrics[b] += borderQuadric;
+                }
+            }
+        }
+    }
+
+    struct Collapse
+    {
+        /* Wedges, the positions can be found through positionRemap */
+        u32 from;
+        u32 to;
+        f32 error;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<u32> wedgeRemap(vertexCount);
+    std::iota(wedgeRemap.begin(), wedgeRemap.end(), 0);
+    std::vector<bool> lockedThisPass(vertexCount);
+    std::vector<u32> adjacencyOffsets(vertexCount + 1);
+    std::vector<u32> adjacency;
+
+    auto flipsTriangles = [&](u32 from, u32 to) {
+        glm::vec3 const &target = vertices[to].position;
+        for (u32 i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; ++i)
+        {
+            u32 const *triangle = &result[adjacency[i] * 3];
+            u32 p[3] = {positionRemap[triangle[0]], positionRemap[triangle[1]], positionRemap[triangle[2]]};
+            if (p[0] == to || p[1] == to || p[2] == to)
+            {
+                /* Becomes degenerate */
+                continue;
+            }
+
+            glm::vec3 before[3] = {vertices[p[0]].position, vertices[p[1]].position, vertices[p[2]].position};
+            glm::vec3 after[3] = {p[0] == from ? target : before[0], p[1] == from ? target : before[1],
+                                  p[2] == from ? target : before[2]};
+            glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    /* Every pass collapses a set of independent edges, cheapest first, then rebuilds the index buffer */
+    while (result.size() > targetIndexCount)
+    {
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (auto index : result)
+        {
+            adjacencyOffsets[positionRemap[index] + 1]++;
+        }
+        for (u32 i = 0; i < vertexCount; ++i)
+        {
+            adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        }
+        adjacency.resize(result.size());
+        {
+            std::vector<u32> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (u32 i = 0; i < (u32)result.size(); ++i)
+            {
+                adjacency[cursor[positionRemap[result[i]]]++] = i / 3;
+            }
+        }
+
+        collapses.clear();
+        for (u32 i = 0; i < (u32)result.size(); i += 3)
+        {
+            for (u32 j = 0; j < 3; ++j)
+            {
+                u32 wedges[2] = {result[i + j], result[i + (j + 1) % 3]};
+                for (u32 k = 0; k < 2; ++k)
+                {
+                    u32 from = positionRemap[wedges[k]];
+                    u32 to = positionRemap[wedges[1 - k]];
+                    if (kinds[from] == VertexKind::Locked)
+                    {
+                        continue;
+                    }
+                    if (kinds[from] == VertexKind::Border &&
+                        (kinds[to] == VertexKind::Manifold || edgeUses[EdgeKey(from, to)] != 1))
+                    {
+                        /* Borders can only collapse along themselves */
+                        continue;
+                    }
+
+                    Quadric quadric = quadrics[from];
+                    quadric += quadrics[to];
+                    collapses.push_back({wedges[k], wedges[1 - k], quadric.Error(vertices[to].position)});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](Collapse const &lhs, Collapse const &rhs) { return lhs.error < rhs.error; });
+
+        /* A collapse removes two triangles (one on borders) */
+        u32 trianglesToRemove = (u32)(result.size() - targetIndexCount) / 3;
+        u32 collapsesLeft = trianglesToRemove / 2 + 1;
+
+        std::fill(lockedThisPass.begin(), lockedThisPass.end(), false);
+        u32 performedCollapses = 0;
+        for (auto const &collapse : collapses)
+        {
+            if (collapse.error > maxError || performedCollapses == collapsesLeft)
+            {
+                break;
+            }
+
+            u32 from = positionRemap[collapse.from];
+            u32 to = positionRemap[collapse.to];
+            if (lockedThisPass[from] || lockedThisPass[to] || flipsTriangles(from, to))
+            {
+                continue;
+            }
+
+            wedgeRemap[collapse.from] = collapse.to;
+            quadrics[to] += quadrics[from];
+            error = std::max(error, collapse.error);
+            performedCollapses++;
+
+            /* The one-ring of the collapsed vertex changed, so no other collapse in this pass may rely on it */
+            for (u32 i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; ++i)
+            {
+                u32 const *triangle = &result[adjacency[i] * 3];
+                lockedThisPass[positionRemap[triangle[0]]] = true;
+                lockedThisPass[positionRemap[triangle[1]]] = true;
+                lockedThisPass[positionRemap[triangle[2]]] = true;
+            }
+        }
+
+        if (performedCollapses == 0)
+        {
+            break;
+        }
+
+        u32 writeIndex = 0;
+        for (u32 i = 0; i < (u32)result.size(); i += 3)
+        {
+            u32 a = wedgeRemap[result[i + 0]];
+            u32 b = wedgeRemap[result[i + 1]];
+            u32 c = wedgeRemap[result[i + 2]];
+            if (positionRemap[a] != positionRemap[b] && positionRemap[a] != positionRemap[c] &&
+                positionRemap[b] != positionRemap[c])
+            {
+                result[writeIndex++] = a;
+                result[writeIndex++] = b;
+                result[writeIndex++] = c;
+            }
+        }
+        result.resize(writeIndex);
+        countEdgeUses(edgeUses);
+    }
+
+    if (resultError)
+    {
+        *resultError = error;
+    }
+    return result;
+}
+
+Statistics Optimize(std::vector<VertexPositionNormal> &vertices, std::vector<u32> &indices)
+{
+    Statistics statistics = {};
+    statistics.vertexCountBefore = (u32)vertices.size();
+    statistics.before = AnalyzeVertexCache(indices, (u32)vertices.size());
+
+    DeduplicateVertices(vertices, indices);
+    OptimizeVertexCache(indices, (u32)vertices.size());
+    OptimizeOverdraw(indices, vertices);
+    OptimizeVertexFetch(vertices, indices);
+
+    statistics.vertexCountAfter = (u32)vertices.size();
+    statistics.after = AnalyzeVertexCache(indices, (u32)vertices.size());
+    return statistics;
+}
+} // namespace MeshOptimizer
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BasicTypes.h"
+#include "Utils/Vertex.h"
+
+#include <vector>
+
+/* Processing applied to imported geometry before it gets added to the global
+ * vertex and index buffers. All the functions work on triangle lists. */
+namespace MeshOptimizer
+{
+/* Rough size of the post-transform cache of current hardware */
+constexpr const u32 DEFAULT_CACHE_SIZE = 16;
+
+struct VertexCacheStatistics
+{
+    /* Average cache miss ratio: transformed vertices per triangle (0.5 is ideal, 3.0 is the worst) */
+    f32 acmr = 0.0f;
+    /* Average transform to vertex ratio: transformed vertices per referenced vertex (1.0 is ideal) */
+    f32 atvr = 0.0f;
+    u32 transformedVertices = 0;
+};
+
+struct Statistics
+{
+    u32 vertexCountBefore = 0;
+    u32 vertexCountAfter = 0;
+
+    VertexCacheStatistics before;
+    VertexCacheStatistics after;
+};
+
+/**
+ * @brief Merges bitwise identical vertices and remaps the indices accordingly
+ */
+void DeduplicateVertices(std::vector<VertexPositionNormal> &vertices, std::vector<u32> &indices);
+
+/**
+ * @brief Reorders triangles to improve post-transform cache hits (Forsyth's linear-speed optimizer)
+ */
+void OptimizeVertexCache(std::vector<u32> &indices, u32 vertexCount);
+
+/**
+ * @brief Reorders clusters of a cache optimized index buffer so that outward facing clusters are drawn first. Keeps
+ * the vertex cache efficiency of the clusters intact.
+ */
+void OptimizeOverdraw(std::vector<u32> &indices, std::vector<VertexPositionNormal> const &vertices,
+                      u32 cacheSize = DEFAULT_CACHE_SIZE);
+
+/**
+ * @brief Reorders vertices in the order in which they are first referenced by the indices and drops the unreferenced
+ * ones
+ */
+void OptimizeVertexFetch(std::vector<VertexPositionNormal> &vertices, std::vector<u32> &indices);
+
+/**
+ * @brief Simulates a FIFO post-transform cache of the given size
+ */
+VertexCacheStatistics AnalyzeVertexCache(std::vector<u32> const &indices, u32 vertexCount,
+                                         u32 cacheSize = DEFAULT_CACHE_SIZE);
+
+/**
+ * @brief Decimates the mesh with quadric error driven half-edge collapses until it reaches targetIndexCount or the
+ * next collapse would exceed maxError (object space distance). No new vertices are generated, the result indexes the
+ * same vertex list. Attribute seams and non-manifold vertices are kept in place and borders can only slide along
+ * themselves.
+ *
+ * @param resultError If not null, receives the object space error of the simplified mesh
+ */
+std::vector<u32> Simplify(std::vector<VertexPositionNormal> const &vertices, std::vector<u32> const &indices,
+                          u32 targetIndexCount, f32 maxError, f32 *resultError = nullptr);
+
+/**
+ * @brief Runs all the stages above in the right order (simplification is done separately when generating LODs)
+ */
+Statistics Optimize(std::vector<VertexPositionNormal> &vertices, std::vector<u32> &indices);
+} // namespace MeshOptimizer
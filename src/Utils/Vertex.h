@@ -1,8 +1,12 @@
 #pragma once
 
+#include "BasicTypes.h"
+
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <vulkan/vulkan.h>
 
 struct VertexPosition
@@ -85,6 +89,101 @@ struct VertexPositionNormal
     }
 };
 
+/* Compressed version of VertexPositionNormal, used for everything that ends up
+ * in the global vertex buffer. The position is stored as snorm16 relative to
+ * the bounding box of the mesh (see Components::Mesh::quantization) and the
+ * normal is octahedral-encoded into two snorm16 values. */
+struct VertexPositionNormalPacked
+{
+    i16 position[4];
+    i16 normal[2];
+
+    VertexPositionNormalPacked() = default;
+
+    /**
+     * @brief Packs a vertex, where offset is the center of the mesh's bounding
+     * box and inverseScale is the inverse of its half extents
+     */
+    static VertexPositionNormalPacked Pack(VertexPositionNormal const &vertex,
+                                           glm::vec3 const &offset,
+                                           glm::vec3 const &inverseScale)
+    {
+        VertexPositionNormalPacked result;
+
+        glm::vec3 position = (vertex.position - offset) * inverseScale;
+        result.position[0] = PackSnorm16(position.x);
+        result.position[1] = PackSnorm16(position.y);
+        result.position[2] = PackSnorm16(position.z);
+        result.position[3] = PackSnorm16(1.0f);
+
+        glm::vec2 normal = EncodeOctahedral(vertex.normal);
+        result.normal[0] = PackSnorm16(normal.x);
+        result.normal[1] = PackSnorm16(normal.y);
+
+        return result;
+    }
+
+    static i16 PackSnorm16(float value)
+    {
+        value = std::clamp(value, -1.0f, 1.0f);
+        return (i16)(value >= 0.0f ? value * 32767.0f + 0.5f
+                                   : value * 32767.0f - 0.5f);
+    }
+
+    /* Maps a unit vector onto the [-1, 1] square. Must match
+     * DecodeOctahedral() from basic.vert */
+    static glm::vec2 EncodeOctahedral(glm::vec3 normal)
+    {
+        normal /= (std::abs(normal.x) + std::abs(normal.y) +
+                   std::abs(normal.z));
+        glm::vec2 result(normal.x, normal.y);
+        if (normal.z < 0.0f)
+        {
+            result.x = (1.0f - std::abs(normal.y)) *
+                       (normal.x >= 0.0f ? 1.0f : -1.0f);
+            result.y = (1.0f - std::abs(normal.x)) *
+                       (normal.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return result;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2>
+    GetInputAttributeDescription()
+    {
+        std::array<VkVertexInputAttributeDescription, 2>
+            attributeDescriptions{};
+        {
+            attributeDescriptions[0].binding = 0;
+            attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+            attributeDescriptions[0].location = 0;
+            attributeDescriptions[0].offset =
+                offsetof(VertexPositionNormalPacked, position);
+        }
+        {
+            attributeDescriptions[1].binding = 0;
+            attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+            attributeDescriptions[1].location = 1;
+            attributeDescriptions[1].offset =
+                offsetof(VertexPositionNormalPacked, normal);
+        }
+        return attributeDescriptions;
+    }
+
+    static std::array<VkVertexInputBindingDescription, 1>
+    GetInputBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        {
+            bindingDescription.binding = 0;
+            bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+            bindingDescription.stride = sizeof(VertexPositionNormalPacked);
+        }
+        return {bindingDescription};
+    }
+};
+static_assert(sizeof(VertexPositionNormalPacked) == 12,
+              "Packed vertices are expected to be 12 bytes");
+
 struct VertexPositionColor
 {
     glm::vec3 position;